@@ -6,6 +6,8 @@
 #include <array> //std::array
 #include <memory> //std::unique_ptr
 
+#include <learnopengl/frustum.h>
+
 class Transform
 {
 protected:
@@ -120,36 +122,6 @@ public:
 	}
 };
 
-struct Plan
-{
-	glm::vec3 normal = { 0.f, 1.f, 0.f }; // unit vector
-	float     distance = 0.f;        // Distance with origin
-
-	Plan() = default;
-
-	Plan(const glm::vec3& p1, const glm::vec3& norm)
-		: normal(glm::normalize(norm)),
-		distance(glm::dot(normal, p1))
-	{}
-
-	float getSignedDistanceToPlan(const glm::vec3& point) const
-	{
-		return glm::dot(normal, point) - distance;
-	}
-};
-
-struct Frustum
-{
-	Plan topFace;
-	Plan bottomFace;
-
-	Plan rightFace;
-	Plan leftFace;
-
-	Plan farFace;
-	Plan nearFace;
-};
-
 struct BoundingVolume
 {
 	virtual bool isOnFrustum(const Frustum& camFrustum, const Transform& transform) const = 0;
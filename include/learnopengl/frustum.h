@@ -0,0 +1,98 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <limits>
+
+struct Plan
+{
+	glm::vec3 normal = { 0.f, 1.f, 0.f }; // unit vector
+	float     distance = 0.f;        // Distance with origin
+
+	Plan() = default;
+
+	Plan(const glm::vec3& p1, const glm::vec3& norm)
+		: normal(glm::normalize(norm)),
+		distance(glm::dot(normal, p1))
+	{}
+
+	float getSignedDistanceToPlan(const glm::vec3& point) const
+	{
+		return glm::dot(normal, point) - distance;
+	}
+};
+
+struct Frustum
+{
+	Plan topFace;
+	Plan bottomFace;
+
+	Plan rightFace;
+	Plan leftFace;
+
+	Plan farFace;
+	Plan nearFace;
+};
+
+// plane dot(n, p) + w >= 0 of a clip space inequality, a vanishing normal
+// (the far plane of an infinite projection) gives a plane nothing is behind
+inline Plan planFromClipRow(const glm::vec4& row)
+{
+	Plan plan;
+	const float length = glm::length(glm::vec3(row));
+	if (length > 0.f && std::isfinite(length))
+	{
+		plan.normal = glm::vec3(row) / length;
+		plan.distance = -row.w / length;
+	}
+	else
+	{
+		plan.distance = -std::numeric_limits<float>::max();
+	}
+	return plan;
+}
+
+// frustum of a view projection matrix with the zero to one depth range of
+// glClipControl (Gribb and Hartmann). With the reversed-Z projections of the
+// depth renderer z = w is the near plane and z = 0 the (infinite) far plane.
+inline Frustum createFrustumFromMatrix(const glm::mat4& viewProjection)
+{
+	glm::vec4 row[4];
+	for (int r = 0; r < 4; r++)
+		row[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+	Frustum frustum;
+	frustum.leftFace = planFromClipRow(row[3] + row[0]);
+	frustum.rightFace = planFromClipRow(row[3] - row[0]);
+	frustum.bottomFace = planFromClipRow(row[3] + row[1]);
+	frustum.topFace = planFromClipRow(row[3] - row[1]);
+	frustum.nearFace = planFromClipRow(row[3] - row[2]);
+	frustum.farFace = planFromClipRow(row[2]);
+	return frustum;
+}
+
+// whether the box [min, max] is on or in front of every plane of the
+// frustum, see also the AABB bounding volume of entity.h. The frustum of
+// projection * view * model holds the planes in model space, so the model
+// bounds of a mesh are tested as they are, whatever the model transform.
+inline bool isBoxOnFrustum(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max)
+{
+	const glm::vec3 center = (max + min) * 0.5f;
+	const glm::vec3 extents = (max - min) * 0.5f;
+
+	const Plan* faces[6] = { &frustum.leftFace, &frustum.rightFace, &frustum.topFace,
+		&frustum.bottomFace, &frustum.nearFace, &frustum.farFace };
+	for (int f = 0; f < 6; f++)
+	{
+		// Compute the projection interval radius of b onto L(t) = b.c + t * p.n
+		const glm::vec3& n = faces[f]->normal;
+		const float r = extents.x * std::abs(n.x) + extents.y * std::abs(n.y) + extents.z * std::abs(n.z);
+		if (faces[f]->getSignedDistanceToPlan(center) < -r)
+			return false;
+	}
+	return true;
+}
+
+#endif
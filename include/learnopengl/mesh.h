@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/frustum.h>
 
 #include <string>
 #include <vector>
@@ -43,7 +44,11 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // depth-only meshes keep a tightly packed position stream instead of vertices
+    vector<glm::vec3>    positions;
     unsigned int VAO;
+    // local space bounds of the vertices, computed at load time
+    glm::vec3 boundsMin, boundsMax;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -52,10 +57,41 @@ public:
         this->indices = indices;
         this->textures = textures;
 
+        computeBounds();
+
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
     }
 
+    // depth-only constructor, 12 bytes per vertex and no textures
+    Mesh(vector<glm::vec3> positions, vector<unsigned int> indices)
+    {
+        this->positions = positions;
+        this->indices = indices;
+
+        computeBounds();
+
+        // the buffers are created by the first Draw, so meshes drawn from the
+        // packed GeometryArena of the depth renderer never hold a second copy
+        VAO = 0;
+    }
+
+    unsigned int numVertices() const
+    {
+        return positions.empty() ? vertices.size() : positions.size();
+    }
+
+    const glm::vec3 &position(unsigned int i) const
+    {
+        return positions.empty() ? vertices[i].Position : positions[i];
+    }
+
+    // whether the bounds meet a frustum given in model space
+    bool isOnFrustum(const Frustum &frustum) const
+    {
+        return isBoxOnFrustum(frustum, boundsMin, boundsMax);
+    }
+
     // render the mesh
     void Draw(Shader &shader) 
     {
@@ -86,6 +122,8 @@ public:
         }
         
         // draw mesh
+        if(VAO == 0)
+            setupDepthMesh();
         glBindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
@@ -98,6 +136,19 @@ private:
     // render data 
     unsigned int VBO, EBO;
 
+    void computeBounds()
+    {
+        boundsMin = boundsMax = glm::vec3(0.0f);
+        if(numVertices() == 0)
+            return;
+        boundsMin = boundsMax = position(0);
+        for(unsigned int i = 1; i < numVertices(); i++)
+        {
+            boundsMin = glm::min(boundsMin, position(i));
+            boundsMax = glm::max(boundsMax, position(i));
+        }
+    }
+
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
@@ -142,5 +193,25 @@ private:
 		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
         glBindVertexArray(0);
     }
+
+    // buffers of a depth-only mesh, the depth shaders read aPos (location 0) only
+    void setupDepthMesh()
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+        // vertex Positions
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindVertexArray(0);
+    }
 };
 #endif
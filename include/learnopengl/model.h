@@ -21,6 +21,13 @@
 #include <vector>
 using namespace std;
 
+// meshes drawn and meshes considered by culled draws, accumulated over calls
+struct DrawStats
+{
+    unsigned long drawn = 0;
+    unsigned long total = 0;
+};
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 class Model 
@@ -31,9 +38,11 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // load positions and indices only, see Mesh's depth-only constructor
+    bool depthOnly;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, bool depthOnly = false) : gammaCorrection(gamma), depthOnly(depthOnly)
     {
         loadModel(path);
     }
@@ -44,6 +53,26 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws the meshes whose bounds meet the frustum, given in model space
+    // e.g. by createFrustumFromMatrix(projection * view * model)
+    void Draw(Shader &shader, const Frustum &frustum, DrawStats *stats = nullptr)
+    {
+        unsigned int drawn = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if(meshes[i].isOnFrustum(frustum))
+            {
+                meshes[i].Draw(shader);
+                drawn++;
+            }
+        }
+        if(stats != nullptr)
+        {
+            stats->drawn += drawn;
+            stats->total += meshes.size();
+        }
+    }
     
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
@@ -51,7 +80,10 @@ private:
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        // depth passes need neither normals, texture coordinates nor tangent space
+        unsigned int flags = depthOnly ? aiProcess_Triangulate :
+            aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+        const aiScene* scene = importer.ReadFile(path, flags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -86,6 +118,9 @@ private:
 
     Mesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
+        if(depthOnly)
+            return processDepthMesh(mesh);
+
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
@@ -168,6 +203,24 @@ private:
         return Mesh(vertices, indices, textures);
     }
 
+    // positions and triangle indices only, materials and their textures are not loaded
+    Mesh processDepthMesh(aiMesh *mesh)
+    {
+        vector<glm::vec3> positions(mesh->mNumVertices);
+        for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+            positions[i] = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+
+        vector<unsigned int> indices;
+        indices.reserve(3 * mesh->mNumFaces);
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+        {
+            const aiFace &face = mesh->mFaces[i];
+            for(unsigned int j = 0; j < face.mNumIndices; j++)
+                indices.push_back(face.mIndices[j]);
+        }
+        return Mesh(positions, indices);
+    }
+
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
     // the required info is returned as a Texture struct.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
@@ -6,6 +6,7 @@ if local_module_path not in sys.path:
     sys.path.append(local_module_path)
 
 from geometry import Point3D, Point2D
+import json
 import subprocess
 import tempfile
 
@@ -87,12 +88,18 @@ class VisibilityVolume:
 
         # The temporary directory and its contents are deleted once the block ends
 
-    def write_config_file(self, file_path, debug = False):
+    def check_max_radius(self):
         params = self.parameters
         if params['max_radius'] is None or params['max_radius'] < 0:
             params['max_radius'] = 1000
             print(f"Setting max_radius to {params['max_radius']}")
-        visibility_yaml_config = f"""
+
+    def scene_config(self):
+        """
+        The world coordinate system and mesh part of the config file.
+        """
+        params = self.parameters
+        return f"""
 world_coord_sys:
     id: world
     origin: [0.0, 0.0, 0.0]
@@ -106,7 +113,34 @@ mesh:
     orientation axis, angle: [1, 0, 0, 0]
     format: OBJ
     filename: {params["world_obj_filename"]}
+"""
 
+    def request(self):
+        """
+        The visibility volume as a single JSON line for a server started by VisibilityVolumeServer.
+        """
+        self.check_max_radius()
+        params = self.parameters
+        vertex = params["visibility_volume_vertex"]
+        resolution = params["visibility_volume_mesh_resolution"]
+        return json.dumps({
+            "id": f"Volume {params['visibility_volume_index']}",
+            "width": resolution.x,
+            "height": resolution.y,
+            "fov_degrees": 90,
+            "origin": [vertex.x, vertex.y, vertex.z],
+            "front": [1.0, 0.0, 0.0],
+            "up": [0.0, 1.0, 0.0],
+            "up_max": 4000.0,
+            "up_min": -4000.0,
+            "radius_max": params["max_radius"],
+            "output_file": params["output_obj_filename"]
+        })
+
+    def write_config_file(self, file_path, debug = False):
+        self.check_max_radius()
+        params = self.parameters
+        visibility_yaml_config = self.scene_config() + f"""
 visibility_vol:
     id: Volume {params["visibility_volume_index"]}
     width: {params["visibility_volume_mesh_resolution"].x}
@@ -138,6 +172,70 @@ visibility_vol:
             print("File content:\n", content)
 
 
+class VisibilityVolumeServer:
+    """
+    Keeps one ogl_depthrenderer running in --serve mode, so the GL context, the
+    world mesh and the shaders are set up once rather than once per volume.
+    Volumes are sent as JSON lines on its stdin and every reply is a JSON line
+    naming the output file.
+    """
+
+    def __init__(self, volume, backend = None):
+        """
+        Parameters:
+            volume (VisibilityVolume): configured with the program path and the world mesh
+            backend (str): ogl_depthrenderer --backend, None uses the program default
+        """
+        self.volume = volume
+        self.backend = backend
+        self.process = None
+        self.temp_dir = None
+
+    def start(self, debug = False):
+        params = self.volume.parameters
+        self.temp_dir = tempfile.TemporaryDirectory()
+        config_file_path_and_name = os.path.join(self.temp_dir.name, "visibility_scene.yaml")
+        with open(config_file_path_and_name, "w") as file:
+            file.write(self.volume.scene_config())
+        argument_list = [params['visibility_prog_path_and_filename'], '-c', config_file_path_and_name, '--serve']
+        if self.backend:
+            argument_list.extend(['-b', self.backend])
+        print("Command: " + ' '.join(map(str, argument_list)) + "\n")
+        # the server log goes to stderr, stdout carries only the replies
+        self.process = subprocess.Popen(argument_list, cwd=params['visibility_prog_path_root'],
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                        stderr=None if debug else subprocess.DEVNULL, text=True, bufsize=1)
+
+    def evaluate(self, debug = False):
+        """
+        Compute the visibility volume currently configured in self.volume.
+
+        Returns:
+            dict: the reply, "status" is "ok" or "error" and "output" names the written file
+        """
+        if self.process is None:
+            self.start(debug)
+        self.process.stdin.write(self.volume.request() + "\n")
+        self.process.stdin.flush()
+        line = self.process.stdout.readline()
+        if not line:
+            raise RuntimeError("The visibility server exited.")
+        reply = json.loads(line)
+        if debug or reply["status"] != "ok":
+            print(f"Reply: {reply}")
+        return reply
+
+    def close(self):
+        if self.process is not None:
+            self.process.stdin.write("quit\n")
+            self.process.stdin.close()
+            self.process.wait()
+            self.process = None
+        if self.temp_dir is not None:
+            self.temp_dir.cleanup()
+            self.temp_dir = None
+
+
 # Example usage of the VisibilityVolume class
 if __name__ == "__main__":
     # Check if an argument is passed
@@ -196,6 +196,29 @@ bool YAML_VisibilityVolume::parse(const YAML::Node& visibility) {
             std::cout << "Error: Visibility volume missing required output filename - Default(\"" << output_filename << "\") used." << std::endl;
             //return false;
         }
+        if (visibility["parameterization"]) {
+            parameterization = visibility["parameterization"].as<std::string>();
+            if (parameterization != "cube" && parameterization != "spherical") {
+                std::cout << "Error: Visibility volume parameterization must be \"cube\" or \"spherical\"." << std::endl;
+                return false;
+            }
+        }
+        if (visibility["spherical_rows"]) {
+            spherical_rows = visibility["spherical_rows"].as<int>();
+        }
+        if (visibility["adaptive_tolerance"]) {
+            adaptive_tolerance = visibility["adaptive_tolerance"].as<float>();
+        }
+        if (visibility["weld_seams"]) {
+            weld_seams = visibility["weld_seams"].as<bool>();
+        }
+        if (visibility["output_format"]) {
+            output_format = visibility["output_format"].as<std::string>();
+            if (output_format != "obj" && output_format != "ply" && output_format != "glb") {
+                std::cout << "Error: Visibility volume output_format must be \"obj\", \"ply\" or \"glb\"." << std::endl;
+                return false;
+            }
+        }
     }
     return true;
 }
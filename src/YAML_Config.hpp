@@ -59,11 +59,22 @@ public:
     glm::vec3 origin, up, front;
     float up_max, up_min, radius_max;
     std::string output_filename;
+    // "cube" meshes the six depth faces, "spherical" resamples them onto a (theta, phi) grid
+    std::string parameterization;
+    // polar steps of the spherical grid, 0 matches the pixel pitch of the faces
+    int spherical_rows;
+    // largest distance of a pixel from the adaptive cube face mesh, 0 meshes every pixel
+    float adaptive_tolerance;
+    // mesh the cube faces over their pixel corners with shared seam vertices
+    bool weld_seams;
+    // "obj", "ply" or "glb", empty uses the extension of output_filename
+    std::string output_format;
 
     YAML_VisibilityVolume() : width(0), height(0), 
             fov_degrees(90.0f), origin(0.0f, 0.0f, 0.0f),
             up(0.0f, 1.0f, 0.0f), front(1.0f, 0.0f, 0.0f),
-            output_filename("output.obj") {
+            output_filename("output.obj"), parameterization("cube"), spherical_rows(0),
+            adaptive_tolerance(0.0f), weld_seams(false) {
         up_max = std::numeric_limits<float>::max();
         radius_max = std::numeric_limits<float>::max();        
         up_min = -std::numeric_limits<float>::max();
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "binary_io.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// 32 bit words converted per fwrite on big endian hosts
+static const size_t SWAP_BLOCK_SIZE = 1 << 16;
+
+static bool isLittleEndian() {
+    uint32_t one = 1;
+    unsigned char byte;
+    memcpy(&byte, &one, 1);
+    return byte == 1;
+}
+
+static void swapWords(unsigned char *data, size_t numWords) {
+    for (size_t w = 0; w < numWords; w++, data += 4) {
+        std::swap(data[0], data[3]);
+        std::swap(data[1], data[2]);
+    }
+}
+
+bool writeWordsLE(FILE *file, const void *data, size_t numWords) {
+    if (isLittleEndian()) {
+        return fwrite(data, 4, numWords, file) == numWords;
+    }
+    const unsigned char *src = (const unsigned char *) data;
+    std::vector<unsigned char> block(4 * std::min(numWords, SWAP_BLOCK_SIZE));
+    for (size_t n = 0; n < numWords; n += SWAP_BLOCK_SIZE) {
+        size_t count = std::min(numWords - n, SWAP_BLOCK_SIZE);
+        memcpy(&block[0], src + 4 * n, 4 * count);
+        swapWords(&block[0], count);
+        if (fwrite(&block[0], 4, count, file) != count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readWordsLE(FILE *file, void *data, size_t numWords) {
+    if (fread(data, 4, numWords, file) != numWords) {
+        return false;
+    }
+    if (!isLittleEndian()) {
+        swapWords((unsigned char *) data, numWords);
+    }
+    return true;
+}
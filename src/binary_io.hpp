@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   binary_io.hpp
+ *
+ * 4 byte words in little endian order for the binary output files (PLY, GLB,
+ * coverage rasters, voxel brick maps), byte swapped in blocks on big endian
+ * hosts.
+ */
+
+#ifndef BINARY_IO_HPP
+#define BINARY_IO_HPP
+
+#include <cstddef>
+#include <cstdio>
+
+bool writeWordsLE(FILE *file, const void *data, size_t numWords);
+
+bool readWordsLE(FILE *file, void *data, size_t numWords);
+
+#endif /* BINARY_IO_HPP */
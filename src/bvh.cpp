@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+// lane_data rows: ox, oy, oz, dx, dy, dz, tmin, tmax
+
+void RayPacket4::setRay(int lane, const glm::vec3& origin, const glm::vec3& dir, float _tmin, float _tmax) {
+    lane_data[0][lane] = origin.x;
+    lane_data[1][lane] = origin.y;
+    lane_data[2][lane] = origin.z;
+    lane_data[3][lane] = dir.x;
+    lane_data[4][lane] = dir.y;
+    lane_data[5][lane] = dir.z;
+    lane_data[6][lane] = _tmin;
+    lane_data[7][lane] = _tmax;
+}
+
+void RayPacket4::disableLane(int lane) {
+    setRay(lane, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, -1.0f);
+}
+
+// keeps 1/d finite so that 0 * (1/d) never produces a NaN in the slab test
+
+static inline float safeInverse(float d) {
+    const float eps = 1.0e-12f;
+    if (std::abs(d) < eps) {
+        d = (d < 0.0f) ? -eps : eps;
+    }
+    return 1.0f / d;
+}
+
+void RayPacket4::finalize() {
+    ox = vfloat4::load(lane_data[0]);
+    oy = vfloat4::load(lane_data[1]);
+    oz = vfloat4::load(lane_data[2]);
+    dx = vfloat4::load(lane_data[3]);
+    dy = vfloat4::load(lane_data[4]);
+    dz = vfloat4::load(lane_data[5]);
+    tmin = vfloat4::load(lane_data[6]);
+    tmax = vfloat4::load(lane_data[7]);
+    float inv[3][4];
+    for (int lane = 0; lane < 4; lane++) {
+        for (int axis = 0; axis < 3; axis++) {
+            inv[axis][lane] = safeInverse(lane_data[3 + axis][lane]);
+        }
+    }
+    idx = vfloat4::load(inv[0]);
+    idy = vfloat4::load(inv[1]);
+    idz = vfloat4::load(inv[2]);
+}
+
+// ------------------------------------------------------------------------
+// construction
+// ------------------------------------------------------------------------
+
+namespace {
+
+    struct AABB {
+        glm::vec3 bmin, bmax;
+
+        AABB() : bmin(std::numeric_limits<float>::max()), bmax(-std::numeric_limits<float>::max()) {
+        }
+
+        void grow(const glm::vec3& p) {
+            bmin = glm::min(bmin, p);
+            bmax = glm::max(bmax, p);
+        }
+
+        void grow(const AABB& b) {
+            bmin = glm::min(bmin, b.bmin);
+            bmax = glm::max(bmax, b.bmax);
+        }
+
+        float area() const {
+            glm::vec3 e = bmax - bmin;
+            if (e.x < 0.0f) {
+                return 0.0f;
+            }
+            return e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+    };
+
+    struct BuildTriangle {
+        AABB bounds;
+        glm::vec3 centroid;
+        unsigned int index;
+    };
+
+    const int NUM_BINS = 16;
+
+    struct Bin {
+        AABB bounds;
+        unsigned int count;
+
+        Bin() : count(0) {
+        }
+    };
+}
+
+void BVH::build(const SceneGeometry& scene) {
+    nodes.clear();
+    leafTriangles.clear();
+    triangleIndex.clear();
+    unsigned int numTris = scene.numTriangles();
+    if (numTris == 0) {
+        return;
+    }
+    std::vector<BuildTriangle> tris(numTris);
+    for (unsigned int t = 0; t < numTris; t++) {
+        const glm::u32vec3& f = scene.triangles[t];
+        tris[t].bounds.grow(scene.vertices[f.x]);
+        tris[t].bounds.grow(scene.vertices[f.y]);
+        tris[t].bounds.grow(scene.vertices[f.z]);
+        tris[t].centroid = 0.5f * (tris[t].bounds.bmin + tris[t].bounds.bmax);
+        tris[t].index = t;
+    }
+
+    nodes.reserve(2 * numTris);
+    BVHNode root;
+    root.leftFirst = 0;
+    root.count = numTris;
+    nodes.push_back(root);
+
+    // (node, depth) pairs still to be split
+    std::vector<std::pair<unsigned int, unsigned int> > stack;
+    stack.push_back(std::make_pair(0u, 0u));
+    while (!stack.empty()) {
+        unsigned int nodeIdx = stack.back().first;
+        unsigned int depth = stack.back().second;
+        stack.pop_back();
+        unsigned int first = nodes[nodeIdx].leftFirst;
+        unsigned int count = nodes[nodeIdx].count;
+
+        AABB bounds, centroidBounds;
+        for (unsigned int t = first; t < first + count; t++) {
+            bounds.grow(tris[t].bounds);
+            centroidBounds.grow(tris[t].centroid);
+        }
+        nodes[nodeIdx].bmin = bounds.bmin;
+        nodes[nodeIdx].bmax = bounds.bmax;
+        if (count <= 2) {
+            continue;
+        }
+
+        // binned SAH over the centroid extent of each axis
+        float bestCost = std::numeric_limits<float>::max();
+        int bestAxis = -1, bestSplit = 0;
+        glm::vec3 extent = centroidBounds.bmax - centroidBounds.bmin;
+        for (int axis = 0; axis < 3; axis++) {
+            if (extent[axis] <= 0.0f) {
+                continue;
+            }
+            Bin bins[NUM_BINS];
+            float scale = NUM_BINS / extent[axis];
+            for (unsigned int t = first; t < first + count; t++) {
+                int b = std::min(NUM_BINS - 1, (int) ((tris[t].centroid[axis] - centroidBounds.bmin[axis]) * scale));
+                bins[b].count++;
+                bins[b].bounds.grow(tris[t].bounds);
+            }
+            float leftArea[NUM_BINS - 1];
+            unsigned int leftCount[NUM_BINS - 1];
+            AABB box;
+            unsigned int sum = 0;
+            for (int b = 0; b < NUM_BINS - 1; b++) {
+                sum += bins[b].count;
+                box.grow(bins[b].bounds);
+                leftCount[b] = sum;
+                leftArea[b] = box.area();
+            }
+            box = AABB();
+            sum = 0;
+            for (int b = NUM_BINS - 1; b > 0; b--) {
+                sum += bins[b].count;
+                box.grow(bins[b].bounds);
+                float cost = leftCount[b - 1] * leftArea[b - 1] + sum * box.area();
+                if (leftCount[b - 1] > 0 && sum > 0 && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+        // compare against the cost of intersecting all triangles of a leaf,
+        // large leaves are only accepted at the depth limit
+        float leafCost = count * bounds.area();
+        if (depth >= MAX_DEPTH || (count <= MAX_LEAF_SIZE && (bestAxis < 0 || bestCost >= leafCost))) {
+            continue;
+        }
+
+        unsigned int mid;
+        if (bestAxis >= 0) {
+            float scale = NUM_BINS / extent[bestAxis];
+            float splitMin = centroidBounds.bmin[bestAxis];
+            BuildTriangle *middle = std::partition(&tris[first], &tris[first] + count,
+                    [&](const BuildTriangle & tri) {
+                        return std::min(NUM_BINS - 1, (int) ((tri.centroid[bestAxis] - splitMin) * scale)) < bestSplit;
+                    });
+            mid = (unsigned int) (middle - &tris[0]);
+        } else {
+            // all centroids coincide, split the list in half
+            mid = first + count / 2;
+        }
+
+        BVHNode left, right;
+        left.leftFirst = first;
+        left.count = mid - first;
+        right.leftFirst = mid;
+        right.count = first + count - mid;
+        unsigned int leftIdx = (unsigned int) nodes.size();
+        nodes.push_back(left);
+        nodes.push_back(right);
+        nodes[nodeIdx].leftFirst = leftIdx;
+        nodes[nodeIdx].count = 0;
+        stack.push_back(std::make_pair(leftIdx + 1, depth + 1));
+        stack.push_back(std::make_pair(leftIdx, depth + 1));
+    }
+
+    leafTriangles.resize(numTris);
+    triangleIndex.resize(numTris);
+    for (unsigned int t = 0; t < numTris; t++) {
+        const glm::u32vec3& f = scene.triangles[tris[t].index];
+        const glm::vec3& v0 = scene.vertices[f.x];
+        leafTriangles[t].v0 = v0;
+        leafTriangles[t].e1 = scene.vertices[f.y] - v0;
+        leafTriangles[t].e2 = scene.vertices[f.z] - v0;
+        triangleIndex[t] = tris[t].index;
+    }
+}
+
+// ------------------------------------------------------------------------
+// traversal
+// ------------------------------------------------------------------------
+
+vbool4 BVH::intersectBox(const BVHNode& node, const RayPacket4& packet, vfloat4& tnear) const {
+    vfloat4 t0x = (vfloat4(node.bmin.x) - packet.ox) * packet.idx;
+    vfloat4 t1x = (vfloat4(node.bmax.x) - packet.ox) * packet.idx;
+    vfloat4 t0y = (vfloat4(node.bmin.y) - packet.oy) * packet.idy;
+    vfloat4 t1y = (vfloat4(node.bmax.y) - packet.oy) * packet.idy;
+    vfloat4 t0z = (vfloat4(node.bmin.z) - packet.oz) * packet.idz;
+    vfloat4 t1z = (vfloat4(node.bmax.z) - packet.oz) * packet.idz;
+    tnear = vmax(vmax(vmin(t0x, t1x), vmin(t0y, t1y)), vmax(vmin(t0z, t1z), packet.tmin));
+    vfloat4 tfar = vmin(vmin(vmax(t0x, t1x), vmax(t0y, t1y)), vmin(vmax(t0z, t1z), packet.tmax));
+    return tnear <= tfar;
+}
+
+vbool4 BVH::intersectTriangle(const BVHTriangle& tri, RayPacket4& packet) const {
+    vfloat4 e1x(tri.e1.x), e1y(tri.e1.y), e1z(tri.e1.z);
+    vfloat4 e2x(tri.e2.x), e2y(tri.e2.y), e2z(tri.e2.z);
+    // p = d x e2
+    vfloat4 px = packet.dy * e2z - packet.dz * e2y;
+    vfloat4 py = packet.dz * e2x - packet.dx * e2z;
+    vfloat4 pz = packet.dx * e2y - packet.dy * e2x;
+    vfloat4 det = e1x * px + e1y * py + e1z * pz;
+    // a zero determinant yields inf/NaN barycentrics which fail every comparison below
+    vfloat4 invDet = vfloat4(1.0f) / det;
+    vfloat4 tx = packet.ox - vfloat4(tri.v0.x);
+    vfloat4 ty = packet.oy - vfloat4(tri.v0.y);
+    vfloat4 tz = packet.oz - vfloat4(tri.v0.z);
+    vfloat4 u = (tx * px + ty * py + tz * pz) * invDet;
+    // q = t x e1
+    vfloat4 qx = ty * e1z - tz * e1y;
+    vfloat4 qy = tz * e1x - tx * e1z;
+    vfloat4 qz = tx * e1y - ty * e1x;
+    vfloat4 v = (packet.dx * qx + packet.dy * qy + packet.dz * qz) * invDet;
+    vfloat4 t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+    vfloat4 zero(0.0f);
+    vbool4 hit = (u >= zero) & (v >= zero) & ((u + v) <= vfloat4(1.0f)) &
+            (t > packet.tmin) & (t < packet.tmax);
+    packet.tmax = select(hit, t, packet.tmax);
+    return hit;
+}
+
+vbool4 BVH::intersect(RayPacket4& packet) const {
+    vbool4 anyHit = vfloat4(1.0f) < vfloat4(0.0f);
+    if (nodes.empty()) {
+        return anyHit;
+    }
+    struct StackEntry {
+        unsigned int node;
+        float tEntry;
+    };
+    StackEntry stack[MAX_DEPTH + 1];
+    int stackSize = 0;
+    vfloat4 tnear;
+    vbool4 mask = intersectBox(nodes[0], packet, tnear);
+    if (!mask.any()) {
+        return anyHit;
+    }
+    stack[stackSize].node = 0;
+    stack[stackSize].tEntry = hmin(select(mask, tnear, vfloat4(std::numeric_limits<float>::max())));
+    stackSize++;
+    const vfloat4 farAway(std::numeric_limits<float>::max());
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        // every ray of the packet already hit something closer than this box
+        if (entry.tEntry > hmax(packet.tmax)) {
+            continue;
+        }
+        const BVHNode& node = nodes[entry.node];
+        if (node.isLeaf()) {
+            for (unsigned int t = node.leftFirst; t < node.leftFirst + node.count; t++) {
+                anyHit = anyHit | intersectTriangle(leafTriangles[t], packet);
+            }
+            continue;
+        }
+        vfloat4 tnearL, tnearR;
+        vbool4 hitL = intersectBox(nodes[node.leftFirst], packet, tnearL);
+        vbool4 hitR = intersectBox(nodes[node.leftFirst + 1], packet, tnearR);
+        bool anyL = hitL.any(), anyR = hitR.any();
+        float dL = anyL ? hmin(select(hitL, tnearL, farAway)) : 0.0f;
+        float dR = anyR ? hmin(select(hitR, tnearR, farAway)) : 0.0f;
+        if (anyL && anyR) {
+            // the nearer child is popped first
+            bool leftFirst = dL <= dR;
+            stack[stackSize].node = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+            stack[stackSize].tEntry = leftFirst ? dR : dL;
+            stackSize++;
+            stack[stackSize].node = leftFirst ? node.leftFirst : node.leftFirst + 1;
+            stack[stackSize].tEntry = leftFirst ? dL : dR;
+            stackSize++;
+        } else if (anyL) {
+            stack[stackSize].node = node.leftFirst;
+            stack[stackSize].tEntry = dL;
+            stackSize++;
+        } else if (anyR) {
+            stack[stackSize].node = node.leftFirst + 1;
+            stack[stackSize].tEntry = dR;
+            stackSize++;
+        }
+    }
+    return anyHit;
+}
+
+vbool4 BVH::occluded(RayPacket4& packet) const {
+    vbool4 blocked = vfloat4(1.0f) < vfloat4(0.0f);
+    vbool4 active = packet.tmin < packet.tmax;
+    if (nodes.empty() || !active.any()) {
+        return blocked;
+    }
+    const vfloat4 disabled(-std::numeric_limits<float>::max());
+    unsigned int stack[MAX_DEPTH + 1];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BVHNode& node = nodes[stack[--stackSize]];
+        vfloat4 tnear;
+        if (!intersectBox(node, packet, tnear).any()) {
+            continue;
+        }
+        if (!node.isLeaf()) {
+            stack[stackSize++] = node.leftFirst + 1;
+            stack[stackSize++] = node.leftFirst;
+            continue;
+        }
+        for (unsigned int t = node.leftFirst; t < node.leftFirst + node.count; t++) {
+            vbool4 hit = intersectTriangle(leafTriangles[t], packet);
+            if (hit.any()) {
+                blocked = blocked | hit;
+                packet.tmax = select(hit, disabled, packet.tmax);
+                if (!andnot(active, blocked).any()) {
+                    return blocked;
+                }
+            }
+        }
+    }
+    return blocked;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   bvh.hpp
+ *
+ * Bounding volume hierarchy over the triangles of a SceneGeometry. The tree
+ * is built with a binned surface area heuristic and traversed by packets of
+ * four rays: every node box and every leaf triangle is tested against all
+ * four rays at once with the 4-wide SIMD vector of simd4.hpp. Rays are only
+ * accepted in the open interval (tmin, tmax) and triangles are double sided,
+ * matching OpenGL rendering without face culling. Closest hit queries visit
+ * the nearer child first; occlusion queries stop at the first hit of every
+ * lane.
+ */
+
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "simd4.hpp"
+#include "scene_geometry.hpp"
+
+struct BVHNode {
+    glm::vec3 bmin;
+    // index of the left child (right = left + 1) or of the first leaf triangle
+    unsigned int leftFirst;
+    glm::vec3 bmax;
+    // number of triangles, 0 for an interior node
+    unsigned int count;
+
+    bool isLeaf() const {
+        return count > 0;
+    }
+};
+
+// leaf triangle in the form used by the Moller-Trumbore test
+struct BVHTriangle {
+    glm::vec3 v0, e1, e2;
+};
+
+// four rays traced together. Lanes that do not carry a ray are disabled by
+// setting tmax below tmin.
+
+struct RayPacket4 {
+    vfloat4 ox, oy, oz;
+    vfloat4 dx, dy, dz;
+    vfloat4 tmin, tmax;
+
+    // sets a single lane, call finalize() once all lanes are set
+    void setRay(int lane, const glm::vec3& origin, const glm::vec3& dir, float _tmin, float _tmax);
+    void disableLane(int lane);
+    void finalize();
+
+    vfloat4 idx, idy, idz;
+
+private:
+    float lane_data[8][4];
+};
+
+class BVH {
+public:
+    static const unsigned int MAX_LEAF_SIZE = 8;
+    // also bounds the traversal stack
+    static const unsigned int MAX_DEPTH = 64;
+
+    std::vector<BVHNode> nodes;
+    std::vector<BVHTriangle> leafTriangles;
+    // scene triangle index of each leaf triangle
+    std::vector<unsigned int> triangleIndex;
+
+    void build(const SceneGeometry& scene);
+
+    // closest hits of the packet, tmax is lowered to the hit distance of the
+    // lanes that hit, those lanes are returned as a mask
+    vbool4 intersect(RayPacket4& packet) const;
+
+    // any hit in (tmin, tmax): the lanes blocked by some triangle are
+    // returned as a mask and disabled. Traversal ends as soon as every lane
+    // is blocked, without looking for the closest hit.
+    vbool4 occluded(RayPacket4& packet) const;
+
+    bool empty() const {
+        return nodes.empty();
+    }
+
+    glm::vec3 boundsMin() const {
+        return nodes.empty() ? glm::vec3(0.0f) : nodes[0].bmin;
+    }
+
+    glm::vec3 boundsMax() const {
+        return nodes.empty() ? glm::vec3(0.0f) : nodes[0].bmax;
+    }
+
+private:
+    vbool4 intersectBox(const BVHNode& node, const RayPacket4& packet, vfloat4& tnear) const;
+    vbool4 intersectTriangle(const BVHTriangle& tri, RayPacket4& packet) const;
+};
+
+#endif /* BVH_HPP */
+
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "coverage_raster.hpp"
+#include "binary_io.hpp"
+#include "heightfield_viewshed.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+const int32_t CoverageRaster::NO_OBSERVER;
+
+// visible cells of one observer's window, one bit per cell in row major order
+struct ObserverBits {
+    int row0, column0, rows, columns;
+    std::vector<uint64_t> bits;
+
+    bool test(size_t n) const {
+        return (bits[n >> 6] >> (n & 63)) & 1;
+    }
+};
+
+CoverageRaster::CoverageRaster() : rows(0), columns(0), x0(0.0f), z0(0.0f), cellSize(1.0f) {
+}
+
+void CoverageRaster::accumulate(const Heightmap& map, const glm::vec3 *origins, const float *radii, int count,
+        float targetHeight, bool firstObserver) {
+    rows = map.rows;
+    columns = map.columns;
+    x0 = map.x0;
+    z0 = map.z0;
+    cellSize = map.cellSize;
+    counts.assign((size_t) rows * columns, 0);
+    first.assign(firstObserver ? counts.size() : 0, NO_OBSERVER);
+    std::vector<ObserverBits> batch(std::min(count, (int) BATCH_OBSERVERS));
+    int numStrips = (rows + Heightmap::STRIP_ROWS - 1) / Heightmap::STRIP_ROWS;
+    for (int begin = 0; begin < count; begin += BATCH_OBSERVERS) {
+        int size = std::min(count - begin, (int) BATCH_OBSERVERS);
+        parallel_for(0, size, [&](int b) {
+            HeightfieldViewshed viewshed;
+            viewshed.compute(map, origins[begin + b], radii[begin + b]);
+            ObserverBits& window = batch[b];
+            window.row0 = viewshed.row0;
+            window.column0 = viewshed.column0;
+            window.rows = viewshed.rows;
+            window.columns = viewshed.columns;
+            window.bits.assign(((size_t) window.rows * window.columns + 63) / 64, 0);
+            for (int i = 0; i < window.rows; i++) {
+                for (int j = 0; j < window.columns; j++) {
+                    if (viewshed.visible(window.row0 + i, window.column0 + j, targetHeight)) {
+                        size_t n = (size_t) i * window.columns + j;
+                        window.bits[n >> 6] |= (uint64_t) 1 << (n & 63);
+                    }
+                }
+            }
+        });
+        parallel_for(0, numStrips, [&](int s) {
+            int r0 = s * Heightmap::STRIP_ROWS, r1 = std::min(r0 + Heightmap::STRIP_ROWS, rows);
+            for (int b = 0; b < size; b++) {
+                const ObserverBits& window = batch[b];
+                int i0 = std::max(r0, window.row0), i1 = std::min(r1, window.row0 + window.rows);
+                for (int i = i0; i < i1; i++) {
+                    size_t n = (size_t) (i - window.row0) * window.columns;
+                    size_t cell = (size_t) i * columns + window.column0;
+                    for (int j = 0; j < window.columns; j++, n++, cell++) {
+                        if (window.test(n)) {
+                            counts[cell]++;
+                            if (firstObserver && first[cell] == NO_OBSERVER) {
+                                first[cell] = begin + b;
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+bool CoverageRaster::write(const std::string& filename) const {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "Could not open " << filename << " for writing." << std::endl;
+        return false;
+    }
+    uint32_t size[2] = {(uint32_t) rows, (uint32_t) columns};
+    float grid[3] = {x0, z0, cellSize};
+    uint32_t flags = first.empty() ? 0 : 1;
+    bool ok = fwrite("OGLCOV1\n", 1, 8, file) == 8 && writeWordsLE(file, size, 2) && writeWordsLE(file, grid, 3) &&
+            writeWordsLE(file, &flags, 1) && writeWordsLE(file, counts.data(), counts.size());
+    if (!first.empty()) {
+        ok = ok && writeWordsLE(file, first.data(), first.size());
+    }
+    if (fclose(file) != 0 || !ok) {
+        std::cout << "Error writing " << filename << "." << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   coverage_raster.hpp
+ *
+ * Cumulative viewshed of many observers over a Heightmap: for every cell the
+ * number of observers that see a point targetHeight above its ground, and
+ * optionally the first of them. Nothing per observer outlives its sweep.
+ * The observers of a batch run the R2 sweep of HeightfieldViewshed in
+ * parallel, each sweep serially on its thread, into a bitmap of its window.
+ * The bitmaps are then merged in parallel over strips of rows in observer
+ * order, which keeps the result independent of the thread count.
+ *
+ * write() stores the raster as a little endian binary file:
+ *
+ *     char     magic[8]    "OGLCOV1\n"
+ *     uint32   rows, columns
+ *     float32  x0, z0, cell_size    grid corner and cell side, as in Heightmap
+ *     uint32   flags                1: first observer indices follow the counts
+ *     uint32   counts[rows][columns]
+ *     int32    first[rows][columns]  -1 where no observer sees the cell
+ */
+
+#ifndef COVERAGE_RASTER_HPP
+#define COVERAGE_RASTER_HPP
+
+#include "heightmap.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CoverageRaster {
+public:
+    // observers swept before their bitmaps are merged
+    static const int BATCH_OBSERVERS = 256;
+    // first observer of cells no observer sees
+    static const int32_t NO_OBSERVER = -1;
+
+    CoverageRaster();
+
+    // counts over all cells of map for count observers, each seeing up to its
+    // radius (measured in x-z). With firstObserver the lowest index of an
+    // observer seeing each cell is kept as well.
+    void accumulate(const Heightmap& map, const glm::vec3 *origins, const float *radii, int count,
+            float targetHeight, bool firstObserver);
+
+    // false when the file could not be written
+    bool write(const std::string& filename) const;
+
+    int rows, columns;
+    float x0, z0, cellSize;
+    std::vector<uint32_t> counts;
+    // empty unless first observers were requested
+    std::vector<int32_t> first;
+};
+
+#endif /* COVERAGE_RASTER_HPP */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   cpu_depth_renderer.hpp
+ *
+ * Interface of the backends that produce visibility volume depth images
+ * without OpenGL. The images hold exactly what the OpenGL path reads back
+ * from its reversed-Z infinite projection: zNear / (eye space depth) for
+ * pixels that see geometry and 0 (the depth clear value) elsewhere, with
+ * row 0 at the bottom of the image.
+ */
+
+#ifndef CPU_DEPTH_RENDERER_HPP
+#define CPU_DEPTH_RENDERER_HPP
+
+#include <glm/glm.hpp>
+
+class CpuDepthRenderer {
+public:
+
+    virtual ~CpuDepthRenderer() {
+    }
+
+    // render one width x height image per view matrix into depth_images[view]
+    virtual void renderDepth(const glm::mat4 *views, int numViews, float fovY_radians,
+            float aspectWbyH, float zNear, int width, int height, float **depth_images) = 0;
+};
+
+#endif /* CPU_DEPTH_RENDERER_HPP */
+
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   cube_faces.hpp
+ *
+ * The six 90 degree cameras of a visibility volume: four around the up
+ * vector starting at front, then straight up and straight down. Shared by
+ * the OpenGL path and the Python module so both render the same faces.
+ */
+
+#ifndef CUBE_FACES_HPP
+#define CUBE_FACES_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+static const int CUBE_FACES = 6;
+// azimuth about up and elevation towards up of every face, degrees
+static const float CUBE_FACE_THETAS[CUBE_FACES] = {0.0f, 90.0f, 180.0f, 270.0f, 0.0f, 0.0f};
+static const float CUBE_FACE_PHIS[CUBE_FACES] = {0.0f, 0.0f, 0.0f, 0.0f, 90.0f, -90.0f};
+
+// view matrix of the camera at origin looking along front turned by theta
+// about up, then tilted by phi about the turned side vector
+
+inline glm::mat4 cubeFaceView(const glm::vec3& origin, const glm::vec3& front, const glm::vec3& up,
+        float theta_degrees, float phi_degrees) {
+    if (theta_degrees == 0 && phi_degrees == 0) {
+        return glm::lookAt(origin, origin + front, up);
+    }
+    glm::vec4 other = glm::vec4(glm::cross(front, up), 1.0f);
+    glm::mat4 rotateAzimuth = glm::rotate(glm::mat4(1.0f), glm::radians(theta_degrees), up);
+    glm::vec4 new_other = rotateAzimuth * other;
+    glm::mat4 rotateToPhiTheta = glm::rotate(rotateAzimuth, glm::radians(phi_degrees), glm::vec3(new_other.x, new_other.y, new_other.z));
+    glm::vec4 rotatedFront4 = rotateToPhiTheta * glm::vec4(front, 1.0f);
+    glm::vec4 rotatedUp4 = rotateToPhiTheta * glm::vec4(up, 1.0f);
+    glm::vec3 rotatedFront3 = glm::vec3(rotatedFront4.x, rotatedFront4.y, rotatedFront4.z);
+    glm::vec3 rotatedUp3 = glm::vec3(rotatedUp4.x, rotatedUp4.y, rotatedUp4.z);
+    return glm::lookAt(origin, origin + rotatedFront3, rotatedUp3);
+}
+
+#endif /* CUBE_FACES_HPP */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cube_lattice.hpp"
+#include "parallel.hpp"
+#include "quadtree_mesher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+constexpr float CubeLattice::DISCONTINUITY_RATIO;
+
+// vertices sampled by one task
+static const int VERTICES_PER_TASK = 4096;
+
+CubeLattice::CubeLattice() : size(0), numVertices(0) {
+}
+
+bool CubeLattice::setup(const VolumeUnprojector& unprojector) {
+    size = unprojector.width;
+    numVertices = 0;
+    if (unprojector.numViews != 6 || unprojector.height != size || size < 1) {
+        return false;
+    }
+    int n = size + 1;
+    faceIndex.assign(6 * n * n, 0);
+    directions.clear();
+    neighbours.clear();
+    numNeighbours.clear();
+    // the cube axes are those of the first face
+    glm::mat3 toCube = glm::transpose(unprojector.rotation(0));
+    // border lattice points by their integer position on the surface of the [0, size]^3 cube
+    std::unordered_map<uint64_t, unsigned int> borderIndex;
+    std::vector<unsigned char> shareCount;
+    for (int k = 0; k < 6; k++) {
+        for (int a = 0; a <= size; a++) {
+            for (int b = 0; b <= size; b++) {
+                glm::vec3 d = unprojector.direction(k, (float) b, (float) a);
+                unsigned int v;
+                bool border = a == 0 || b == 0 || a == size || b == size;
+                if (border) {
+                    glm::vec3 c = toCube * d;
+                    c /= std::max(std::fabs(c.x), std::max(std::fabs(c.y), std::fabs(c.z)));
+                    uint64_t key = 0;
+                    for (int axis = 0; axis < 3; axis++) {
+                        key = key * n + (uint64_t) std::lround((c[axis] + 1.0f) * 0.5f * size);
+                    }
+                    std::unordered_map<uint64_t, unsigned int>::iterator it = borderIndex.find(key);
+                    if (it != borderIndex.end()) {
+                        v = it->second;
+                        shareCount[v]++;
+                    } else {
+                        v = numVertices++;
+                        borderIndex[key] = v;
+                    }
+                } else {
+                    v = numVertices++;
+                }
+                if (v == directions.size()) {
+                    directions.push_back(glm::normalize(d));
+                    shareCount.push_back(1);
+                    numNeighbours.push_back(0);
+                    neighbours.resize(MAX_NEIGHBOURS * numVertices);
+                }
+                faceIndex[(k * n + a) * n + b] = v;
+                // the up to 4 pixels of this face touching the lattice point
+                for (int i = std::max(a - 1, 0); i <= std::min(a, size - 1); i++) {
+                    for (int j = std::max(b - 1, 0); j <= std::min(b, size - 1); j++) {
+                        if (numNeighbours[v] == MAX_NEIGHBOURS) {
+                            return false;
+                        }
+                        neighbours[MAX_NEIGHBOURS * v + numNeighbours[v]++] = (k * size + i) * size + j;
+                    }
+                }
+            }
+        }
+    }
+    // a tiling cube shares every edge point twice and every corner three times
+    unsigned int numEdge = 0, numCorner = 0;
+    for (const std::pair<const uint64_t, unsigned int>& entry : borderIndex) {
+        unsigned char count = shareCount[entry.second];
+        if (count == 2) {
+            numEdge++;
+        } else if (count == 3) {
+            numCorner++;
+        } else {
+            numVertices = 0;
+            return false;
+        }
+    }
+    if (numCorner != 8 || numEdge != 12 * (unsigned int) (size - 1) ||
+            numVertices != 6 * (unsigned int) (size * size) + 2) {
+        numVertices = 0;
+        return false;
+    }
+    return true;
+}
+
+void CubeLattice::sample(const VolumeUnprojector& unprojector, const float * const *depth_images,
+        std::vector<glm::vec3>& vertices, std::vector<float>& depth) const {
+    vertices.resize(numVertices);
+    depth.resize(numVertices);
+    float zNear = unprojector.nearPlane(), depth_min = unprojector.minDepth();
+    int facePixels = size * size;
+    int numTasks = (numVertices + VERTICES_PER_TASK - 1) / VERTICES_PER_TASK;
+    parallel_for(0, numTasks, [&](int task) {
+        unsigned int begin = task * VERTICES_PER_TASK;
+        unsigned int end = std::min(begin + VERTICES_PER_TASK, numVertices);
+        for (unsigned int v = begin; v < end; v++) {
+            float rmin = 0.0f, rmax = 0.0f, rsum = 0.0f;
+            int count = numNeighbours[v];
+            for (int c = 0; c < count; c++) {
+                unsigned int pixel = neighbours[MAX_NEIGHBOURS * v + c];
+                int k = pixel / facePixels, p = pixel % facePixels;
+                // range along the pixel ray, its direction has unit eye depth
+                float r = zNear / std::max(depth_images[k][p], depth_min) *
+                        glm::length(unprojector.direction(k, p));
+                rmin = (c == 0) ? r : std::min(rmin, r);
+                rmax = (c == 0) ? r : std::max(rmax, r);
+                rsum += r;
+            }
+            float range = (rmax > DISCONTINUITY_RATIO * rmin) ? rmin : rsum / count;
+            depth[v] = zNear / range;
+            vertices[v] = unprojector.unprojectDirection(directions[v], depth[v]);
+        }
+    });
+}
+
+void CubeLattice::mesh(const VolumeUnprojector& unprojector, const float * const *depth_images,
+        float tolerance, VolumeMesh& mesh) const {
+    std::vector<float> depth;
+    sample(unprojector, depth_images, mesh.vertices, depth);
+    int n = size + 1;
+    mesh.triangles.clear();
+    if (tolerance <= 0) {
+        // two triangles per lattice quad, split and wound like the pixel mesh
+        mesh.triangles.reserve(12 * size * size);
+        for (int k = 0; k < 6; k++) {
+            for (int a = 1; a <= size; a++) {
+                for (int b = 1; b <= size; b++) {
+                    unsigned int A0 = index(k, a - 1, b - 1), A1 = index(k, a - 1, b);
+                    unsigned int B0 = index(k, a, b - 1), B1 = index(k, a, b);
+                    mesh.triangles.push_back(glm::u32vec3(A1, A0, B0));
+                    mesh.triangles.push_back(glm::u32vec3(B0, B1, A1));
+                }
+            }
+        }
+        return;
+    }
+    // the quadtree works on per face lattices, whose borders it keeps at full
+    // resolution, so mapping its output through the weld table stays closed
+    std::vector<glm::vec3> facePoints(6 * n * n);
+    std::vector<float> faceDepth(6 * n * n);
+    for (int p = 0; p < 6 * n * n; p++) {
+        facePoints[p] = mesh.vertices[faceIndex[p]];
+        faceDepth[p] = depth[faceIndex[p]];
+    }
+    const float *faceDepths[6];
+    for (int k = 0; k < 6; k++) {
+        faceDepths[k] = &faceDepth[k * n * n];
+    }
+    QuadtreeMesher mesher(tolerance);
+    mesher.mesh(faceDepths, &facePoints[0], 6, n, n, mesh.triangles);
+    for (glm::u32vec3& face : mesh.triangles) {
+        face = glm::u32vec3(faceIndex[face.x], faceIndex[face.y], faceIndex[face.z]);
+    }
+    mesh.removeUnreferencedVertices();
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   cube_lattice.hpp
+ *
+ * Welded mesh of the six cube faces of a visibility volume. Vertices sit on
+ * the pixel corners rather than the pixel centers, so the lattice points on
+ * the border of a face coincide with those of its neighbours: every point of
+ * a cube edge is shared by two faces and every cube corner by three. The
+ * shared points are found by quantizing their position on the cube surface,
+ * which gives a table from (face, row, column) to a single vertex index. The
+ * result is one closed, manifold indexed mesh of 6 * size^2 + 2 vertices
+ * without the seam and corner triangles of the stitched mesh.
+ *
+ * A lattice vertex takes its range from the pixels around it, up to four
+ * spread over two or three faces: the mean range when they agree within
+ * DISCONTINUITY_RATIO, the nearest range across a silhouette.
+ */
+
+#ifndef CUBE_LATTICE_HPP
+#define CUBE_LATTICE_HPP
+
+#include "volume_mesh.hpp"
+#include "volume_unprojector.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class CubeLattice {
+public:
+    static constexpr float DISCONTINUITY_RATIO = 1.25f;
+
+    CubeLattice();
+
+    // false unless the unprojector faces are six square 90 degree faces of a cube
+    bool setup(const VolumeUnprojector& unprojector);
+
+    // vertex of lattice point (a, b) of face k, row a and column b in [0, size]
+    unsigned int index(int k, int a, int b) const {
+        return faceIndex[(k * (size + 1) + a) * (size + 1) + b];
+    }
+
+    // limits applied positions of all vertices and their depth (zNear / range)
+    void sample(const VolumeUnprojector& unprojector, const float * const *depth_images,
+            std::vector<glm::vec3>& vertices, std::vector<float>& depth) const;
+
+    // full resolution mesh, or an adaptive quadtree mesh for tolerance > 0
+    void mesh(const VolumeUnprojector& unprojector, const float * const *depth_images,
+            float tolerance, VolumeMesh& mesh) const;
+
+    // pixels per face edge
+    int size;
+    unsigned int numVertices;
+
+private:
+    // 6 * (size + 1)^2 lattice points to vertices
+    std::vector<unsigned int> faceIndex;
+    // unit direction of every vertex
+    std::vector<glm::vec3> directions;
+    // pixels around every vertex, face * size^2 + pixel, MAX_NEIGHBOURS per vertex
+    static const int MAX_NEIGHBOURS = 4;
+    std::vector<unsigned int> neighbours;
+    std::vector<unsigned char> numNeighbours;
+};
+
+#endif /* CUBE_LATTICE_HPP */
+
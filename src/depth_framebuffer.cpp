@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "depth_framebuffer.hpp"
+
+#include <iostream>
+
+DepthFramebuffer::DepthFramebuffer() : width(0), height(0), layers(0), fbo(0), depthTexture(0) {
+}
+
+DepthFramebuffer::~DepthFramebuffer() {
+    destroy();
+}
+
+bool DepthFramebuffer::create(int _width, int _height, int _layers) {
+    if (fbo != 0 && width == _width && height == _height && layers == _layers) {
+        return true;
+    }
+    destroy();
+    width = _width;
+    height = _height;
+    layers = _layers;
+
+    GLenum target = isLayered() ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    glGenTextures(1, &depthTexture);
+    glBindTexture(target, depthTexture);
+    if (isLayered()) {
+        glTexImage3D(target, 0, GL_DEPTH_COMPONENT32F, width, height, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    } else {
+        glTexImage2D(target, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(target, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    // a layered attachment lets the geometry shader select the face through gl_Layer
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+    // depth only: fragment shader color outputs are discarded
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Depth framebuffer is incomplete (status 0x" << std::hex << status << std::dec << ")." << std::endl;
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void DepthFramebuffer::destroy() {
+    if (fbo != 0) {
+        glDeleteFramebuffers(1, &fbo);
+        fbo = 0;
+    }
+    if (depthTexture != 0) {
+        glDeleteTextures(1, &depthTexture);
+        depthTexture = 0;
+    }
+    width = height = layers = 0;
+}
+
+void DepthFramebuffer::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+}
+
+void DepthFramebuffer::unbind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void DepthFramebuffer::readDepth(GLfloat *dst, int layer) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    if (isLayered()) {
+        glGetTextureSubImage(depthTexture, 0, 0, 0, layer, width, height, 1,
+                GL_DEPTH_COMPONENT, GL_FLOAT, sizeof (GLfloat) * width * height, dst);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, dst);
+    }
+}
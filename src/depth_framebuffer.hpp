@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   depth_framebuffer.hpp
+ *
+ * Depth-only framebuffer object used to capture visibility volume faces
+ * without a window. The depth attachment is a 32-bit float texture so the
+ * reversed-Z depth values keep their full precision (a window's default
+ * framebuffer is usually limited to a 24-bit fixed point depth buffer).
+ * A layered framebuffer holds one depth image per cube face in a 2D array
+ * texture so that all faces can be rendered in a single pass.
+ */
+
+#ifndef DEPTH_FRAMEBUFFER_HPP
+#define DEPTH_FRAMEBUFFER_HPP
+
+#include <glad/glad.h>
+
+class DepthFramebuffer {
+public:
+    DepthFramebuffer();
+    ~DepthFramebuffer();
+
+    // (re)allocates the attachments, a no-op when the size is unchanged
+    bool create(int width, int height, int layers = 1);
+    void destroy();
+
+    void bind();
+    void unbind();
+
+    // synchronous read of one depth layer into dst (width x height floats)
+    void readDepth(GLfloat *dst, int layer = 0);
+
+    bool isLayered() const {
+        return layers > 1;
+    }
+
+    int width, height, layers;
+    GLuint fbo;
+    GLuint depthTexture;
+};
+
+#endif /* DEPTH_FRAMEBUFFER_HPP */
+
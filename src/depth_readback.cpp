@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "depth_readback.hpp"
+
+#include <iostream>
+
+DepthReadback::DepthReadback() : width(0), height(0) {
+}
+
+DepthReadback::~DepthReadback() {
+    destroy();
+}
+
+bool DepthReadback::create(int _width, int _height, int numSlots) {
+    if (width == _width && height == _height && (int) pbos.size() == numSlots) {
+        return true;
+    }
+    destroy();
+    width = _width;
+    height = _height;
+    pbos.resize(numSlots, 0);
+    fences.resize(numSlots, 0);
+    mapped.resize(numSlots, false);
+    glGenBuffers(numSlots, &pbos[0]);
+    for (int slot = 0; slot < numSlots; slot++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof (GLfloat) * width * height, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void DepthReadback::destroy() {
+    for (unsigned int slot = 0; slot < pbos.size(); slot++) {
+        if (mapped[slot]) {
+            unmap(slot);
+        }
+        if (fences[slot] != 0) {
+            glDeleteSync(fences[slot]);
+        }
+    }
+    if (pbos.size() > 0) {
+        glDeleteBuffers(pbos.size(), &pbos[0]);
+    }
+    pbos.clear();
+    fences.clear();
+    mapped.clear();
+    width = height = 0;
+}
+
+void DepthReadback::beginRead(int slot, DepthFramebuffer& fbo, int layer) {
+    if (mapped[slot]) {
+        unmap(slot);
+    }
+    if (fences[slot] != 0) {
+        glDeleteSync(fences[slot]);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    // with a pack buffer bound the pixel pointer is an offset and the call returns immediately
+    if (fbo.isLayered()) {
+        glGetTextureSubImage(fbo.depthTexture, 0, 0, 0, layer, width, height, 1,
+                GL_DEPTH_COMPONENT, GL_FLOAT, sizeof (GLfloat) * width * height, (void *) 0);
+    } else {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo.fbo);
+        glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, (void *) 0);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLfloat *DepthReadback::map(int slot) {
+    if (fences[slot] != 0) {
+        GLenum status;
+        do {
+            status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fences[slot]);
+        fences[slot] = 0;
+        if (status == GL_WAIT_FAILED) {
+            std::cout << "Waiting for the depth readback of slot " << slot << " failed." << std::endl;
+            return nullptr;
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+    GLfloat *data = (GLfloat *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+            sizeof (GLfloat) * width * height, GL_MAP_READ_BIT);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    mapped[slot] = (data != nullptr);
+    return data;
+}
+
+void DepthReadback::unmap(int slot) {
+    if (!mapped[slot]) {
+        return;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[slot]);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    mapped[slot] = false;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   depth_readback.hpp
+ *
+ * Asynchronous depth image readback through a ring of pixel pack buffers.
+ * Each slot receives one depth image; a fence is inserted after the read is
+ * issued and the CPU only maps the buffer once that fence has signalled, so
+ * the GPU keeps rendering subsequent faces (or volumes) during the transfer.
+ */
+
+#ifndef DEPTH_READBACK_HPP
+#define DEPTH_READBACK_HPP
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "depth_framebuffer.hpp"
+
+class DepthReadback {
+public:
+    DepthReadback();
+    ~DepthReadback();
+
+    // (re)allocates numSlots buffers of width x height floats
+    bool create(int width, int height, int numSlots);
+    void destroy();
+
+    // queue a copy of a depth layer of fbo into the buffer of a slot
+    void beginRead(int slot, DepthFramebuffer& fbo, int layer = 0);
+
+    // block until the copy into slot has completed, then map its buffer
+    GLfloat *map(int slot);
+    void unmap(int slot);
+
+    bool isPending(int slot) const {
+        return fences[slot] != 0;
+    }
+
+    int numSlots() const {
+        return (int) pbos.size();
+    }
+
+    int width, height;
+
+private:
+    std::vector<GLuint> pbos;
+    std::vector<GLsync> fences;
+    std::vector<bool> mapped;
+};
+
+#endif /* DEPTH_READBACK_HPP */
+
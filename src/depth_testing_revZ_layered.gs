@@ -0,0 +1,34 @@
+// GEOMETRY SHADER
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+uniform mat4 projection;
+uniform mat4 views[6];
+
+void main()
+{
+    for (int face = 0; face < 6; face++) {
+        mat4 viewProjection = projection * views[face];
+        vec4 clip[3];
+        for (int i = 0; i < 3; i++) {
+            clip[i] = viewProjection * gl_in[i].gl_Position;
+        }
+        // skip faces whose frustum cannot contain the triangle: all vertices
+        // outside one side plane or behind the near plane (z <= w for reversed-Z)
+        bvec3 outLeft = bvec3(clip[0].x < -clip[0].w, clip[1].x < -clip[1].w, clip[2].x < -clip[2].w);
+        bvec3 outRight = bvec3(clip[0].x > clip[0].w, clip[1].x > clip[1].w, clip[2].x > clip[2].w);
+        bvec3 outBottom = bvec3(clip[0].y < -clip[0].w, clip[1].y < -clip[1].w, clip[2].y < -clip[2].w);
+        bvec3 outTop = bvec3(clip[0].y > clip[0].w, clip[1].y > clip[1].w, clip[2].y > clip[2].w);
+        bvec3 outNear = bvec3(clip[0].z > clip[0].w, clip[1].z > clip[1].w, clip[2].z > clip[2].w);
+        if (all(outLeft) || all(outRight) || all(outBottom) || all(outTop) || all(outNear)) {
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            gl_Layer = face;
+            gl_Position = clip[i];
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
@@ -0,0 +1,11 @@
+// VERTEX SHADER
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+
+// vertices are transformed once, the geometry shader projects them into each cube face
+void main()
+{
+    gl_Position = model * vec4(aPos, 1.0);
+}
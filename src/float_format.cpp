@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "float_format.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+char *format_uint(char *out, uint32_t value) {
+    char digits[UINT_FORMAT_MAX_CHARS];
+    int n = 0;
+    do {
+        digits[n++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+// value = digits * 10^exponent with digits > 0 and free of trailing zeros
+
+static char *format_decimal(char *out, uint64_t digits, int exponent) {
+    char buf[20];
+    int n = 0;
+    while (digits != 0) {
+        buf[n++] = (char) ('0' + digits % 10);
+        digits /= 10;
+    }
+    // digits in front of the decimal point
+    int point = n + exponent;
+    if (point > 9 || point < -4) {
+        *out++ = buf[n - 1];
+        if (n > 1) {
+            *out++ = '.';
+            for (int d = n - 2; d >= 0; d--) {
+                *out++ = buf[d];
+            }
+        }
+        *out++ = 'e';
+        int e10 = point - 1;
+        if (e10 < 0) {
+            *out++ = '-';
+            e10 = -e10;
+        }
+        return format_uint(out, (uint32_t) e10);
+    }
+    if (point <= 0) {
+        *out++ = '0';
+        *out++ = '.';
+        for (int z = 0; z < -point; z++) {
+            *out++ = '0';
+        }
+        for (int d = n - 1; d >= 0; d--) {
+            *out++ = buf[d];
+        }
+        return out;
+    }
+    for (int d = n - 1; d >= 0; d--) {
+        if (n - 1 - d == point) {
+            *out++ = '.';
+        }
+        *out++ = buf[d];
+    }
+    for (int z = n; z < point; z++) {
+        *out++ = '0';
+    }
+    return out;
+}
+
+// shortest digits by trying 1 to 9 significant digits with printf, exact but slow
+
+static void shortest_digits_printf(float value, uint64_t& digits, int& exponent) {
+    char text[32];
+    for (int precision = 0; precision < 9; precision++) {
+        snprintf(text, sizeof (text), "%.*e", precision, value);
+        if (strtof(text, nullptr) == value || precision == 8) {
+            break;
+        }
+    }
+    // "d.ddde+XX"
+    digits = 0;
+    int numFraction = 0;
+    char *c = text;
+    for (; *c != 'e'; c++) {
+        if (*c >= '0' && *c <= '9') {
+            digits = 10 * digits + (uint64_t) (*c - '0');
+            numFraction++;
+        }
+    }
+    exponent = atoi(c + 1) - (numFraction - 1);
+    while (digits % 10 == 0) {
+        digits /= 10;
+        exponent++;
+    }
+}
+
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 uint128;
+
+static uint128 pow10_128(int n) {
+    uint128 p = 1;
+    for (int i = 0; i < n; i++) {
+        p *= 10;
+    }
+    return p;
+}
+
+// rounding state of the digits dropped from the value
+enum DroppedFraction {
+    ZERO, BELOW_HALF, HALF, ABOVE_HALF
+};
+
+// exact shortest digits for normal floats of binary exponent q in [-60, 60],
+// value = mant * 2^q with mant in [2^23, 2^24)
+
+static bool shortest_digits_exact(float value, uint64_t& digits, int& exponent) {
+    int e2;
+    float m = std::frexp(value, &e2);
+    int q = e2 - 24;
+    if (q < -60 || q > 60) {
+        return false;
+    }
+    uint32_t mant = (uint32_t) std::ldexp(m, 24);
+    // the value and the midpoints to its neighbours in units of 2^(q - 2),
+    // the gap below a power of two is half the gap above
+    uint64_t uX = 4 * (uint64_t) mant;
+    uint64_t uL = uX - ((mant == (1u << 23)) ? 1 : 2);
+    uint64_t uH = uX + 2;
+    // midpoints round to the even mantissa
+    bool inclusive = (mant & 1) == 0;
+
+    // start with at least 9 significant digits, the interval then spans hundreds of units
+    int k = (int) std::floor((e2 - 1) * 0.30102999566398120);
+    int p = k - 9;
+    int s = q - 2;
+    uint128 scale = ((s > 0) ? ((uint128) 1 << s) : 1) * ((p < 0) ? pow10_128(-p) : 1);
+    uint128 den = ((s < 0) ? ((uint128) 1 << -s) : 1) * ((p > 0) ? pow10_128(p) : 1);
+    uint128 nL = uL * scale, nX = uX * scale, nH = uH * scale;
+    uint64_t lo = (uint64_t) (nL / den), xv = (uint64_t) (nX / den), hi = (uint64_t) (nH / den);
+    bool loExact = nL % den == 0, hiExact = nH % den == 0;
+    uint128 remX = nX % den;
+    DroppedFraction dropped = (remX == 0) ? ZERO : (2 * remX < den) ? BELOW_HALF :
+            (2 * remX == den) ? HALF : ABOVE_HALF;
+    uint64_t low = (loExact && inclusive) ? lo : lo + 1;
+    uint64_t high = (hiExact && !inclusive) ? hi - 1 : hi;
+
+    // drop digits while an integer remains inside the interval
+    for (;;) {
+        bool loExact10 = loExact && lo % 10 == 0, hiExact10 = hiExact && hi % 10 == 0;
+        uint64_t lo10 = lo / 10, hi10 = hi / 10;
+        uint64_t low10 = (loExact10 && inclusive) ? lo10 : lo10 + 1;
+        uint64_t high10 = (hiExact10 && !inclusive) ? hi10 - 1 : hi10;
+        if (hi10 == 0 || low10 > high10) {
+            break;
+        }
+        int d = (int) (xv % 10);
+        dropped = (d > 5 || (d == 5 && dropped != ZERO)) ? ABOVE_HALF :
+                (d == 5) ? HALF : (d == 0 && dropped == ZERO) ? ZERO : BELOW_HALF;
+        xv /= 10;
+        lo = lo10;
+        hi = hi10;
+        loExact = loExact10;
+        hiExact = hiExact10;
+        low = low10;
+        high = high10;
+        p++;
+    }
+    // the representation closest to the value
+    if (dropped == ABOVE_HALF || (dropped == HALF && (xv & 1))) {
+        xv++;
+    }
+    xv = (xv < low) ? low : (xv > high) ? high : xv;
+    while (xv % 10 == 0) {
+        xv /= 10;
+        p++;
+    }
+    digits = xv;
+    exponent = p;
+    return true;
+}
+#else
+
+static bool shortest_digits_exact(float, uint64_t&, int&) {
+    return false;
+}
+#endif
+
+char *format_float(char *out, float value) {
+    if (std::isnan(value)) {
+        memcpy(out, "nan", 3);
+        return out + 3;
+    }
+    if (std::signbit(value)) {
+        *out++ = '-';
+        value = -value;
+    }
+    if (std::isinf(value)) {
+        memcpy(out, "inf", 3);
+        return out + 3;
+    }
+    if (value == 0.0f) {
+        *out++ = '0';
+        return out;
+    }
+    uint64_t digits;
+    int exponent;
+    if (!shortest_digits_exact(value, digits, exponent)) {
+        shortest_digits_printf(value, digits, exponent);
+    }
+    return format_decimal(out, digits, exponent);
+}
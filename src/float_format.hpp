@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   float_format.hpp
+ *
+ * Number formatting for the text mesh writers without printf. format_float
+ * writes the shortest decimal that reads back to exactly the same float, so
+ * no precision is lost (unlike "%f") and no digits are wasted (unlike
+ * "%.9g"). The digits are found with exact integer arithmetic: the interval
+ * of reals rounding to the float is scaled to 9 or more decimal digits and
+ * digits are dropped while the interval still contains an integer. Values of
+ * magnitude below about 1e-11 or above 1e25 fall back to a snprintf search.
+ */
+
+#ifndef FLOAT_FORMAT_HPP
+#define FLOAT_FORMAT_HPP
+
+#include <cstdint>
+
+// longest output of format_float, e.g. "-1.17549435e-38"
+static const int FLOAT_FORMAT_MAX_CHARS = 16;
+// longest output of format_uint
+static const int UINT_FORMAT_MAX_CHARS = 10;
+
+// shortest round trip representation of value, returns the end of the
+// written characters (no terminating 0). Fixed notation is used for decimal
+// exponents -5 to 8, scientific notation ("1.5e-7") otherwise.
+char *format_float(char *out, float value);
+
+// decimal digits of value, returns the end of the written characters
+char *format_uint(char *out, uint32_t value);
+
+#endif /* FLOAT_FORMAT_HPP */
+
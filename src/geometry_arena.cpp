@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "geometry_arena.hpp"
+#include "scene_geometry.hpp"
+
+#include <iostream>
+
+GeometryArena::GeometryArena() : vao(0), vbo(0), ibo(0), commandBuffer(0), commandBytes(0) {
+}
+
+GeometryArena::~GeometryArena() {
+    destroy();
+}
+
+int GeometryArena::add(const std::vector<glm::vec3>& mesh_positions, const std::vector<unsigned int>& mesh_indices,
+        const glm::mat4& xform) {
+    DrawElementsIndirectCommand command;
+    command.count = (GLuint) mesh_indices.size();
+    command.instanceCount = 1;
+    command.firstIndex = (GLuint) indices.size();
+    command.baseVertex = (GLint) positions.size();
+    command.baseInstance = 0;
+    commands.push_back(command);
+    positions.reserve(positions.size() + mesh_positions.size());
+    for (const glm::vec3& p : mesh_positions) {
+        positions.push_back(SceneGeometry::transformPoint(xform, p));
+    }
+    indices.insert(indices.end(), mesh_indices.begin(), mesh_indices.end());
+    return (int) commands.size() - 1;
+}
+
+bool GeometryArena::upload() {
+    // without buffers the meshes are drawn one by one, the CPU copies are not needed
+    if (glMultiDrawElementsIndirect == NULL) {
+        std::cout << "glMultiDrawElementsIndirect() requires OpenGL 4.3, meshes are drawn one by one." << std::endl;
+        destroy();
+        return false;
+    }
+    if (positions.empty() || indices.empty()) {
+        destroy();
+        return false;
+    }
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+    glGenBuffers(1, &commandBuffer);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof (glm::vec3), &positions[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof (GLuint), &indices[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof (glm::vec3), (void *) 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    commandBytes = commands.size() * sizeof (DrawElementsIndirectCommand);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    std::vector<glm::vec3>().swap(positions);
+    std::vector<GLuint>().swap(indices);
+    compacted.reserve(commands.size());
+    return true;
+}
+
+void GeometryArena::destroy() {
+    if (vao != 0) {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ibo);
+        glDeleteBuffers(1, &commandBuffer);
+    }
+    vao = vbo = ibo = commandBuffer = 0;
+    commandBytes = 0;
+    std::vector<DrawElementsIndirectCommand>().swap(commands);
+    std::vector<DrawElementsIndirectCommand>().swap(compacted);
+    std::vector<glm::vec3>().swap(positions);
+    std::vector<GLuint>().swap(indices);
+}
+
+const std::vector<GeometryArena::DrawElementsIndirectCommand>& GeometryArena::compact(const std::vector<int>& items) {
+    compacted.clear();
+    for (int item : items) {
+        if (commands[item].count > 0) {
+            compacted.push_back(commands[item]);
+        }
+    }
+    return compacted;
+}
+
+void GeometryArena::draw(const std::vector<int>& items) {
+    if (compact(items).empty()) {
+        return;
+    }
+    glBindVertexArray(vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    // orphan the storage so the commands of the previous face, possibly still
+    // in flight, are not waited on
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commandBytes, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, compacted.size() * sizeof (DrawElementsIndirectCommand), &compacted[0]);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *) 0, (GLsizei) compacted.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   geometry_arena.hpp
+ *
+ * Scene-wide vertex and index buffers for the depth passes. Every learnopengl
+ * Mesh owns a vertex array, so a scene split into thousands of groups costs
+ * thousands of glBindVertexArray and glDrawElements calls per cube face. The
+ * arena instead packs the world space positions of all meshes into one
+ * vertex buffer and their indices into one index buffer, behind a single
+ * vertex array. A face is drawn with one glMultiDrawElementsIndirect over a
+ * command buffer holding only the meshes that survive culling, so the
+ * driver overhead per face no longer grows with the number of meshes.
+ *
+ * Positions are stored already transformed, the model matrix of the shader
+ * must be the identity. The depth shaders read only the position, so the
+ * arena keeps 12 bytes per vertex and no other attribute.
+ */
+
+#ifndef GEOMETRY_ARENA_HPP
+#define GEOMETRY_ARENA_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class GeometryArena {
+public:
+    // layout of glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    GeometryArena();
+    ~GeometryArena();
+
+    // appends a mesh placed by xform the way the "model" matrix of the
+    // shaders places it, divide by w included. Indices refer to the mesh's
+    // own vertices. Returns the index of its draw command.
+    int add(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+            const glm::mat4& xform);
+
+    // creates the buffers from the meshes added so far. The CPU copies are
+    // released, also when it fails and the meshes are drawn one by one.
+    bool upload();
+    void destroy();
+
+    // one indirect draw of the meshes items, compacted into the command buffer
+    void draw(const std::vector<int>& items);
+
+    // the commands of the meshes items that have any index, as draw() writes
+    // them to the command buffer, valid until the next call
+    const std::vector<DrawElementsIndirectCommand>& compact(const std::vector<int>& items);
+
+    int size() const {
+        return (int) commands.size();
+    }
+
+    bool isUploaded() const {
+        return vao != 0;
+    }
+
+    // world space positions and mesh relative indices of the meshes added so
+    // far, empty once uploaded
+    const std::vector<glm::vec3>& vertexData() const {
+        return positions;
+    }
+
+    const std::vector<GLuint>& indexData() const {
+        return indices;
+    }
+
+private:
+    std::vector<DrawElementsIndirectCommand> commands;
+    // commands of the current draw
+    std::vector<DrawElementsIndirectCommand> compacted;
+    std::vector<glm::vec3> positions;
+    std::vector<GLuint> indices;
+    GLuint vao, vbo, ibo, commandBuffer;
+    // bytes allocated for the command buffer
+    size_t commandBytes;
+};
+
+#endif /* GEOMETRY_ARENA_HPP */
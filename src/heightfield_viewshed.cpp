@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "heightfield_viewshed.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+constexpr float HeightfieldViewshed::OUTSIDE;
+
+// perimeter rays of each octant in cyclic order around the eye: the major
+// axis (x or z) advances one cell per step, the minor axis by rounding.
+// Perimeter cell m of an octant lies at major = n, minor = m (signs applied)
+// for m in [first, last]; diagonals and axes are assigned to one octant only.
+struct Octant {
+    bool majorX;
+    int majorSign, minorSign;
+    // first and last perimeter offset, the last relative to n
+    int first, lastOffset;
+};
+
+static const Octant OCTANTS[8] = {
+    {true, 1, 1, 0, 0},
+    {false, 1, 1, 0, -1},
+    {false, 1, -1, 1, -1},
+    {true, -1, 1, 0, 0},
+    {true, -1, -1, 1, 0},
+    {false, -1, -1, 0, -1},
+    {false, -1, 1, 1, -1},
+    {true, 1, -1, 1, 0}
+};
+
+HeightfieldViewshed::HeightfieldViewshed() : row0(0), column0(0), rows(0), columns(0), map(nullptr),
+        eye(0.0f), radius(0.0f), eyeRow(0), eyeColumn(0) {
+}
+
+void HeightfieldViewshed::compute(const Heightmap& heightmap, const glm::vec3& eye_position, float radius_max) {
+    map = &heightmap;
+    eye = eye_position;
+    radius = radius_max;
+    eyeRow = map->row(eye.z);
+    eyeColumn = map->column(eye.x);
+    // half size of the window, no larger than needed to reach every map cell
+    int farthest = std::max(std::max(std::abs(eyeRow), std::abs(map->rows - 1 - eyeRow)),
+            std::max(std::abs(eyeColumn), std::abs(map->columns - 1 - eyeColumn)));
+    int n = (int) std::min((double) farthest, std::ceil((double) radius / map->cellSize));
+    row0 = std::max(eyeRow - n, 0);
+    column0 = std::max(eyeColumn - n, 0);
+    rows = std::max(std::min(eyeRow + n, map->rows - 1) - row0 + 1, 0);
+    columns = std::max(std::min(eyeColumn + n, map->columns - 1) - column0 + 1, 0);
+    horizon.assign((size_t) rows * columns, OUTSIDE);
+    if (rows == 0 || columns == 0) {
+        return;
+    }
+    if (map->contains(eyeRow, eyeColumn)) {
+        horizon[(size_t) (eyeRow - row0) * columns + (eyeColumn - column0)] = Heightmap::NO_SURFACE;
+    }
+    for (int phase = 0; phase < 2; phase++) {
+        parallel_for(0, 4, [&](int k) {
+            sweepOctant(2 * k + phase, n);
+        });
+    }
+}
+
+void HeightfieldViewshed::sweepOctant(int octant, int n) {
+    const Octant& o = OCTANTS[octant];
+    for (int m = o.first; m <= n + o.lastOffset; m++) {
+        float slope = -FLT_MAX;
+        for (int i = 1; i <= n; i++) {
+            int a = o.majorSign * i;
+            // i * m / n rounded half up
+            int b = o.minorSign * (int) ((2LL * i * m + n) / (2LL * n));
+            int dx = o.majorX ? a : b, dz = o.majorX ? b : a;
+            float distance = map->cellSize * std::sqrt((float) (dx * dx + dz * dz));
+            if (distance > radius) {
+                break;
+            }
+            int r = eyeRow + dz, c = eyeColumn + dx;
+            if (!map->contains(r, c)) {
+                continue;
+            }
+            float& h = horizon[(size_t) (r - row0) * columns + (c - column0)];
+            h = std::min(h, (slope == -FLT_MAX) ? Heightmap::NO_SURFACE : eye.y + slope * distance);
+            float ground = map->at(r, c);
+            if (ground != Heightmap::NO_SURFACE) {
+                slope = std::max(slope, (ground - eye.y) / distance);
+            }
+        }
+    }
+}
+
+float HeightfieldViewshed::horizonAt(int row, int column) const {
+    if (row < row0 || row >= row0 + rows || column < column0 || column >= column0 + columns) {
+        return OUTSIDE;
+    }
+    return horizon[(size_t) (row - row0) * columns + (column - column0)];
+}
+
+bool HeightfieldViewshed::visible(int row, int column, float targetHeight) const {
+    float h = horizonAt(row, column);
+    if (h == OUTSIDE || map->at(row, column) == Heightmap::NO_SURFACE) {
+        return false;
+    }
+    return map->at(row, column) + targetHeight >= h;
+}
+
+void HeightfieldViewshed::mesh(float up_min, float up_max, VolumeMesh& result) const {
+    result.clear();
+    static const unsigned int NONE = 0xFFFFFFFFu;
+    // vertex pair of every cell within the radius, bottom at 2k, top at 2k + 1
+    std::vector<unsigned int> index((size_t) rows * columns, NONE);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < columns; j++) {
+            float h = horizon[(size_t) i * columns + j];
+            glm::vec2 xz = map->center(row0 + i, column0 + j);
+            float d2 = (xz.x - eye.x) * (xz.x - eye.x) + (xz.y - eye.z) * (xz.y - eye.z);
+            if (h == OUTSIDE || d2 > radius * radius) {
+                continue;
+            }
+            float halfChord = std::sqrt(radius * radius - d2);
+            float top = std::min(up_max, eye.y + halfChord);
+            float bottom = std::max(std::max(map->at(row0 + i, column0 + j), h), std::max(up_min, eye.y - halfChord));
+            index[(size_t) i * columns + j] = (unsigned int) result.vertices.size();
+            result.vertices.push_back(glm::vec3(xz.x, std::min(bottom, top), xz.y));
+            result.vertices.push_back(glm::vec3(xz.x, top, xz.y));
+        }
+    }
+    // quad (i, j) spans the centers of cells (i, j) to (i + 1, j + 1)
+    auto quad = [&](int i, int j) {
+        return i >= 0 && i + 1 < rows && j >= 0 && j + 1 < columns &&
+                index[(size_t) i * columns + j] != NONE && index[(size_t) i * columns + j + 1] != NONE &&
+                index[(size_t) (i + 1) * columns + j] != NONE && index[(size_t) (i + 1) * columns + j + 1] != NONE;
+    };
+    for (int i = 0; i + 1 < rows; i++) {
+        for (int j = 0; j + 1 < columns; j++) {
+            if (!quad(i, j)) {
+                continue;
+            }
+            // corners counter-clockwise seen from below, so the bottom faces down
+            unsigned int corner[4] = {index[(size_t) i * columns + j], index[(size_t) i * columns + j + 1],
+                index[(size_t) (i + 1) * columns + j + 1], index[(size_t) (i + 1) * columns + j]};
+            result.triangles.push_back(glm::u32vec3(corner[0], corner[1], corner[2]));
+            result.triangles.push_back(glm::u32vec3(corner[0], corner[2], corner[3]));
+            result.triangles.push_back(glm::u32vec3(corner[0] + 1, corner[2] + 1, corner[1] + 1));
+            result.triangles.push_back(glm::u32vec3(corner[0] + 1, corner[3] + 1, corner[2] + 1));
+            // a wall under every edge not shared with another quad
+            bool border[4] = {!quad(i - 1, j), !quad(i, j + 1), !quad(i + 1, j), !quad(i, j - 1)};
+            for (int e = 0; e < 4; e++) {
+                if (border[e]) {
+                    unsigned int p = corner[e], q = corner[(e + 1) % 4];
+                    result.triangles.push_back(glm::u32vec3(q, p, p + 1));
+                    result.triangles.push_back(glm::u32vec3(q, p + 1, q + 1));
+                }
+            }
+        }
+    }
+    result.removeUnreferencedVertices();
+}
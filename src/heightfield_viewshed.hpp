@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   heightfield_viewshed.hpp
+ *
+ * Viewshed and visibility volume of an observer over a Heightmap, for scenes
+ * where line of sight is decided by the top surface of each column (terrain,
+ * cities without overhangs). Instead of capturing a cube of depth images and
+ * unprojecting them, the horizon of every cell is found by one sweep of the
+ * grid with the R2 algorithm: a ray is walked from the observer cell to each
+ * cell on the perimeter of the square window around the observer, keeping
+ * the steepest slope met so far. The lowest visible height of a cell is
+ *
+ *     horizon = eye.y + slope * distance
+ *
+ * with slope the steepest over the cells before it on its ray. Cells reached
+ * by several rays keep the lowest horizon. This is the usual R2 trade of
+ * exactness near the observer for O(n^2) work on an n x n window, which for a
+ * few thousand observers is what keeps viewsheds interactive.
+ *
+ * The rays of one octant of the window only share cells with the two
+ * neighbouring octants, so the even octants are swept in parallel, then the
+ * odd ones. When compute() is called from an item of a parallel loop over
+ * observers, on any thread of the pool, the octants are swept serially.
+ *
+ * The visibility volume is the space above max(ground, horizon) within the
+ * radius and height limits. mesh() bounds it with one vertex pair per cell:
+ * a bottom surface at that lower envelope, a top surface on the radius
+ * sphere or at up_max, and vertical walls along the border of the window.
+ */
+
+#ifndef HEIGHTFIELD_VIEWSHED_HPP
+#define HEIGHTFIELD_VIEWSHED_HPP
+
+#include "heightmap.hpp"
+#include "volume_mesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <vector>
+
+class HeightfieldViewshed {
+public:
+    // horizon of window cells beyond the radius, which no ray reaches
+    static constexpr float OUTSIDE = FLT_MAX;
+
+    HeightfieldViewshed();
+
+    // horizon of every cell within radius (measured in x-z) of the eye
+    void compute(const Heightmap& map, const glm::vec3& eye, float radius);
+
+    // whether the point targetHeight above the ground of map cell (row,
+    // column) is visible, false outside the window and for empty cells
+    bool visible(int row, int column, float targetHeight = 0.0f) const;
+
+    // lowest visible height of map cell (row, column), OUTSIDE beyond the
+    // radius and Heightmap::NO_SURFACE where nothing occludes
+    float horizonAt(int row, int column) const;
+
+    // closed boundary of the visible space within the radius sphere about
+    // the eye, with heights (world y) clamped to [up_min, up_max]. Needs a
+    // finite radius in compute().
+    void mesh(float up_min, float up_max, VolumeMesh& result) const;
+
+    // window of map cells covered, rows [row0, row0 + rows)
+    int row0, column0, rows, columns;
+
+private:
+    // walk the rays to the perimeter cells of one octant
+    void sweepOctant(int octant, int radiusCells);
+
+    const Heightmap *map;
+    glm::vec3 eye;
+    float radius;
+    // map cell of the eye
+    int eyeRow, eyeColumn;
+    // row major over the window
+    std::vector<float> horizon;
+};
+
+#endif /* HEIGHTFIELD_VIEWSHED_HPP */
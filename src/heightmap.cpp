@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "heightmap.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+constexpr float Heightmap::NO_SURFACE;
+
+Heightmap::Heightmap() : rows(0), columns(0), cellSize(1.0f), x0(0.0f), z0(0.0f) {
+}
+
+int Heightmap::column(float x) const {
+    return (int) std::floor((x - x0) / cellSize);
+}
+
+int Heightmap::row(float z) const {
+    return (int) std::floor((z - z0) / cellSize);
+}
+
+bool Heightmap::build(const SceneGeometry& scene, float size) {
+    rows = columns = 0;
+    heights.clear();
+    if (scene.empty() || !(size > 0.0f)) {
+        return false;
+    }
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (const glm::vec3& v : scene.vertices) {
+        lo = glm::min(lo, v);
+        hi = glm::max(hi, v);
+    }
+    double numColumns = std::floor((hi.x - lo.x) / size) + 1.0, numRows = std::floor((hi.z - lo.z) / size) + 1.0;
+    if (numColumns * numRows > (double) MAX_CELLS) {
+        std::cout << "Heightmap of " << numColumns << " x " << numRows << " cells exceeds the limit of "
+                << MAX_CELLS << " cells, choose a larger cell size." << std::endl;
+        return false;
+    }
+    cellSize = size;
+    columns = (int) numColumns;
+    rows = (int) numRows;
+    // center the grid on the bounds
+    x0 = 0.5f * (lo.x + hi.x - columns * cellSize);
+    z0 = 0.5f * (lo.z + hi.z - rows * cellSize);
+    heights.assign((size_t) rows * columns, NO_SURFACE);
+
+    // triangles overlapping each strip, in scene order
+    int numStrips = (rows + STRIP_ROWS - 1) / STRIP_ROWS;
+    std::vector<std::vector<unsigned int> > strips(numStrips);
+    for (unsigned int t = 0; t < scene.triangles.size(); t++) {
+        const glm::u32vec3& tri = scene.triangles[t];
+        float zmin = std::min(std::min(scene.vertices[tri.x].z, scene.vertices[tri.y].z), scene.vertices[tri.z].z);
+        float zmax = std::max(std::max(scene.vertices[tri.x].z, scene.vertices[tri.y].z), scene.vertices[tri.z].z);
+        int first = std::max(row(zmin), 0) / STRIP_ROWS, last = std::min(row(zmax), rows - 1) / STRIP_ROWS;
+        for (int s = first; s <= last; s++) {
+            strips[s].push_back(t);
+        }
+    }
+
+    parallel_for(0, numStrips, [&](int s) {
+        int r0 = s * STRIP_ROWS, r1 = std::min(r0 + STRIP_ROWS, rows) - 1;
+        for (unsigned int t : strips[s]) {
+            const glm::u32vec3& tri = scene.triangles[t];
+            // grid coordinates with cell centers at integers
+            glm::vec3 p[3];
+            for (int c = 0; c < 3; c++) {
+                const glm::vec3& v = scene.vertices[tri[c]];
+                p[c] = glm::vec3((v.x - x0) / cellSize - 0.5f, v.y, (v.z - z0) / cellSize - 0.5f);
+            }
+            // signed doubled area in x-z, zero for vertical triangles which
+            // cover no cell center and never top a column
+            float area = (p[1].x - p[0].x) * (p[2].z - p[0].z) - (p[2].x - p[0].x) * (p[1].z - p[0].z);
+            if (area == 0.0f) {
+                continue;
+            }
+            int i0 = std::max((int) std::ceil(std::min(std::min(p[0].z, p[1].z), p[2].z)), r0);
+            int i1 = std::min((int) std::floor(std::max(std::max(p[0].z, p[1].z), p[2].z)), r1);
+            int j0 = std::max((int) std::ceil(std::min(std::min(p[0].x, p[1].x), p[2].x)), 0);
+            int j1 = std::min((int) std::floor(std::max(std::max(p[0].x, p[1].x), p[2].x)), columns - 1);
+            for (int i = i0; i <= i1; i++) {
+                for (int j = j0; j <= j1; j++) {
+                    // barycentric weights, inclusive edges so a center on a
+                    // shared edge is covered by both triangles
+                    float w[3];
+                    for (int c = 0; c < 3; c++) {
+                        const glm::vec3& a = p[(c + 1) % 3];
+                        const glm::vec3& b = p[(c + 2) % 3];
+                        w[c] = ((b.x - a.x) * (i - a.z) - (j - a.x) * (b.z - a.z)) / area;
+                    }
+                    if (w[0] < 0.0f || w[1] < 0.0f || w[2] < 0.0f) {
+                        continue;
+                    }
+                    float& h = heights[(size_t) i * columns + j];
+                    h = std::max(h, w[0] * p[0].y + w[1] * p[1].y + w[2] * p[2].y);
+                }
+            }
+        }
+    });
+    return true;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   heightmap.hpp
+ *
+ * 2.5D view of a scene: the height of its top surface along world +y sampled
+ * at the centers of a regular grid over the x-z plane. Terrain and city
+ * models are height fields up to overhangs, so a heightmap rasterized once
+ * stands in for the triangle soup wherever line of sight only needs the
+ * highest surface of each column (see HeightfieldViewshed).
+ *
+ * Triangles are binned into strips of STRIP_ROWS grid rows and every strip is
+ * rasterized by one task, keeping the highest interpolated height per cell, so
+ * no two tasks write the same cell.
+ */
+
+#ifndef HEIGHTMAP_HPP
+#define HEIGHTMAP_HPP
+
+#include "scene_geometry.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <vector>
+
+class Heightmap {
+public:
+    // height of cells whose center no triangle covers
+    static constexpr float NO_SURFACE = -FLT_MAX;
+    // grid rows rasterized by one task
+    static const int STRIP_ROWS = 64;
+    // largest grid build() accepts, 2^28 cells or 1 GiB of heights
+    static const size_t MAX_CELLS = (size_t) 1 << 28;
+
+    Heightmap();
+
+    // grid of square cells of side cellSize over the x-z bounds of scene,
+    // false for an empty scene or a grid above MAX_CELLS
+    bool build(const SceneGeometry& scene, float cellSize);
+
+    // row runs along z, column along x
+    float at(int row, int column) const {
+        return heights[(size_t) row * columns + column];
+    }
+
+    bool contains(int row, int column) const {
+        return row >= 0 && row < rows && column >= 0 && column < columns;
+    }
+
+    // cell containing world x or z, may lie outside the grid
+    int column(float x) const;
+    int row(float z) const;
+
+    // world x, z of a cell center
+    glm::vec2 center(int row, int column) const {
+        return glm::vec2(x0 + (column + 0.5f) * cellSize, z0 + (row + 0.5f) * cellSize);
+    }
+
+    int rows, columns;
+    float cellSize;
+    // world x, z of the grid corner
+    float x0, z0;
+    std::vector<float> heights;
+};
+
+#endif /* HEIGHTMAP_HPP */
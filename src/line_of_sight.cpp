@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "line_of_sight.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// 10 bits spread to every third bit
+static inline uint32_t spreadBits(uint32_t x) {
+    x &= 0x3FF;
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// cube face of d and a 4x4 cell within that face, 7 bits
+static uint32_t directionCell(const glm::vec3& d) {
+    glm::vec3 a = glm::abs(d);
+    int axis = (a.x >= a.y && a.x >= a.z) ? 0 : ((a.y >= a.z) ? 1 : 2);
+    if (a[axis] == 0.0f) {
+        return 0;
+    }
+    float u = d[(axis + 1) % 3] / a[axis], v = d[(axis + 2) % 3] / a[axis];
+    uint32_t cu = std::min((uint32_t) ((u + 1.0f) * 2.0f), 3u);
+    uint32_t cv = std::min((uint32_t) ((v + 1.0f) * 2.0f), 3u);
+    uint32_t face = 2 * axis + (d[axis] < 0.0f);
+    return (face << 4) | (cu << 2) | cv;
+}
+
+LineOfSight::LineOfSight(const BVH& bvh, float tolerance) : bvh(bvh), tolerance(tolerance) {
+}
+
+uint32_t LineOfSight::mortonCode(const glm::vec3& p) const {
+    glm::vec3 lo = bvh.boundsMin(), extent = bvh.boundsMax() - lo;
+    uint32_t code = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float f = (extent[axis] > 0.0f) ? (p[axis] - lo[axis]) / extent[axis] : 0.0f;
+        code |= spreadBits((uint32_t) std::min(std::max(f * 1024.0f, 0.0f), 1023.0f)) << axis;
+    }
+    return code;
+}
+
+int LineOfSight::trace(const glm::vec3 * const *from, const glm::vec3 * const *to, int count) const {
+    RayPacket4 packet;
+    for (int lane = 0; lane < 4; lane++) {
+        if (lane >= count) {
+            packet.disableLane(lane);
+            continue;
+        }
+        glm::vec3 d = *to[lane] - *from[lane];
+        float length = glm::length(d);
+        // segments no longer than twice the tolerance have an empty interval and are visible
+        float margin = (length > 0.0f) ? tolerance / length : 1.0f;
+        packet.setRay(lane, *from[lane], d, margin, 1.0f - margin);
+    }
+    packet.finalize();
+    return ~bvh.occluded(packet).mask() & ((1 << count) - 1);
+}
+
+void LineOfSight::test(const glm::vec3 *from, const glm::vec3 *to, size_t count, uint64_t *visible) const {
+    int numTasks = (int) ((count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    parallel_for(0, numTasks, [&](int task) {
+        size_t begin = (size_t) task * BLOCK_SIZE;
+        int size = (int) std::min((size_t) BLOCK_SIZE, count - begin);
+        // the segments of the block by start point, then by direction cell
+        std::vector<std::pair<uint64_t, int> > order(size);
+        for (int n = 0; n < size; n++) {
+            size_t s = begin + n;
+            uint64_t key = ((uint64_t) mortonCode(from[s]) << 7) | directionCell(to[s] - from[s]);
+            order[n] = std::make_pair(key, n);
+        }
+        std::sort(order.begin(), order.end());
+        std::fill(visible + begin / 64, visible + (begin + size + 63) / 64, 0);
+        for (int n = 0; n < size; n += 4) {
+            int lanes = std::min(4, size - n);
+            const glm::vec3 *a[4], *b[4];
+            for (int l = 0; l < lanes; l++) {
+                a[l] = &from[begin + order[n + l].second];
+                b[l] = &to[begin + order[n + l].second];
+            }
+            int bits = trace(a, b, lanes);
+            for (int l = 0; l < lanes; l++) {
+                size_t s = begin + order[n + l].second;
+                visible[s / 64] |= (uint64_t) ((bits >> l) & 1) << (s % 64);
+            }
+        }
+    });
+}
+
+void LineOfSight::matrix(const glm::vec3 *sites, size_t numSites, const glm::vec3 *targets, size_t numTargets,
+        uint64_t *visible) const {
+    size_t words = rowWords(numTargets);
+    std::fill(visible, visible + numSites * words, 0);
+    // the targets in Morton order
+    std::vector<std::pair<uint32_t, size_t> > order(numTargets);
+    for (size_t j = 0; j < numTargets; j++) {
+        order[j] = std::make_pair(mortonCode(targets[j]), j);
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<glm::vec3> sorted(numTargets);
+    for (size_t n = 0; n < numTargets; n++) {
+        sorted[n] = targets[order[n].second];
+    }
+    // rows in sorted target order, scattered to the order of the caller below
+    std::vector<uint64_t> sortedRows(numSites * words, 0);
+    size_t blocksPerSite = (numTargets + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    parallel_for(0, (int) (numSites * blocksPerSite), [&](int task) {
+        size_t site = task / blocksPerSite;
+        size_t begin = (task % blocksPerSite) * BLOCK_SIZE;
+        size_t end = std::min(begin + BLOCK_SIZE, numTargets);
+        uint64_t *row = &sortedRows[site * words];
+        const glm::vec3 *a[4] = {&sites[site], &sites[site], &sites[site], &sites[site]};
+        for (size_t n = begin; n < end; n += 4) {
+            int lanes = (int) std::min((size_t) 4, end - n);
+            const glm::vec3 *b[4];
+            for (int l = 0; l < lanes; l++) {
+                b[l] = &sorted[n + l];
+            }
+            // packets start at multiples of 4 and never straddle a word
+            row[n / 64] |= (uint64_t) trace(a, b, lanes) << (n % 64);
+        }
+    });
+    parallel_for(0, (int) numSites, [&](int site) {
+        const uint64_t *in = &sortedRows[site * words];
+        uint64_t *out = &visible[site * words];
+        for (size_t n = 0; n < numTargets; n++) {
+            if ((in[n / 64] >> (n % 64)) & 1) {
+                size_t j = order[n].second;
+                out[j / 64] |= (uint64_t) 1 << (j % 64);
+            }
+        }
+    });
+}
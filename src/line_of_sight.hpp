@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   line_of_sight.hpp
+ *
+ * Batched point to point visibility over the scene BVH, e.g. the mutual
+ * visibility matrix of candidate sensor sites and targets. A segment is
+ * visible when no triangle crosses it between its end points, leaving
+ * tolerance (world units) free at both ends so points lying on a surface do
+ * not block themselves. Segments are traced as packets of four with the
+ * any-hit traversal of BVH::occluded(), which stops at the first hit of
+ * every ray.
+ *
+ * Coherent packets keep the traversal cheap. test() sorts every block of
+ * BLOCK_SIZE segments by the Morton code of the start point and then by
+ * direction (cube face and a 4x4 cell within it), so the rays of a packet
+ * start close together and run nearly parallel. Sorting by start point first
+ * was faster than direction first for both scattered segments and segments
+ * from a few sites. matrix() sorts the targets once by
+ * their Morton code, and the rays from one site to consecutive targets then
+ * cross neighbouring nodes. Blocks are traced in parallel on the thread
+ * pool. Results are bitsets, bit n in word n / 64, so 10^8 segments take
+ * 12.5 MB.
+ */
+
+#ifndef LINE_OF_SIGHT_HPP
+#define LINE_OF_SIGHT_HPP
+
+#include "bvh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+class LineOfSight {
+public:
+    // segments sorted and traced by one task, a multiple of 64 so that
+    // tasks write disjoint words of the bitset
+    static const int BLOCK_SIZE = 1 << 14;
+
+    // the BVH is referenced, not copied, and must outlive the engine
+    LineOfSight(const BVH& bvh, float tolerance = 1.0e-3f);
+
+    // bit n of visible set when from[n] sees to[n], (count + 63) / 64 words
+    void test(const glm::vec3 *from, const glm::vec3 *to, size_t count, uint64_t *visible) const;
+
+    // words per row of matrix()
+    static size_t rowWords(size_t numTargets) {
+        return (numTargets + 63) / 64;
+    }
+
+    // numSites rows of rowWords(numTargets) words, bit j of row i set when
+    // sites[i] sees targets[j]
+    void matrix(const glm::vec3 *sites, size_t numSites, const glm::vec3 *targets, size_t numTargets,
+            uint64_t *visible) const;
+
+private:
+    // up to 4 segments as one packet, bit l of the result set when segment l is visible
+    int trace(const glm::vec3 * const *from, const glm::vec3 * const *to, int count) const;
+
+    // Morton code of p quantized to 10 bits per axis of the scene bounds
+    uint32_t mortonCode(const glm::vec3& p) const;
+
+    const BVH& bvh;
+    float tolerance;
+};
+
+#endif /* LINE_OF_SIGHT_HPP */
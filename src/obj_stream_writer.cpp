@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "obj_stream_writer.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+ObjStreamWriter::ObjStreamWriter() : file(nullptr), used(0), ok(false) {
+}
+
+ObjStreamWriter::~ObjStreamWriter() {
+    close();
+}
+
+bool ObjStreamWriter::open(const std::string& _filename) {
+    close();
+    filename = _filename;
+    file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "Could not open " << filename << " for writing." << std::endl;
+        return false;
+    }
+    buffer.resize(BUFFER_SIZE);
+    used = 0;
+    ok = true;
+    return true;
+}
+
+bool ObjStreamWriter::close() {
+    if (file == nullptr) {
+        return ok;
+    }
+    flush();
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    file = nullptr;
+    if (!ok) {
+        std::cout << "Error writing " << filename << "." << std::endl;
+    }
+    return ok;
+}
+
+void ObjStreamWriter::flush() {
+    if (used > 0 && fwrite(&buffer[0], 1, used, file) != used) {
+        ok = false;
+    }
+    used = 0;
+}
+
+void ObjStreamWriter::append(const char *data, size_t size) {
+    if (size > buffer.size()) {
+        flush();
+        if (fwrite(data, 1, size, file) != size) {
+            ok = false;
+        }
+        return;
+    }
+    reserve(size);
+    memcpy(&buffer[used], data, size);
+    used += size;
+}
+
+char *ObjStreamWriter::formatVertex(char *out, const glm::vec3& v) {
+    *out++ = 'v';
+    for (int c = 0; c < 3; c++) {
+        *out++ = ' ';
+        out = format_float(out, v[c]);
+    }
+    *out++ = '\n';
+    return out;
+}
+
+char *ObjStreamWriter::formatFace(char *out, const glm::u32vec3& f) {
+    *out++ = 'f';
+    for (int c = 0; c < 3; c++) {
+        *out++ = ' ';
+        out = format_uint(out, f[c]);
+    }
+    *out++ = '\n';
+    return out;
+}
+
+// format the records chunk by chunk in parallel, then append them in order
+
+template <typename Record, typename Format>
+static void writeChunks(const Record *records, size_t count, int maxChars, Format format,
+        std::vector<std::vector<char> >& text, std::vector<size_t>& length) {
+    size_t numChunks = (count + ObjStreamWriter::CHUNK_SIZE - 1) / ObjStreamWriter::CHUNK_SIZE;
+    text.resize(numChunks);
+    length.resize(numChunks);
+    parallel_for(0, (int) numChunks, [&](int c) {
+        size_t begin = c * ObjStreamWriter::CHUNK_SIZE;
+        size_t end = std::min(begin + ObjStreamWriter::CHUNK_SIZE, count);
+        text[c].resize((end - begin) * maxChars);
+        char *out = &text[c][0];
+        for (size_t n = begin; n < end; n++) {
+            out = format(out, records[n]);
+        }
+        length[c] = out - &text[c][0];
+    });
+}
+
+void ObjStreamWriter::writeVertices(const glm::vec3 *v, size_t count) {
+    std::vector<std::vector<char> > text;
+    std::vector<size_t> length;
+    writeChunks(v, count, MAX_VERTEX_CHARS, formatVertex, text, length);
+    for (size_t c = 0; c < text.size(); c++) {
+        append(&text[c][0], length[c]);
+    }
+}
+
+void ObjStreamWriter::writeFaces(const glm::u32vec3 *f, size_t count) {
+    std::vector<std::vector<char> > text;
+    std::vector<size_t> length;
+    writeChunks(f, count, MAX_FACE_CHARS, formatFace, text, length);
+    for (size_t c = 0; c < text.size(); c++) {
+        append(&text[c][0], length[c]);
+    }
+}
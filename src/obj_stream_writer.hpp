@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   obj_stream_writer.hpp
+ *
+ * Wavefront OBJ output that is written while the mesh is generated, so no
+ * vertex or face list of the whole mesh is ever held in memory. Records are
+ * formatted with format_float/format_uint into a 4 MB buffer that is handed
+ * to fwrite when full. Batches of vertices or faces are formatted in
+ * parallel chunks and appended in order.
+ */
+
+#ifndef OBJ_STREAM_WRITER_HPP
+#define OBJ_STREAM_WRITER_HPP
+
+#include "float_format.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class ObjStreamWriter {
+public:
+    static const size_t BUFFER_SIZE = 1 << 22;
+    // records formatted by one task of writeVertices()/writeFaces()
+    static const size_t CHUNK_SIZE = 1 << 13;
+    static const int MAX_VERTEX_CHARS = 3 + 3 * (FLOAT_FORMAT_MAX_CHARS + 1);
+    static const int MAX_FACE_CHARS = 3 + 3 * (UINT_FORMAT_MAX_CHARS + 1);
+
+    ObjStreamWriter();
+    ~ObjStreamWriter();
+
+    bool open(const std::string& filename);
+
+    // flushes and closes the file, false when any write failed
+    bool close();
+
+    void writeVertex(const glm::vec3& v) {
+        reserve(MAX_VERTEX_CHARS);
+        used = formatVertex(&buffer[used], v) - &buffer[0];
+    }
+
+    // face indices are 1 based like in the file
+    void writeFace(const glm::u32vec3& f) {
+        reserve(MAX_FACE_CHARS);
+        used = formatFace(&buffer[used], f) - &buffer[0];
+    }
+
+    void writeVertices(const glm::vec3 *v, size_t count);
+
+    void writeFaces(const glm::u32vec3 *f, size_t count);
+
+    // "v x y z\n" with the shortest round trip coordinates
+    static char *formatVertex(char *out, const glm::vec3& v);
+
+    // "f a b c\n"
+    static char *formatFace(char *out, const glm::u32vec3& f);
+
+private:
+    void reserve(size_t size) {
+        if (used + size > buffer.size()) {
+            flush();
+        }
+    }
+
+    void flush();
+
+    void append(const char *data, size_t size);
+
+    FILE *file;
+    std::string filename;
+    std::vector<char> buffer;
+    size_t used;
+    bool ok;
+};
+
+#endif /* OBJ_STREAM_WRITER_HPP */
+
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "offscreen_context.hpp"
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef HAVE_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+#include <cstdlib>
+#include <iostream>
+
+#ifdef HAVE_EGL
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+#ifdef HAVE_OSMESA
+
+static void *osmesaProcLoader(const char *name) {
+    return (void *) OSMesaGetProcAddress(name);
+}
+#endif
+
+OffscreenContext::OffscreenContext() : provider(PROVIDER_NONE),
+display(nullptr), context(nullptr), osmesa_buffer(nullptr) {
+}
+
+OffscreenContext::~OffscreenContext() {
+    destroy();
+}
+
+OffscreenContext::Provider OffscreenContext::providerFromString(const std::string& name) {
+#ifdef HAVE_EGL
+    if (name == "egl") {
+        return PROVIDER_EGL;
+    }
+#endif
+#ifdef HAVE_OSMESA
+    if (name == "osmesa") {
+        return PROVIDER_OSMESA;
+    }
+#endif
+    return PROVIDER_NONE;
+}
+
+bool OffscreenContext::create(Provider _provider, int glMajor, int glMinor) {
+    destroy();
+    bool success = false;
+    if (_provider == PROVIDER_EGL) {
+        success = createEGL(glMajor, glMinor);
+    } else if (_provider == PROVIDER_OSMESA) {
+        success = createOSMesa(glMajor, glMinor);
+    }
+    if (success) {
+        provider = _provider;
+        success = makeCurrent();
+    }
+    if (!success) {
+        destroy();
+    }
+    return success;
+}
+
+bool OffscreenContext::createEGL(int glMajor, int glMinor) {
+#ifdef HAVE_EGL
+    EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+    // prefer the Mesa surfaceless platform, it needs neither X11 nor a GPU device node
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != nullptr) {
+        eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (eglDisplay == EGL_NO_DISPLAY) {
+        eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint eglMajor, eglMinor;
+    if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &eglMajor, &eglMinor)) {
+        std::cout << "Failed to initialize an EGL display." << std::endl;
+        return false;
+    }
+    display = eglDisplay;
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cout << "EGL display does not support the desktop OpenGL API." << std::endl;
+        return false;
+    }
+    const EGLint configAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint numConfigs = 0;
+    eglChooseConfig(eglDisplay, configAttribs, &config, 1, &numConfigs);
+    if (numConfigs < 1) {
+        // surfaceless displays may expose no configs, rely on EGL_KHR_no_config_context
+        config = EGL_NO_CONFIG_KHR;
+    }
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, glMajor,
+        EGL_CONTEXT_MINOR_VERSION, glMinor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+    if (eglContext == EGL_NO_CONTEXT) {
+        std::cout << "Failed to create an OpenGL " << glMajor << "." << glMinor
+                << " EGL context (error 0x" << std::hex << eglGetError() << std::dec << ")." << std::endl;
+        return false;
+    }
+    context = eglContext;
+    return true;
+#else
+    std::cout << "EGL support was not compiled into this program." << std::endl;
+    return false;
+#endif
+}
+
+bool OffscreenContext::createOSMesa(int glMajor, int glMinor) {
+#ifdef HAVE_OSMESA
+    const int contextAttribs[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 0,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, glMajor,
+        OSMESA_CONTEXT_MINOR_VERSION, glMinor,
+        0
+    };
+    OSMesaContext osmesaContext = OSMesaCreateContextAttribs(contextAttribs, NULL);
+    if (osmesaContext == NULL) {
+        std::cout << "Failed to create an OpenGL " << glMajor << "." << glMinor << " OSMesa context." << std::endl;
+        return false;
+    }
+    context = osmesaContext;
+    // all rendering goes to framebuffer objects, a 1x1 color buffer satisfies OSMesaMakeCurrent()
+    osmesa_buffer = (unsigned char *) malloc(4 * sizeof (unsigned char));
+    return true;
+#else
+    std::cout << "OSMesa support was not compiled into this program." << std::endl;
+    return false;
+#endif
+}
+
+bool OffscreenContext::makeCurrent() {
+#ifdef HAVE_EGL
+    if (provider == PROVIDER_EGL) {
+        if (!eglMakeCurrent((EGLDisplay) display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext) context)) {
+            std::cout << "Failed to make the EGL context current (EGL_KHR_surfaceless_context required)." << std::endl;
+            return false;
+        }
+        return true;
+    }
+#endif
+#ifdef HAVE_OSMESA
+    if (provider == PROVIDER_OSMESA) {
+        if (!OSMesaMakeCurrent((OSMesaContext) context, osmesa_buffer, GL_UNSIGNED_BYTE, 1, 1)) {
+            std::cout << "Failed to make the OSMesa context current." << std::endl;
+            return false;
+        }
+        return true;
+    }
+#endif
+    return false;
+}
+
+void OffscreenContext::destroy() {
+#ifdef HAVE_EGL
+    if (display != nullptr && (provider == PROVIDER_EGL || provider == PROVIDER_NONE)) {
+        eglMakeCurrent((EGLDisplay) display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != nullptr) {
+            eglDestroyContext((EGLDisplay) display, (EGLContext) context);
+        }
+        eglTerminate((EGLDisplay) display);
+        display = nullptr;
+        context = nullptr;
+    }
+#endif
+#ifdef HAVE_OSMESA
+    if (context != nullptr && provider == PROVIDER_OSMESA) {
+        OSMesaDestroyContext((OSMesaContext) context);
+        context = nullptr;
+    }
+#endif
+    if (osmesa_buffer != nullptr) {
+        free(osmesa_buffer);
+        osmesa_buffer = nullptr;
+    }
+    provider = PROVIDER_NONE;
+}
+
+GLADloadproc OffscreenContext::getProcLoader() const {
+#ifdef HAVE_EGL
+    if (provider == PROVIDER_EGL) {
+        return (GLADloadproc) eglGetProcAddress;
+    }
+#endif
+#ifdef HAVE_OSMESA
+    if (provider == PROVIDER_OSMESA) {
+        return osmesaProcLoader;
+    }
+#endif
+    return nullptr;
+}
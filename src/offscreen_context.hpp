@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   offscreen_context.hpp
+ *
+ * Window-less OpenGL contexts for running the depth renderer on machines
+ * without a display, e.g., render farm nodes using Mesa's llvmpipe driver.
+ * Rendering must target a framebuffer object (see depth_framebuffer.hpp)
+ * since these contexts have no default framebuffer.
+ */
+
+#ifndef OFFSCREEN_CONTEXT_HPP
+#define OFFSCREEN_CONTEXT_HPP
+
+#include <glad/glad.h>
+
+#include <string>
+
+class OffscreenContext {
+public:
+
+    enum Provider {
+        PROVIDER_NONE, PROVIDER_EGL, PROVIDER_OSMESA
+    };
+
+    OffscreenContext();
+    ~OffscreenContext();
+
+    // returns PROVIDER_NONE for unknown names or providers not compiled in
+    static Provider providerFromString(const std::string& name);
+
+    // creates a core profile context of the requested version and makes it current
+    bool create(Provider provider, int glMajor, int glMinor);
+    bool makeCurrent();
+    void destroy();
+
+    // function pointer loader for gladLoadGLLoader()
+    GLADloadproc getProcLoader() const;
+
+    Provider provider;
+
+private:
+    bool createEGL(int glMajor, int glMinor);
+    bool createOSMesa(int glMajor, int glMinor);
+
+    // opaque handles so that EGL/OSMesa headers do not leak into users
+    void *display;
+    void *context;
+    // OSMesa requires a color buffer to make a context current
+    unsigned char *osmesa_buffer;
+};
+
+#endif /* OFFSCREEN_CONTEXT_HPP */
+
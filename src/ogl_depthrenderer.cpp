@@ -13,14 +13,40 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include <learnopengl/filesystem.h>
-#include <learnopengl/shader_m.h>
+#include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
 #include "screenshots.hpp"
 #include "YAML_Config.hpp"
-
+#include "offscreen_context.hpp"
+#include "depth_framebuffer.hpp"
+#include "depth_readback.hpp"
+#include "scene_geometry.hpp"
+#include "raycast_renderer.hpp"
+#include "soft_rasterizer.hpp"
+#include "parallel.hpp"
+#include "volume_unprojector.hpp"
+#include "spherical_grid.hpp"
+#include "quadtree_mesher.hpp"
+#include "cube_lattice.hpp"
+#include "cube_faces.hpp"
+#include "obj_stream_writer.hpp"
+#include "request_server.hpp"
+#include "volume_intersection.hpp"
+#include "heightmap.hpp"
+#include "heightfield_viewshed.hpp"
+#include "coverage_raster.hpp"
+#include "range_cube_map.hpp"
+#include "voxel_grid.hpp"
+#include "result_cache.hpp"
+#include "submesh_index.hpp"
+#include "geometry_arena.hpp"
+
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -296,6 +322,143 @@ public:
     }
 };
 
+// the meshes rendered into the visibility volume depth images
+
+class DepthScene {
+public:
+    std::vector<Model> model_list;
+    std::vector<glm::mat4> model_xforms;
+    DefaultScene *defaultScene;
+
+    DepthScene() : defaultScene(nullptr) {
+    }
+
+    ~DepthScene() {
+        if (defaultScene != nullptr) {
+            delete defaultScene;
+        }
+    }
+
+    void draw(Shader& shader) {
+        if (model_list.size() > 0) {
+            for (unsigned int i = 0; i < model_list.size(); i++) {
+                shader.setMat4("model", model_xforms[i]);
+                model_list[i].Draw(shader);
+            }
+        } else if (defaultScene != nullptr) {
+            defaultScene->drawScene(shader);
+        }
+    }
+
+    // index the world bounds of every mesh of every model and pack their
+    // world space geometry into the arena, call once the models and their
+    // transforms are in place
+
+    void buildIndex() {
+        submeshes.clear();
+        arena.destroy();
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> lo, hi;
+        for (unsigned int i = 0; i < model_list.size(); i++) {
+            for (unsigned int m = 0; m < model_list[i].meshes.size(); m++) {
+                const Mesh& mesh = model_list[i].meshes[m];
+                if (mesh.numVertices() == 0) {
+                    continue;
+                }
+                glm::vec3 world_lo, world_hi;
+                SceneGeometry::transformBox(model_xforms[i], mesh.boundsMin, mesh.boundsMax, world_lo, world_hi);
+                submeshes.push_back(glm::ivec2(i, m));
+                lo.push_back(world_lo);
+                hi.push_back(world_hi);
+                positions.resize(mesh.numVertices());
+                for (unsigned int v = 0; v < positions.size(); v++) {
+                    positions[v] = mesh.position(v);
+                }
+                arena.add(positions, mesh.indices, model_xforms[i]);
+            }
+        }
+        index.build(lo, hi);
+        arena.upload();
+    }
+
+    // draw only the meshes that meet the sphere (center, radius) and, given
+    // a view projection matrix, its frustum. Without an index, e.g. for the
+    // default scene, everything is drawn.
+
+    void draw(Shader& shader, const glm::vec3& center, float radius, const glm::mat4 *viewProjection) {
+        if (index.size() == 0) {
+            draw(shader);
+            return;
+        }
+        Frustum frustum;
+        if (viewProjection != nullptr) {
+            frustum = createFrustumFromMatrix(*viewProjection);
+        }
+        index.query(center, radius, viewProjection != nullptr ? &frustum : nullptr, visible);
+        if (arena.isUploaded()) {
+            // the arena holds world space positions
+            shader.setMat4("model", glm::mat4(1.0f));
+            arena.draw(visible);
+        } else {
+            int model = -1;
+            for (int item : visible) {
+                if (submeshes[item].x != model) {
+                    model = submeshes[item].x;
+                    shader.setMat4("model", model_xforms[model]);
+                }
+                model_list[model].meshes[submeshes[item].y].Draw(shader);
+            }
+        }
+        stats.drawn += visible.size();
+        stats.total += index.size();
+    }
+
+    // draw the meshes of every model that meet the frustum of a view
+    // projection matrix, e.g. of the interactive camera
+
+    void draw(Shader& shader, const glm::mat4& viewProjection) {
+        if (model_list.empty()) {
+            draw(shader);
+            return;
+        }
+        for (unsigned int i = 0; i < model_list.size(); i++) {
+            shader.setMat4("model", model_xforms[i]);
+            model_list[i].Draw(shader, createFrustumFromMatrix(viewProjection * model_xforms[i]), &stats);
+        }
+    }
+
+    // release the GL buffers while the context still exists
+    void destroyBuffers() {
+        arena.destroy();
+    }
+
+    void printCullingStats() const {
+        if (stats.total > 0) {
+            std::cout << "Culling drew " << stats.drawn << " of " << stats.total << " submeshes ("
+                    << 100.0 * stats.drawn / stats.total << "%)" << std::endl;
+        }
+    }
+
+    // submeshes drawn and considered by the culled draws
+    DrawStats stats;
+
+private:
+    // (model, mesh) of every indexed item
+    std::vector<glm::ivec2> submeshes;
+    SubmeshIndex index;
+    // geometry of the indexed items, one draw per query
+    GeometryArena arena;
+    std::vector<int> visible;
+};
+
+// command line overrides of the meshing settings of every visibility volume
+
+struct VolumeOptions {
+    bool spherical;
+    float adaptive_tolerance;
+    bool weld_seams;
+};
+
 class VisibilityVolume {
 public:
     int iWidth, iHeight;
@@ -303,24 +466,56 @@ public:
     glm::vec3 origin, up, front;
     float up_max, up_min, radius_max;
     std::string output_filename;
+    // resample the faces onto a (theta, phi) grid rather than meshing the cube
+    bool spherical;
+    // polar steps of the spherical grid, 0 matches the pixel pitch of the faces
+    int spherical_rows;
+    // mesh the cube faces with an adaptive quadtree keeping pixels within this distance, 0 = off
+    float adaptive_tolerance;
+    // one welded mesh over the pixel corners instead of stitched seam triangles
+    bool weld_seams;
+    // "obj", "ply" or "glb", empty uses the extension of output_filename
+    std::string output_format;
+    // entry of the output in the result cache, empty when not cached
+    std::string cache_key;
 
     unsigned int numImages;
     unsigned int currentImageIndex;
     float *camera_thetas = nullptr;
     float *camera_phis = nullptr;
     GLfloat ** depth_imageArr = nullptr;
+    // depth images point into mapped pixel pack buffers rather than malloc'd arrays
+    bool depth_images_mapped = false;
 
     VisibilityVolume() : iWidth(100), iHeight(100), fov_degrees(90),
     origin(0.0f, 0.0f, 0.0f), up(0.0f, 1.0f, 0.0f), front(1.0f, 0.0f, 0.0f),
-    output_filename("output.obj"), numImages(6), currentImageIndex(0) {
+    output_filename("output.obj"), spherical(false), spherical_rows(0), adaptive_tolerance(0.0f), weld_seams(false), numImages(6), currentImageIndex(0) {
         up_max = std::numeric_limits<float>::max();
         radius_max = std::numeric_limits<float>::max();
         up_min = -std::numeric_limits<float>::max();
     }
 
+    void configure(const YAML_VisibilityVolume& config, const VolumeOptions& options) {
+        iWidth = config.width;
+        iHeight = config.height;
+        fov_degrees = config.fov_degrees;
+        origin = config.origin;
+        front = config.front;
+        up = config.up;
+        up_max = config.up_max;
+        up_min = config.up_min;
+        radius_max = config.radius_max;
+        output_filename = config.output_filename;
+        spherical = options.spherical || config.parameterization == "spherical";
+        spherical_rows = config.spherical_rows;
+        adaptive_tolerance = (options.adaptive_tolerance > 0) ? options.adaptive_tolerance : config.adaptive_tolerance;
+        weld_seams = options.weld_seams || config.weld_seams;
+        output_format = config.output_format;
+    }
+
     ~VisibilityVolume() {
         if (depth_imageArr != nullptr) {
-            for (unsigned int i = 0; i < numImages; i++) {
+            for (unsigned int i = 0; i < numImages && !depth_images_mapped; i++) {
                 if (depth_imageArr[i] != nullptr) {
                     free(depth_imageArr[i]);
                 }
@@ -330,35 +525,39 @@ public:
     }
 
     void initializeWindowAndDepthBuffers(GLFWwindow* window) {
+        initializeDepthBuffers();
         // resize window and allow calls to resize framebuffer  
-        if (iWidth != iHeight) {
-            std::cout << "Visibility Volume Width and Height parameters must be equal." << std::endl;
-            std::cout << "Forcing Width = Height = " << iHeight << "." << std::endl;
-            iWidth = iHeight;
-        }
         glfwSetWindowSize(window, iWidth, iHeight);
         // these calls are required per https://github.com/glfw/glfw/issues/1661
         glfwPollEvents();
 //        glfwWaitEvents();
+    }
 
+    void initializeDepthBuffers(bool allocateImages = true) {
+        if (iWidth != iHeight) {
+            std::cout << "Visibility Volume Width and Height parameters must be equal." << std::endl;
+            std::cout << "Forcing Width = Height = " << iHeight << "." << std::endl;
+            iWidth = iHeight;
+        }
         // initialize the depth buffers
-        numImages = 6;
+        numImages = CUBE_FACES;
         currentImageIndex = 0;
         camera_thetas = (float *) realloc(camera_thetas, sizeof (float) * numImages);
         camera_phis = (float *) realloc(camera_phis, sizeof (float) * numImages);
-        float phis[] = {0.0, 0.0f, 0.0f, 0.0f, 90.0f, -90.0f};
-        float thetas[] = {0.0, 90.0f, 180.0f, 270.0f, 0.0f, 0.0f};
         for (unsigned int i = 0; i < numImages; i++) {
-            camera_thetas[i] = thetas[i];
-            camera_phis[i] = phis[i];
+            camera_thetas[i] = CUBE_FACE_THETAS[i];
+            camera_phis[i] = CUBE_FACE_PHIS[i];
         }
         //glm::mat4 views[numImages];
         depth_imageArr = (GLfloat **) realloc(depth_imageArr, sizeof (GLfloat*) * numImages);
         for (unsigned int i = 0; i < numImages; i++) {
             //views[i] = glm::mat4(1.0f);
             depth_imageArr[i] = nullptr;
-            depth_imageArr[i] = (GLfloat *) realloc(depth_imageArr[i], sizeof (GLfloat) * iWidth * iHeight);
+            if (allocateImages) {
+                depth_imageArr[i] = (GLfloat *) realloc(depth_imageArr[i], sizeof (GLfloat) * iWidth * iHeight);
+            }
         }
+        depth_images_mapped = false;
     }
 
     bool hasMoreImages() {
@@ -377,119 +576,193 @@ public:
         return MakeInfReversedZProjRH(glm::radians(fov_degrees), (float) iWidth / (float) iHeight, zNear);
     }
 
+    // geometry farther from the origin than this cannot change the volume:
+    // ranges are clamped to radius_max and depths end at MAX_DEPTH along the
+    // optical axis, at most sqrt(3) MAX_DEPTH into a corner of a face
+
+    float cullRadius() const {
+        return std::min(radius_max, std::sqrt(3.0f) * MAX_DEPTH);
+    }
+
     void copyDepthBuffer() {
         glReadBuffer(GL_FRONT);
         //views[imageIdx] = view;
         glReadPixels(0, 0, iWidth, iHeight, GL_DEPTH_COMPONENT, GL_FLOAT, depth_imageArr[currentImageIndex]);
     }
 
+    void copyDepthBuffer(DepthFramebuffer& fbo) {
+        fbo.readDepth(depth_imageArr[currentImageIndex]);
+    }
+
+    void copyDepthBuffer(DepthFramebuffer& fbo, DepthReadback *readback, int slotBase, int layer = 0) {
+        if (readback != nullptr) {
+            readback->beginRead(slotBase + currentImageIndex, fbo, layer);
+        } else {
+            fbo.readDepth(depth_imageArr[currentImageIndex], layer);
+        }
+    }
+
+    // point the depth images at the pixel pack buffers the faces were read 
+    // into, blocks until their transfers have completed
+
+    bool mapDepthBuffers(DepthReadback& readback, int slotBase) {
+        depth_images_mapped = true;
+        for (unsigned int k = 0; k < numImages; k++) {
+            depth_imageArr[k] = readback.map(slotBase + k);
+            if (depth_imageArr[k] == nullptr) {
+                unmapDepthBuffers(readback, slotBase);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void unmapDepthBuffers(DepthReadback& readback, int slotBase) {
+        for (unsigned int k = 0; k < numImages; k++) {
+            readback.unmap(slotBase + k);
+            depth_imageArr[k] = nullptr;
+        }
+    }
+
+    // render all faces into an offscreen framebuffer, no window system round trips.
+    // With a readback ring the face transfers are only queued, see mapDepthBuffers()
+
+    void renderOffscreen(DepthFramebuffer& fbo, Shader& shader, DepthScene& scene,
+            DepthReadback *readback = nullptr, int slotBase = 0) {
+        initializeDepthBuffers(readback == nullptr);
+        if (!fbo.create(iWidth, iHeight)) {
+            return;
+        }
+        fbo.bind();
+        shader.use();
+        shader.setFloat("near", zNear);
+        shader.setFloat("far", zFar);
+        shader.setMat4("projection", getProjectionMatrix());
+        glClearDepth(0.0f);
+        glm::mat4 projection = getProjectionMatrix();
+        while (hasMoreImages()) {
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glm::mat4 view = getNextCameraMatrix();
+            glm::mat4 viewProjection = projection * view;
+            shader.setMat4("view", view);
+            scene.draw(shader, origin, cullRadius(), &viewProjection);
+            copyDepthBuffer(fbo, readback, slotBase);
+            currentImageIndex++;
+        }
+        fbo.unbind();
+    }
+
+    // render all faces in one pass, the geometry shader routes each triangle 
+    // to the layers (faces) whose frustum it overlaps
+
+    void renderOffscreenLayered(DepthFramebuffer& fbo, Shader& layeredShader, DepthScene& scene,
+            DepthReadback *readback = nullptr, int slotBase = 0) {
+        initializeDepthBuffers(readback == nullptr);
+        if (!fbo.create(iWidth, iHeight, numImages)) {
+            return;
+        }
+        fbo.bind();
+        layeredShader.use();
+        layeredShader.setFloat("near", zNear);
+        layeredShader.setFloat("far", zFar);
+        layeredShader.setMat4("projection", getProjectionMatrix());
+        for (unsigned int k = 0; k < numImages; k++) {
+            layeredShader.setMat4("views[" + std::to_string(k) + "]", getView(k));
+        }
+        glClearDepth(0.0f);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        // every face is drawn at once, only the sphere culls
+        scene.draw(layeredShader, origin, cullRadius(), nullptr);
+        for (currentImageIndex = 0; currentImageIndex < numImages; currentImageIndex++) {
+            copyDepthBuffer(fbo, readback, slotBase, currentImageIndex);
+        }
+        fbo.unbind();
+    }
+
+    // CPU backends fill the depth images directly, no OpenGL context is involved
+
+    void renderCPU(CpuDepthRenderer& renderer) {
+        initializeDepthBuffers();
+        std::vector<glm::mat4> views(numImages);
+        for (unsigned int k = 0; k < numImages; k++) {
+            views[k] = getView(k);
+        }
+        renderer.renderDepth(&views[0], numImages, glm::radians(fov_degrees),
+                (float) iWidth / (float) iHeight, zNear, iWidth, iHeight, depth_imageArr);
+        currentImageIndex = numImages;
+    }
+
 #define toOBJIndex(i, j, k) (((iHeight * k + i) * iWidth) + j + 1)
 
-    void writeVolumeToOBJ(YAML_CoordinateSystem world_coord_sys) {
-        std::vector<glm::vec3> vertexCoordList;
-        std::vector<glm::vec3> vertexColorList;
-        std::vector<glm::u32vec3> vertexCoordIndexList;
-        std::vector<glm::u32vec3> vertexColorIndexList;
-        vertexColorList.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
-        vertexColorList.push_back(glm::vec3(1.0f, 0.0f, 0.0f));
+    // per face ray tables and the radius/height limits of this volume
 
-        glm::mat4 projection_inv = glm::inverse(getProjectionMatrix());
-        if (DEBUG) {
-            std::cout << "projection_inv = " << glm::to_string(projection_inv) << std::endl;
+    void setupUnprojector(VolumeUnprojector& unprojector, YAML_CoordinateSystem& world_coord_sys,
+            bool rayTables = true) {
+        std::vector<glm::mat4> views(numImages);
+        for (unsigned int k = 0; k < numImages; k++) {
+            views[k] = getView(k);
         }
-        glm::mat4 view_inv;
-        //FILE *f = fopen("ptcloud.data", "w");
-        //float z_at_max_r;
-        glm::vec4 pos_scr;
-        glm::vec4 pos_3d;
-        int i, j;
-        unsigned int k, cur;
-        for (k = 0; k < numImages; k++) {
-            view_inv = glm::inverse(getView(k));
-            if (DEBUG) {
-                std::cout << "view_inv = " << glm::to_string(view_inv) << std::endl;
-                std::cout << "determinant = " << glm::determinant(view_inv) << std::endl;
-            }
-            for (i = 0; i < iHeight; i++) {
-                for (j = 0; j < iWidth; j++) {
-                    cur = i * iWidth + j;
-                    //cur = ((iHeight - i - 1) * iWidth + j);
-                    //cur = ((iHeight - i - 1) * iWidth + j);
-                    pos_scr.x = (float) 2.0f * (j + 0.5f) / iWidth - 1.0f;
-                    pos_scr.y = (float) 2.0f * (i + 0.5f) / iHeight - 1.0f;
-                    //pos.z = pixels[cur] * 2.0f - 1.0f;
-                    pos_scr.z = depth_imageArr[k][cur];
-                    pos_scr.w = 1.0f;
-                    if (k == 4) {
-                        //std::cout << "z = " << depth_imageArr[k][cur] << std::endl;
-                    }
+        unprojector.setupRays(&views[0], numImages, glm::radians(fov_degrees),
+                (float) iWidth / (float) iHeight, iWidth, iHeight, rayTables);
+        // the world frame rotation, the translation column of getTransform() is not used for the radius
+        glm::mat3 wcs_basis = glm::mat3(world_coord_sys.getTransform());
+        unprojector.setLimits(origin, zNear, zNear / MAX_DEPTH, wcs_basis, radius_max,
+                world_coord_sys.origin, world_coord_sys.up, up, up_min, up_max);
+    }
 
-                    //if (std::abs(pos.z) < 1.0e-6f) { // max Z is 1/1.0e-7f
-                    //    pos.z = (pos.z > 0) ? 1.0e-6f : -1.0e-6f;
-                    //}
-                    //if (std::sqrt(pos.x * pos.x + pos.y * pos.y + (1/pos.z)*(1/pos.z)) > MAX_RANGE) {
-                    //if (std::abs(pos.z) < 1.0e-6f) { // max Z is 1/1.0e-7f
-                    if (pos_scr.z < zNear / MAX_DEPTH) { // max Z is 1/1.0e-7f
-                        //std::cout << "z = " << pos.z << " < zNear = " << zNear << std::endl;
-                        //pos.z *= zNear / pos.z;
-                        //pos.z = 0.001*zNear;
-                        pos_scr.z = zNear / MAX_DEPTH;
-                    }
-                    if (std::abs(pos_scr.z) < 2.0f / (radius_max * radius_max)) { // max Z is 1/1.0e-7f
-                        //z_at_max_r = 2.0f * sqrt(pos.x * pos.x + pos.y * pos.y + 1) / (MAX_RANGE * MAX_RANGE);
-                        //pos.z = z_at_max_r;
-                        //pos_scr.z = 2.0f * sqrt(pos_scr.x * pos_scr.x + pos_scr.y * pos_scr.y + 1) / (radius_max * radius_max);
-                    }
+    // false when the output file could not be written
 
-                    pos_3d = view_inv * projection_inv * pos_scr;
-
-                    pos_3d.x /= pos_3d.w;
-                    pos_3d.y /= pos_3d.w;
-                    pos_3d.z /= pos_3d.w;
-                    pos_3d.w = 1.0f;
-
-                    glm::vec3 euclidean_coords(pos_3d.x, pos_3d.y, pos_3d.z);
-
-                    // restrict radius to radius_max
-                    glm::mat4 world_coordinate_sys = world_coord_sys.getTransform();
-                    //std::cout << "world_coords_xform = " << glm::to_string(world_coordinate_sys) << std::endl;
-                    glm::vec4 world_coord4 = world_coordinate_sys * glm::vec4(euclidean_coords, 1.0f);
-                    glm::vec3 world_coord3 = glm::vec3(world_coord4.x, world_coord4.y, world_coord4.z);
-                    //glm::vec3 spherical_coords = EuclideanToSpherical(world_coord3);
-                    glm::vec3 spherical_coords = EuclideanToSpherical(world_coord3 - origin);
-                    if (spherical_coords.x > radius_max) {
-                        spherical_coords.x = radius_max;
-                        glm::vec3 euclidean_coords_new = SphericalToEuclidean(spherical_coords);
-                        //euclidean_coords = euclidean_coords_new;
-                        euclidean_coords = euclidean_coords_new + origin;
-                        //std::cout << "radius_max exceeded: point = " << glm::to_string(euclidean_coords) << " ==> new point = " << glm::to_string(euclidean_coords_new) << std::endl;
-                    }
+    bool writeVolume(YAML_CoordinateSystem world_coord_sys) {
+        if (spherical) {
+            return writeSphericalVolume(world_coord_sys);
+        }
+        return writeCubeVolume(world_coord_sys);
+    }
 
-                    // clamp height to the interval [up_min, up_max]
-                    float height = glm::dot(euclidean_coords - world_coord_sys.origin, world_coord_sys.up);
-                    if (height > up_max) {
-                        euclidean_coords = euclidean_coords - (height - up_max) * up;
-                    } else if (height < up_min) {
-                        euclidean_coords = euclidean_coords + (up_min - height) * up;
-                    }
+    // 2.5D volume swept over a heightmap in place of the depth capture, the
+    // height limits measured along world +y from the world origin
 
-                    if (i % 100 == 0 && j % 100 == 0 && DEBUG) {
-                        //printf("%f %f %f\n", pos.x, pos.y, pos.z);
-                        printf("%f %f %f\n", euclidean_coords.x, euclidean_coords.y, euclidean_coords.z);
-                    }
+    bool writeHeightfieldVolume(const Heightmap& heightmap, YAML_CoordinateSystem world_coord_sys) {
+        HeightfieldViewshed viewshed;
+        viewshed.compute(heightmap, origin, std::min(radius_max, MAX_DEPTH));
+        VolumeMesh mesh;
+        viewshed.mesh(world_coord_sys.origin.y + up_min, world_coord_sys.origin.y + up_max, mesh);
+        return mesh.write(output_filename, output_format);
+    }
 
-                    vertexCoordList.push_back(euclidean_coords);
-                    if (i > 0 && j > 0) {
-                        int offsetA = iWidth * iHeight * k + (i - 1) * iWidth + j;
-                        int offsetB = iWidth * iHeight * k + i * iWidth + j;
-                        vertexCoordIndexList.push_back(glm::u32vec3(offsetA + 1, offsetA, offsetB));
-                        vertexCoordIndexList.push_back(glm::u32vec3(offsetB, offsetB + 1, offsetA + 1));
-                        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-                        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-                    }
-                }
-            }
+    // single closed grid mesh over (theta, phi), no seams between faces to stitch
+
+    bool writeSphericalVolume(YAML_CoordinateSystem world_coord_sys) {
+        VolumeUnprojector unprojector;
+        setupUnprojector(unprojector, world_coord_sys);
+        int rows = (spherical_rows > 0) ? spherical_rows :
+                SphericalGrid::defaultRows(glm::radians(fov_degrees), iHeight);
+        SphericalGrid grid;
+        grid.setup(front, up, rows);
+        VolumeMesh mesh;
+        grid.resample(unprojector, depth_imageArr, mesh);
+        return mesh.write(output_filename, output_format);
+    }
+
+    // the two triangles of every pixel quad between rows i - 1 and i of face k,
+    // 1 based OBJ indices into the vertices of all faces
+
+    template <typename Emit>
+    void emitFaceRowTriangles(unsigned int k, int i, Emit emit) {
+        for (int j = 1; j < iWidth; j++) {
+            int offsetA = iWidth * iHeight * k + (i - 1) * iWidth + j;
+            int offsetB = iWidth * iHeight * k + i * iWidth + j;
+            emit(glm::u32vec3(offsetA + 1, offsetA, offsetB));
+            emit(glm::u32vec3(offsetB, offsetB + 1, offsetA + 1));
         }
+    }
+
+    // triangles joining the borders of the six faces, 1 based OBJ indices
+
+    template <typename Emit>
+    void emitSeamTriangles(Emit emit) {
+        int i, j;
+        unsigned int k;
         // TODO: stitch 4 cylindrical seams of surfaces 
         // join the columns of image 0-3 with columns of image 1-4 respectively (where image 4 = image 0 closes the shape)
         int i_left, i_right, j_left, j_right, k_left, k_right;
@@ -503,10 +776,8 @@ public:
                 int offsetA_plus1 = iWidth * iHeight * k_right + (i - 1) * iWidth + j_right;
                 int offsetB = iWidth * iHeight * k_left + i * iWidth + j_left;
                 int offsetB_plus1 = iWidth * iHeight * k_right + i * iWidth + j_right;
-                vertexCoordIndexList.push_back(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
-                vertexCoordIndexList.push_back(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
-                vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-                vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+                emit(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
+                emit(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
             }
         }
         // stitch bottom seams for the image with index k = 5
@@ -523,10 +794,8 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left + 1;
             int offsetB = iWidth * iHeight * k_right + i_right * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + i_right * iWidth + j_right + 1;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
+            emit(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
         }
         // join the columns of the top row of image 2 with the columns of the top row of image 5
         for (j = 1; j < iWidth; j++) {
@@ -540,10 +809,8 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left - 1;
             int offsetB = iWidth * iHeight * k_right + i_right * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + i_right * iWidth + j_right + 1;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
+            emit(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
         }
         // join the columns of the top row of image 3 with the rows of the last column of image 5
         for (i = 1; i < iHeight; i++) {
@@ -557,10 +824,8 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left + 1;
             int offsetB = iWidth * iHeight * k_right + i_right * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + (i_right - 1) * iWidth + j_right;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
+            emit(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
         }
         // join the columns of the top row of image 1 with the rows of the first column of image 5        
         for (i = 1; i < iHeight; i++) {
@@ -574,40 +839,34 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left + 1;
             int offsetB = iWidth * iHeight * k_right + (i_right - 1) * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + i_right * iWidth + j_right;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
+            emit(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
         }
         // insert 4 corner triangles that stitch 3 image corners together
         // k = 0, i = 0, j = 0
         // k = 5, i = iHeight - 1, j = 0
         // k = 1, i = 0, j = iWidth - 1
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(0, 0, 0),
+        emit(glm::u32vec3(toOBJIndex(0, 0, 0),
                 toOBJIndex(iHeight - 1, 0, 5),
                 toOBJIndex(0, iWidth - 1, 1)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
         // k = 1, i = 0, j = 0
         // k = 5, i = 0, j = 0
         // k = 2, i = 0, j = iWidth - 1
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(0, 0, 1),
+        emit(glm::u32vec3(toOBJIndex(0, 0, 1),
                 toOBJIndex(0, 0, 5),
                 toOBJIndex(0, iWidth - 1, 2)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
         // k = 2, i = 0, j = 0
         // k = 5, i = 0, j = iWidth - 1
         // k = 3, i = 0, j = iWidth - 1
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(0, 0, 2),
+        emit(glm::u32vec3(toOBJIndex(0, 0, 2),
                 toOBJIndex(0, iWidth - 1, 5),
                 toOBJIndex(0, iWidth - 1, 3)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
         // k = 3, i = 0, j = 0
         // k = 5, i = iHeight - 1, j = iWidth - 1
         // k = 0, i = 0, j = iWidth - 1
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(0, 0, 3),
+        emit(glm::u32vec3(toOBJIndex(0, 0, 3),
                 toOBJIndex(iHeight - 1, iWidth - 1, 5),
                 toOBJIndex(0, iWidth - 1, 0)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
 
         // stitch top seams for the image with index k = 4
         k = 4;
@@ -623,10 +882,8 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left + 1;
             int offsetB = iWidth * iHeight * k_right + i_right * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + i_right * iWidth + j_right + 1;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
+            emit(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
         }
         // join the columns of the bottom row of image 2 with the columns of the bottom row of image 4
         for (j = 1; j < iWidth; j++) {
@@ -640,10 +897,8 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left - 1;
             int offsetB = iWidth * iHeight * k_right + i_right * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + i_right * iWidth + j_right + 1;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA, offsetA_plus1, offsetB));
+            emit(glm::u32vec3(offsetB_plus1, offsetB, offsetA_plus1));
         }
         // join the columns of the bottom row of image 3 with the rows of the last column of image 4
         for (i = 1; i < iHeight; i++) {
@@ -657,10 +912,8 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left + 1;
             int offsetB = iWidth * iHeight * k_right + (i_right - 1) * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + i_right * iWidth + j_right;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
+            emit(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
         }
         // join the columns of the bottom row of image 1 with the rows of the first column of image 4        
         for (i = 1; i < iHeight; i++) {
@@ -674,66 +927,276 @@ public:
             int offsetA_plus1 = iWidth * iHeight * k_left + i_left * iWidth + j_left + 1;
             int offsetB = iWidth * iHeight * k_right + i_right * iWidth + j_right;
             int offsetB_plus1 = iWidth * iHeight * k_right + (i_right - 1) * iWidth + j_right;
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
-            vertexCoordIndexList.push_back(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-            vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
+            emit(glm::u32vec3(offsetA_plus1, offsetA, offsetB));
+            emit(glm::u32vec3(offsetB, offsetB_plus1, offsetA_plus1));
         }
         // insert 4 corner triangles that stitch 3 image corners together
         // k = 0, i = iHeight - 1, j = 0
         // k = 1, i = iHeight - 1, j = iWidth - 1
         // k = 4, i = 0, j = 0
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 0),
+        emit(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 0),
                 toOBJIndex(iHeight - 1, iWidth - 1, 1), toOBJIndex(0, 0, 4)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
         // k = 1, i = iHeight - 1, j = 0
         // k = 2, i = iHeight - 1, j = iWidth - 1
         // k = 4, i = 0, j = 0
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 1),
+        emit(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 1),
                 toOBJIndex(iHeight - 1, iWidth - 1, 2), toOBJIndex(iHeight - 1, 0, 4)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
         // k = 2, i = iHeight - 1, j = 0
         // k = 3, i = iHeight - 1, j = iWidth - 1
         // k = 4, i = iHeight - 1, j = iWidth - 1
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 2),
+        emit(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 2),
                 toOBJIndex(iHeight - 1, iWidth - 1, 3), toOBJIndex(iHeight - 1, iWidth - 1, 4)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
         // k = 3, i = iHeight - 1, j = 0
         // k = 0, i = iHeight - 1, j = iWidth - 1
         // k = 4, i = 0, j = iWidth - 1
-        vertexCoordIndexList.push_back(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 3),
+        emit(glm::u32vec3(toOBJIndex(iHeight - 1, 0, 3),
                 toOBJIndex(iHeight - 1, iWidth - 1, 0), toOBJIndex(0, iWidth - 1, 4)));
-        vertexColorIndexList.push_back(glm::u32vec3(1, 1, 1));
-        //fclose(f);
+    }
 
-        FILE *fobj = fopen(output_filename.c_str(), "w");
-        for (glm::vec3 vertex : vertexCoordList) {
-            fprintf(fobj, "v %f %f %f\n", vertex.x, vertex.y, vertex.z);
+    bool writeCubeVolume(YAML_CoordinateSystem world_coord_sys) {
+        std::string format = output_format.empty() ? VolumeMesh::formatFromFilename(output_filename) : output_format;
+        if (weld_seams) {
+            VolumeUnprojector unprojector;
+            setupUnprojector(unprojector, world_coord_sys, false);
+            CubeLattice lattice;
+            if (lattice.setup(unprojector)) {
+                VolumeMesh mesh;
+                lattice.mesh(unprojector, depth_imageArr, adaptive_tolerance, mesh);
+                return mesh.write(output_filename, format);
+            }
+            std::cout << "Seam welding requires six square 90 degree faces, using stitched seams." << std::endl;
         }
-        for (glm::u32vec3 face : vertexCoordIndexList) {
-            fprintf(fobj, "f %d %d %d\n", face.x, face.y, face.z);
+        if (format == "obj" && adaptive_tolerance <= 0) {
+            return streamCubeVolumeToOBJ(world_coord_sys);
         }
-        fclose(fobj);
+        VolumeMesh mesh;
+        mesh.vertices.resize(numImages * iWidth * iHeight);
+
+        // unproject all pixels of all faces at once
+        VolumeUnprojector unprojector;
+        setupUnprojector(unprojector, world_coord_sys);
+        unprojector.unproject(depth_imageArr, &mesh.vertices[0]);
+        if (DEBUG) {
+            for (unsigned int n = 0; n < mesh.vertices.size(); n += 100 * iWidth + 100) {
+                printf("%f %f %f\n", mesh.vertices[n].x, mesh.vertices[n].y, mesh.vertices[n].z);
+            }
+        }
+
+        auto addTriangle = [&mesh](const glm::u32vec3 & face) {
+            mesh.triangles.push_back(face - glm::u32vec3(1));
+        };
+        if (adaptive_tolerance > 0) {
+            // the face borders stay at full resolution for the seams
+            QuadtreeMesher mesher(adaptive_tolerance);
+            mesher.mesh(depth_imageArr, &mesh.vertices[0], numImages, iWidth, iHeight, mesh.triangles);
+        } else {
+            mesh.triangles.reserve(2 * numImages * iWidth * iHeight);
+            for (unsigned int k = 0; k < numImages; k++) {
+                for (int i = 1; i < iHeight; i++) {
+                    emitFaceRowTriangles(k, i, addTriangle);
+                }
+            }
+        }
+        emitSeamTriangles(addTriangle);
+        if (adaptive_tolerance > 0) {
+            // pixels inside the quadtree leaves are no longer referenced
+            mesh.removeUnreferencedVertices();
+        }
+        return mesh.write(output_filename, format);
+    }
+
+    // OBJ written while it is generated, ROWS_PER_BLOCK rows of vertices or
+    // faces are held in memory at a time
+
+    bool streamCubeVolumeToOBJ(YAML_CoordinateSystem world_coord_sys) {
+        const int ROWS_PER_BLOCK = 64;
+        ObjStreamWriter obj;
+        if (!obj.open(output_filename)) {
+            return false;
+        }
+        VolumeUnprojector unprojector;
+        setupUnprojector(unprojector, world_coord_sys, false);
+        std::vector<glm::vec3> vertices(ROWS_PER_BLOCK * iWidth);
+        for (unsigned int k = 0; k < numImages; k++) {
+            for (int i0 = 0; i0 < iHeight; i0 += ROWS_PER_BLOCK) {
+                int i1 = std::min(i0 + ROWS_PER_BLOCK, iHeight);
+                unprojector.unprojectRows(k, i0, i1, depth_imageArr[k], &vertices[0]);
+                obj.writeVertices(&vertices[0], (i1 - i0) * iWidth);
+            }
+        }
+        std::vector<glm::u32vec3> faces;
+        faces.reserve(2 * ROWS_PER_BLOCK * iWidth);
+        auto addFace = [&faces](const glm::u32vec3 & face) {
+            faces.push_back(face);
+        };
+        for (unsigned int k = 0; k < numImages; k++) {
+            for (int i0 = 1; i0 < iHeight; i0 += ROWS_PER_BLOCK) {
+                int i1 = std::min(i0 + ROWS_PER_BLOCK, iHeight);
+                faces.clear();
+                for (int i = i0; i < i1; i++) {
+                    emitFaceRowTriangles(k, i, addFace);
+                }
+                obj.writeFaces(&faces[0], faces.size());
+            }
+        }
+        emitSeamTriangles([&obj](const glm::u32vec3 & face) {
+            obj.writeFace(face);
+        });
+        return obj.close();
+    }
+
+    // result cache key of the output: the scene hash extended with everything
+    // the mesh written for this volume depends on, and the format as extension
+
+    std::string cacheKey(ContentHash scene, YAML_CoordinateSystem world_coord_sys, const std::string& renderer) const {
+        std::string format = output_format.empty() ? VolumeMesh::formatFromFilename(output_filename) : output_format;
+        scene.update(renderer);
+        scene.update((uint64_t) iWidth);
+        scene.update((uint64_t) iHeight);
+        scene.update(fov_degrees);
+        scene.update(origin);
+        scene.update(front);
+        scene.update(up);
+        scene.update(radius_max);
+        scene.update(up_min);
+        scene.update(up_max);
+        scene.update(world_coord_sys.getTransform());
+        scene.update(world_coord_sys.origin);
+        scene.update((uint64_t) spherical);
+        scene.update((uint64_t) spherical_rows);
+        scene.update(adaptive_tolerance);
+        scene.update((uint64_t) weld_seams);
+        scene.update(format);
+        return scene.hex() + "." + format;
+    }
+
+    // sets the voxels of grid inside this volume, the unprojected depth
+    // images bound the voxels tested
+
+    bool voxelize(VoxelGrid& grid, YAML_CoordinateSystem world_coord_sys) {
+        VolumeUnprojector unprojector;
+        setupUnprojector(unprojector, world_coord_sys);
+        std::vector<glm::vec3> points((size_t) numImages * iWidth * iHeight);
+        unprojector.unproject(depth_imageArr, &points[0]);
+        glm::vec3 lo = origin, hi = origin;
+        for (const glm::vec3& p : points) {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        // the boundary between pixel centers may bulge past the sampled points
+        glm::vec3 pad(0.01f * glm::length(hi - lo) + grid.voxelSize);
+        RangeCubeMap map;
+        map.setup(unprojector, depth_imageArr);
+        return grid.voxelize(map, lo - pad, hi + pad);
+    }
+
+    // the welded boundary and a copy of the depth images, false unless the
+    // faces can be welded (square 90 degree faces)
+
+    bool addToIntersection(VolumeIntersection& intersection, YAML_CoordinateSystem world_coord_sys) {
+        VolumeUnprojector unprojector;
+        setupUnprojector(unprojector, world_coord_sys, false);
+        CubeLattice lattice;
+        if (!lattice.setup(unprojector)) {
+            std::cout << "Intersecting " << output_filename << " requires six square 90 degree faces, volume skipped." << std::endl;
+            return false;
+        }
+        VolumeMesh mesh;
+        lattice.mesh(unprojector, depth_imageArr, adaptive_tolerance, mesh);
+        intersection.add(unprojector, depth_imageArr, mesh);
+        return true;
     }
 private:
 
     glm::mat4 getView(int viewIndex) {
-        if (camera_thetas[viewIndex] != 0 || camera_phis[viewIndex] != 0) {
-            //if (true) {
-            glm::vec4 other = glm::vec4(glm::cross(front, up), 1.0f);
-            glm::mat4 rotateAzimuth = glm::rotate(glm::mat4(1.0f), glm::radians(camera_thetas[viewIndex]), up);
-            glm::vec4 new_other = rotateAzimuth * other;
-            glm::mat4 rotateToPhiTheta = glm::rotate(rotateAzimuth, glm::radians(camera_phis[viewIndex]), glm::vec3(new_other.x, new_other.y, new_other.z));
-            glm::vec4 rotatedFront4 = rotateToPhiTheta * glm::vec4(front, 1.0f);
-            glm::vec4 rotatedUp4 = rotateToPhiTheta * glm::vec4(up, 1.0f);
-            glm::vec3 rotatedFront3 = glm::vec3(rotatedFront4.x, rotatedFront4.y, rotatedFront4.z);
-            glm::vec3 rotatedUp3 = glm::vec3(rotatedUp4.x, rotatedUp4.y, rotatedUp4.z);
-            return glm::lookAt(origin, origin + rotatedFront3, rotatedUp3);
+        return cubeFaceView(origin, front, up, camera_thetas[viewIndex], camera_phis[viewIndex]);
+    }
+};
+
+// content hash and world bounds of a scene mesh, the dependency of the
+// cached volumes on it
+
+struct SceneMeshEntry {
+    std::string key;
+    glm::vec3 lo, hi;
+};
+
+// one entry per mesh file and transform. Bounds of meshes seen before come
+// from the cache, only new or edited meshes are loaded (without a rendering
+// context) to measure them. False when a mesh file cannot be read.
+
+bool sceneMeshEntries(const std::vector<std::pair<std::string, glm::mat4> >& meshes, const ResultCache& cache,
+        std::vector<SceneMeshEntry>& entries) {
+    entries.clear();
+    for (const std::pair<std::string, glm::mat4>& mesh : meshes) {
+        ContentHash hash;
+        if (!hash.updateFile(mesh.first)) {
+            return false;
+        }
+        hash.update(mesh.second);
+        SceneMeshEntry entry;
+        entry.key = hash.hex();
+        if (!cache.fetchBounds(entry.key + ".bounds", entry.lo, entry.hi)) {
+            // the file's bounds placed like the depth scene index places them
+            SceneGeometry geometry;
+            if (!geometry.loadModel(mesh.first) || geometry.vertices.empty()) {
+                return false;
+            }
+            glm::vec3 lo = geometry.vertices[0], hi = lo;
+            for (const glm::vec3& v : geometry.vertices) {
+                lo = glm::min(lo, v);
+                hi = glm::max(hi, v);
+            }
+            SceneGeometry::transformBox(mesh.second, lo, hi, entry.lo, entry.hi);
+            cache.storeBounds(entry.key + ".bounds", entry.lo, entry.hi);
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+// one request of the visibility server, a single line YAML or JSON mapping
+// with the keys of a visibility_vol entry, e.g.
+//   {"id": "v1", "width": 40, "height": 40, "origin": [1, 2, 3], "output_file": "v1.obj"}
+// The reply is one line of JSON with the id, the status and the output file.
+
+std::string serveVisibilityRequest(const std::string& line, const VolumeOptions& options,
+        YAML_CoordinateSystem& world_coord_sys, const std::function<void(VisibilityVolume&)>& render) {
+    std::string id, error;
+    YAML_VisibilityVolume config;
+    try {
+        YAML::Node request = YAML::Load(line);
+        if (!request.IsMap()) {
+            error = "request is not a mapping";
         } else {
-            return glm::lookAt(origin, origin + front, up);
+            if (request["id"]) {
+                id = request["id"].as<std::string>();
+            }
+            if (!config.parse(request)) {
+                error = "invalid visibility volume";
+            }
         }
+    } catch (const YAML::Exception& e) {
+        error = e.what();
     }
-};
+    std::string reply = "{";
+    if (!id.empty()) {
+        reply += "\"id\": " + RequestServer::quoteJSON(id) + ", ";
+    }
+    if (!error.empty()) {
+        return reply + "\"status\": \"error\", \"message\": " + RequestServer::quoteJSON(error) + "}";
+    }
+    VisibilityVolume vvol;
+    vvol.configure(config, options);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    render(vvol);
+    bool written = vvol.writeVolume(world_coord_sys);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    char timing[32];
+    snprintf(timing, sizeof (timing), "%.3f", seconds);
+    reply += written ? "\"status\": \"ok\", " : "\"status\": \"error\", \"message\": \"could not write the output file\", ";
+    return reply + "\"output\": " + RequestServer::quoteJSON(vvol.output_filename) + ", \"seconds\": " + timing + "}";
+}
 
 
 // For details see: https://github.com/jarro2783/cxxopts
@@ -749,7 +1212,22 @@ void cxxopts_integration(cxxopts::Options& options) {
             ("ry", "y resolution of the camera in pixels", cxxopts::value<unsigned int>()->default_value("600"))
             ("c,config", "YAML config file.", cxxopts::value<std::string>())
             ("r,radius", "Radius of visibility sphere", cxxopts::value<float>()->default_value("20"))
-            ("o,output", "Output file <visibility_sphere.obj>", cxxopts::value<std::string>()->default_value("visibility_sphere.obj"))
+            ("o,output", "Output file <visibility_sphere.obj>, .ply and .glb write binary PLY and glTF", cxxopts::value<std::string>()->default_value("visibility_sphere.obj"))
+            ("b,backend", "Rendering backend <window|egl|osmesa|raytrace|raster|heightfield>, egl and osmesa render offscreen without a display, raytrace and raster run on the CPU without OpenGL, heightfield sweeps 2.5D volumes over a heightmap of the scene", cxxopts::value<std::string>()->default_value("window"))
+            ("l,layered", "Render all six faces of a visibility volume in a single layered pass")
+            ("cell", "Cell size of the heightmap of the heightfield backend", cxxopts::value<float>()->default_value("1"))
+            ("coverage", "With the heightfield backend, write the number of volume origins that see each heightmap cell to this binary raster instead of the volume meshes", cxxopts::value<std::string>())
+            ("target-height", "Height above the ground at which --coverage tests visibility", cxxopts::value<float>()->default_value("0"))
+            ("first-observer", "Also store the index of the first volume that sees each cell in the --coverage raster")
+            ("t,threads", "Number of threads of the CPU backends, 0 uses all cores", cxxopts::value<int>()->default_value("0"))
+            ("s,spherical", "Write visibility volumes as a single equirectangular (theta, phi) grid mesh")
+            ("a,adaptive", "Mesh the cube faces adaptively, keeping every pixel within this distance of the mesh (0 = one quad per pixel)", cxxopts::value<float>()->default_value("0"))
+            ("w,weld", "Weld the cube faces into one mesh over the pixel corners instead of stitching the seams")
+            ("intersect", "Also write the region common to all visibility volumes of the config to this file", cxxopts::value<std::string>())
+            ("voxel", "Voxelize visibility volumes in the world frame with this voxel size, writing brick maps (.vbm) instead of meshes", cxxopts::value<float>())
+            ("union", "With --voxel, also write the surface of the union of all visibility volumes of the config to this file", cxxopts::value<std::string>())
+            ("cache", "Directory of a content addressed cache of volume outputs, reruns with unchanged meshes and parameters copy them from there", cxxopts::value<std::string>())
+            ("serve", "Load the scene once, then answer visibility volume requests, one YAML or JSON line each, on stdin or with --serve=<path> on a Unix socket", cxxopts::value<std::string>()->implicit_value("-"))
             ("h,help", "Print usage")
             ;
 }
@@ -764,7 +1242,14 @@ int main(int argc, char **argv) {
         exit(0);
     }
     std::string inputfile;
-    bool USE_BUILTIN_SCENE = false;
+
+    // "-" serves stdin, anything else is a socket path. Opened first so that
+    // in stdin mode everything printed from here on stays out of the replies.
+    std::string serve_path = result.count("serve") ? result["serve"].as<std::string>() : "";
+    RequestServer server;
+    if (!serve_path.empty() && !(serve_path == "-" ? server.openStdio() : server.openSocket(serve_path))) {
+        return -1;
+    }
 
     YAML_Config::YAML_ConfigPtr config_ptr;
     YAML_CoordinateSystem world_coord_sys;
@@ -782,37 +1267,279 @@ int main(int argc, char **argv) {
             }
         }
     }
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    VolumeOptions volume_options;
+    volume_options.spherical = result.count("spherical") > 0;
+    volume_options.adaptive_tolerance = result["adaptive"].as<float>();
+    volume_options.weld_seams = result.count("weld") > 0;
+    // every finished volume is written and, with --intersect, kept for the intersection
+    std::string intersect_path = result.count("intersect") ? result["intersect"].as<std::string>() : "";
+    VolumeIntersection intersection;
+    // declared before the volume callbacks, the statistics print when main returns
+    ResultCache cache;
+    // with --voxel every volume is a brick map, intersected and united voxel by voxel
+    float voxel_size = result.count("voxel") ? result["voxel"].as<float>() : 0.0f;
+    std::string union_path = result.count("union") ? result["union"].as<std::string>() : "";
+    VoxelGrid voxel_intersection, voxel_union;
+    voxel_union.setup(world_coord_sys.origin, glm::mat3(world_coord_sys.getTransform()), voxel_size);
+    int num_voxelized = 0;
+    auto finishVolume = [&](VisibilityVolume & vvol) {
+        if (voxel_size > 0.0f) {
+            VoxelGrid grid;
+            grid.setup(world_coord_sys.origin, glm::mat3(world_coord_sys.getTransform()), voxel_size);
+            if (!vvol.voxelize(grid, world_coord_sys)) {
+                return;
+            }
+            std::string filename = vvol.output_filename;
+            size_t dot = filename.find_last_of("./");
+            filename = ((dot != std::string::npos && filename[dot] == '.') ? filename.substr(0, dot) : filename) + ".vbm";
+            grid.write(filename);
+            if (!intersect_path.empty()) {
+                if (num_voxelized == 0) {
+                    voxel_intersection = grid;
+                } else {
+                    voxel_intersection.intersect(grid);
+                }
+            }
+            if (!union_path.empty()) {
+                voxel_union.unite(grid);
+            }
+            num_voxelized++;
+            return;
+        }
+        if (vvol.writeVolume(world_coord_sys) && !vvol.cache_key.empty()) {
+            cache.store(vvol.cache_key, vvol.output_filename);
+        }
+        if (!intersect_path.empty()) {
+            vvol.addToIntersection(intersection, world_coord_sys);
+        }
+    };
+    auto writeVoxelSurface = [&](const VoxelGrid& grid, const std::string& path) {
+        std::cout << path << ": " << grid.count() << " voxels, volume " << grid.count() * grid.voxelVolume() << std::endl;
+        VolumeMesh surface;
+        grid.extractSurface(surface);
+        surface.write(path);
+    };
+    auto writeIntersection = [&]() {
+        if (num_voxelized > 0) {
+            if (!intersect_path.empty()) {
+                writeVoxelSurface(voxel_intersection, intersect_path);
+            }
+            if (!union_path.empty()) {
+                writeVoxelSurface(voxel_union, union_path);
+            }
+        }
+        if (!intersect_path.empty() && intersection.size() > 0) {
+            VolumeMesh common;
+            intersection.intersect(common);
+            common.write(intersect_path);
+        }
+    };
+    std::vector<VisibilityVolume> visibility_vol_list;
+    if (config_ptr != nullptr) {
+        for (unsigned int i = 0; i < config_ptr->visibility_volumes.size(); i++) {
+            VisibilityVolume vvol;
+            vvol.configure(config_ptr->visibility_volumes[i], volume_options);
+            visibility_vol_list.push_back(vvol);
+        }
+    } else {
+        VisibilityVolume vvol;
+        std::string outputfile = result["output"].as<std::string>();
+        vvol.output_filename = outputfile;
+        float target_x = result["x"].as<float>();
+        float target_y = result["y"].as<float>();
+        float target_z = result["z"].as<float>();
+        vvol.origin = glm::vec3(target_x, target_y, target_z);
+        float MAX_DEPTH = result["radius"].as<float>();
+        vvol.radius_max = MAX_DEPTH;
+        SCR_WIDTH = result["rx"].as<unsigned int>();
+        SCR_HEIGHT = result["ry"].as<unsigned int>();
+        vvol.iWidth = SCR_WIDTH;
+        vvol.iHeight = SCR_HEIGHT;
+        vvol.spherical = volume_options.spherical;
+        vvol.adaptive_tolerance = volume_options.adaptive_tolerance;
+        vvol.weld_seams = volume_options.weld_seams;
+        // a server renders only what it is asked for
+        if (serve_path.empty()) {
+            visibility_vol_list.push_back(vvol);
+        }
+    }
+
+    ThreadPool::setNumThreads(result["threads"].as<int>());
+    std::string backend = result["backend"].as<std::string>();
+    if (result.count("cache")) {
+        // outputs derived from several volumes need every depth image
+        if (!intersect_path.empty() || !union_path.empty() || voxel_size > 0.0f || result.count("coverage")) {
+            std::cout << "The cache holds volume meshes only, it is not used with --intersect, --union, --voxel or --coverage." << std::endl;
+        } else if (cache.open(result["cache"].as<std::string>())) {
+            std::vector<std::pair<std::string, glm::mat4> > meshes;
+            if (config_ptr != nullptr) {
+                for (unsigned int i = 0; i < config_ptr->meshes.size(); i++) {
+                    meshes.push_back(std::make_pair(config_ptr->meshes[i].filename, config_ptr->meshes[i].getTransform()));
+                }
+            } else if (result.count("input")) {
+                meshes.push_back(std::make_pair(result["input"].as<std::string>(), glm::mat4(1.0f)));
+            }
+            std::vector<SceneMeshEntry> mesh_entries;
+            bool hashed = !meshes.empty() && sceneMeshEntries(meshes, cache, mesh_entries);
+            // the heightfield output also depends on the heightmap resolution,
+            // and its grid is placed on the bounds of the whole scene
+            std::string renderer = backend;
+            bool whole_scene = (backend == "heightfield");
+            if (whole_scene) {
+                renderer += " " + std::to_string(result["cell"].as<float>());
+            }
+            if (hashed) {
+                std::vector<VisibilityVolume> misses;
+                for (VisibilityVolume& vvol : visibility_vol_list) {
+                    // a mesh matters when its bounds meet the sphere the
+                    // volume is clamped to, edits elsewhere keep the key
+                    ContentHash scene_hash;
+                    double radius = vvol.cullRadius();
+                    for (const SceneMeshEntry& entry : mesh_entries) {
+                        glm::vec3 nearest = glm::clamp(vvol.origin, entry.lo, entry.hi);
+                        if (whole_scene || glm::dot(nearest - vvol.origin, nearest - vvol.origin) <= radius * radius) {
+                            scene_hash.update(entry.key);
+                        }
+                    }
+                    vvol.cache_key = vvol.cacheKey(scene_hash, world_coord_sys, renderer);
+                    if (!cache.fetch(vvol.cache_key, vvol.output_filename)) {
+                        misses.push_back(vvol);
+                    }
+                }
+                visibility_vol_list.swap(misses);
+                // all hits: no context, no models
+                if (visibility_vol_list.empty() && serve_path.empty()) {
+                    return 0;
+                }
+            } else {
+                std::cout << "Could not read the scene meshes to hash them, the cache is not used." << std::endl;
+            }
+        }
+    }
+    if (backend == "raytrace" || backend == "raster" || backend == "heightfield") {
+        // CPU backends: the meshes are read straight into a triangle soup
+        SceneGeometry geometry;
+        if (config_ptr != nullptr) {
+            for (unsigned int i = 0; i < config_ptr->meshes.size(); i++) {
+                geometry.loadModel(config_ptr->meshes[i].filename, config_ptr->meshes[i].getTransform());
+            }
+        } else if (result.count("input")) {
+            geometry.loadModel(result["input"].as<std::string>());
+        } else {
+            std::cout << "The " << backend << " backend requires an input mesh or a YAML config file." << std::endl;
+            return -1;
+        }
+        if (backend == "heightfield") {
+            // rasterized once, then one R2 sweep per volume, volumes in parallel
+            Heightmap heightmap;
+            if (!heightmap.build(geometry, result["cell"].as<float>())) {
+                return -1;
+            }
+            if (glm::abs(world_coord_sys.up.y) < 0.999f * glm::length(world_coord_sys.up)) {
+                std::cout << "The heightfield backend measures heights along +y, the world up vector is ignored." << std::endl;
+            }
+            if (!intersect_path.empty() || !serve_path.empty()) {
+                std::cout << "--intersect and --serve need the depth images of a capture backend." << std::endl;
+            }
+            if (result.count("coverage")) {
+                std::vector<glm::vec3> origins;
+                std::vector<float> radii;
+                for (const VisibilityVolume& vvol : visibility_vol_list) {
+                    origins.push_back(vvol.origin);
+                    radii.push_back(std::min(vvol.radius_max, MAX_DEPTH));
+                }
+                CoverageRaster coverage;
+                coverage.accumulate(heightmap, origins.data(), radii.data(), (int) origins.size(),
+                        result["target-height"].as<float>(), result.count("first-observer") > 0);
+                return coverage.write(result["coverage"].as<std::string>()) ? 0 : -1;
+            }
+            std::vector<uint8_t> written(visibility_vol_list.size(), 0);
+            parallel_for(0, (int) visibility_vol_list.size(), [&](int vvol_index) {
+                written[vvol_index] = visibility_vol_list[vvol_index].writeHeightfieldVolume(heightmap, world_coord_sys);
+            });
+            for (unsigned int vvol_index = 0; vvol_index < visibility_vol_list.size(); vvol_index++) {
+                const VisibilityVolume& vvol = visibility_vol_list[vvol_index];
+                if (written[vvol_index] && !vvol.cache_key.empty()) {
+                    cache.store(vvol.cache_key, vvol.output_filename);
+                }
+            }
+            return 0;
+        }
+        CpuDepthRenderer *renderer;
+        if (backend == "raytrace") {
+            renderer = new RaycastRenderer(geometry);
+        } else {
+            renderer = new SoftRasterizer(geometry);
+        }
+        for (unsigned int vvol_index = 0; vvol_index < visibility_vol_list.size(); vvol_index++) {
+            visibility_vol_list[vvol_index].renderCPU(*renderer);
+            finishVolume(visibility_vol_list[vvol_index]);
+        }
+        writeIntersection();
+        if (!serve_path.empty()) {
+            server.serve([&](const std::string & line) {
+                return serveVisibilityRequest(line, volume_options, world_coord_sys, [&](VisibilityVolume & vvol) {
+                    vvol.renderCPU(*renderer);
+                });
+            });
+        }
+        delete renderer;
+        return 0;
+    }
+    bool USE_WINDOW = (backend == "window");
+    bool USE_LAYERED = result.count("layered") > 0;
+    OffscreenContext offscreen_context;
+    GLFWwindow* window = NULL;
+    if (USE_WINDOW) {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGLDepthRenderer", NULL, NULL);
-    if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-
-    // tell GLFW to capture our mouse
-    //glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenGLDepthRenderer", NULL, NULL);
+        if (window == NULL) {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+
+        // tell GLFW to capture our mouse
+        //glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+    } else {
+        // headless: no window, all rendering goes to a framebuffer object
+        // ----------------------------------------------------------------
+        OffscreenContext::Provider provider = OffscreenContext::providerFromString(backend);
+        if (provider == OffscreenContext::PROVIDER_NONE) {
+            std::cout << "Unsupported rendering backend \"" << backend << "\"." << std::endl;
+            return -1;
+        }
+        if (!offscreen_context.create(provider, 4, 5)) {
+            std::cout << "Failed to create an offscreen OpenGL context" << std::endl;
+            return -1;
+        }
+        if (!gladLoadGLLoader(offscreen_context.getProcLoader())) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
     }
 
     // configure global opengl state
@@ -841,62 +1568,27 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
-    std::vector<VisibilityVolume> visibility_vol_list;
-    if (config_ptr != nullptr) {
-        for (unsigned int i = 0; i < config_ptr->visibility_volumes.size(); i++) {
-            VisibilityVolume vvol;
-            vvol.iWidth = config_ptr->visibility_volumes[i].width;
-            vvol.iHeight = config_ptr->visibility_volumes[i].height;
-            vvol.fov_degrees = config_ptr->visibility_volumes[i].fov_degrees;
-            vvol.origin = config_ptr->visibility_volumes[i].origin;
-            vvol.front = config_ptr->visibility_volumes[i].front;
-            vvol.up = config_ptr->visibility_volumes[i].up;
-            vvol.up_max = config_ptr->visibility_volumes[i].up_max;
-            vvol.up_min = config_ptr->visibility_volumes[i].up_min;
-            vvol.radius_max = config_ptr->visibility_volumes[i].radius_max;
-            vvol.output_filename = config_ptr->visibility_volumes[i].output_filename;
-            visibility_vol_list.push_back(vvol);
-        }
-    } else {
-        VisibilityVolume vvol;
-        std::string outputfile = result["output"].as<std::string>();
-        vvol.output_filename = outputfile;
-        float target_x = result["x"].as<float>();
-        float target_y = result["y"].as<float>();
-        float target_z = result["z"].as<float>();
-        vvol.origin = glm::vec3(target_x, target_y, target_z);
-        float MAX_DEPTH = result["radius"].as<float>();
-        vvol.radius_max = MAX_DEPTH;
-        SCR_WIDTH = result["rx"].as<unsigned int>();
-        SCR_HEIGHT = result["ry"].as<unsigned int>();
-        vvol.iWidth = SCR_WIDTH;
-        vvol.iHeight = SCR_HEIGHT;
-        visibility_vol_list.push_back(vvol);
-    }
-
     Model *loadedModel = NULL;
-    DefaultScene *defaultScene;
-    std::vector<Model> model_list;
-    std::vector<glm::mat4> model_xforms;
+    DepthScene scene;
     if (config_ptr != nullptr) {
         for (unsigned int i = 0; i < config_ptr->meshes.size(); i++) {
             inputfile = config_ptr->meshes[i].filename;
-            loadedModel = new Model(inputfile);
-            model_list.push_back(*loadedModel);
-            model_xforms.push_back(config_ptr->meshes[i].getTransform());
+            loadedModel = new Model(inputfile, false, true);
+            scene.model_list.push_back(*loadedModel);
+            scene.model_xforms.push_back(config_ptr->meshes[i].getTransform());
             delete(loadedModel);
         }
     } else if (result.count("input")) {
         inputfile = result["input"].as<std::string>();
-        loadedModel = new Model(inputfile);
-        model_list.push_back(*loadedModel);
-        model_xforms.push_back(glm::mat4(1.0f));
+        loadedModel = new Model(inputfile, false, true);
+        scene.model_list.push_back(*loadedModel);
+        scene.model_xforms.push_back(glm::mat4(1.0f));
         delete(loadedModel);
     } else {
         std::cout << "No input file provided. Using the default scene" << std::endl;
-        USE_BUILTIN_SCENE = true;
-        defaultScene = new DefaultScene();
+        scene.defaultScene = new DefaultScene();
     }
+    scene.buildIndex();
 
 
     // build and compile and configure shaders
@@ -905,6 +1597,78 @@ int main(int argc, char **argv) {
     shader.use();
     shader.setInt("texture1", 0);
 
+    if (!USE_WINDOW || USE_LAYERED || !serve_path.empty()) {
+        // render every visibility volume back to back, throughput is bounded by rasterization.
+        // Face readbacks go through a two volume ring of pixel pack buffers: volume i
+        // is rendered while the faces of volume i - 1 transfer, then volume i - 1 is
+        // mapped and written out.
+        DepthFramebuffer fbo;
+        DepthReadback readback;
+        Shader *layeredShader = nullptr;
+        if (USE_LAYERED) {
+            layeredShader = new Shader("depth_testing_revZ_layered.vs", "depth_testing_revZ.fs", "depth_testing_revZ_layered.gs");
+        }
+        VisibilityVolume *pending_vvol = nullptr;
+        int pending_slotBase = 0;
+        for (unsigned int vvol_index = 0; vvol_index <= visibility_vol_list.size(); vvol_index++) {
+            VisibilityVolume *vvol_ptr = nullptr;
+            int slotBase = 0;
+            if (vvol_index < visibility_vol_list.size()) {
+                vvol_ptr = &visibility_vol_list[vvol_index];
+                if (vvol_ptr->iHeight != readback.height && pending_vvol != nullptr) {
+                    // the ring is reallocated for a new resolution, drain it first
+                    if (pending_vvol->mapDepthBuffers(readback, pending_slotBase)) {
+                        finishVolume(*pending_vvol);
+                    }
+                    pending_vvol->unmapDepthBuffers(readback, pending_slotBase);
+                    pending_vvol = nullptr;
+                }
+                readback.create(vvol_ptr->iHeight, vvol_ptr->iHeight, 2 * vvol_ptr->numImages);
+                slotBase = (pending_slotBase == 0 && pending_vvol != nullptr) ? vvol_ptr->numImages : 0;
+                if (USE_LAYERED) {
+                    vvol_ptr->renderOffscreenLayered(fbo, *layeredShader, scene, &readback, slotBase);
+                } else {
+                    vvol_ptr->renderOffscreen(fbo, shader, scene, &readback, slotBase);
+                }
+            }
+            if (pending_vvol != nullptr) {
+                if (pending_vvol->mapDepthBuffers(readback, pending_slotBase)) {
+                    finishVolume(*pending_vvol);
+                }
+                pending_vvol->unmapDepthBuffers(readback, pending_slotBase);
+            }
+            pending_vvol = vvol_ptr;
+            pending_slotBase = slotBase;
+        }
+        writeIntersection();
+        scene.printCullingStats();
+        if (!serve_path.empty()) {
+            // one volume at a time, read back synchronously
+            server.serve([&](const std::string & line) {
+                return serveVisibilityRequest(line, volume_options, world_coord_sys, [&](VisibilityVolume & vvol) {
+                    if (USE_LAYERED) {
+                        vvol.renderOffscreenLayered(fbo, *layeredShader, scene);
+                    } else {
+                        vvol.renderOffscreen(fbo, shader, scene);
+                    }
+                });
+            });
+        }
+        // the GL objects go while the context still exists, glfwTerminate()
+        // below destroys the window's context before fbo leaves its scope
+        if (layeredShader != nullptr) {
+            glDeleteProgram(layeredShader->ID);
+            delete layeredShader;
+        }
+        fbo.destroy();
+        readback.destroy();
+        scene.destroyBuffers();
+        if (USE_WINDOW) {
+            glfwTerminate();
+        }
+        return 0;
+    }
+
     // render loop
     glm::mat4 view, projection;
 
@@ -934,7 +1698,7 @@ int main(int argc, char **argv) {
             // pointer has been initialized, test it to see if we need to increment the pointer and setup a new calculation
             if (!vvol_ptr->hasMoreImages()) {
                 // write the calculated volume boundary surface as an OBJ file
-                vvol_ptr->writeVolumeToOBJ(world_coord_sys);
+                finishVolume(*vvol_ptr);
                 // go to the next visibility volume calculation 
                 vvol_index++;
                 if (vvol_index < visibility_vol_list.size()) {
@@ -943,6 +1707,7 @@ int main(int argc, char **argv) {
                 } else {
                     // finished processing visibility volume requests
                     vvol_ptr = nullptr;
+                    writeIntersection();
                 }
             }
         } else {
@@ -977,17 +1742,11 @@ int main(int argc, char **argv) {
         //std::cout << "view = " << glm::to_string(view) << std::endl;
         shader.setMat4("projection", projection);
 
-        if (config_ptr != nullptr) {
-            for (unsigned int i = 0; i < model_list.size(); i++) {
-                shader.setMat4("model", model_xforms[i]);
-                model_list[i].Draw(shader);
-            }
-            //        } else if (loadedModel != NULL) {
-            //            model = glm::mat4(1.0f);
-            //            shader.setMat4("model", model);
-            //            loadedModel->Draw(shader);
-        } else if (USE_BUILTIN_SCENE) {
-            defaultScene->drawScene(shader);
+        if (vvol_ptr != nullptr && vvol_ptr->hasMoreImages()) {
+            glm::mat4 viewProjection = projection * view;
+            scene.draw(shader, vvol_ptr->origin, vvol_ptr->cullRadius(), &viewProjection);
+        } else {
+            scene.draw(shader, projection * view);
         }
         // reset the comparison and depth state back to OpenGL defaults, 
         // so the state doesn’t leak into other code that might not be doing 
@@ -1014,6 +1773,8 @@ int main(int argc, char **argv) {
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
 
+    scene.printCullingStats();
+    scene.destroyBuffers();
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,647 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   ogl_visibility_module.cpp
+ *
+ * Python extension module of the CPU backends. A Scene holds the world
+ * geometry and its raytrace or raster renderer, built once, and compute()
+ * returns the welded visibility volume mesh of every origin without any
+ * file in between:
+ *
+ *     import ogl_visibility
+ *     scene = ogl_visibility.Scene(backend="raytrace")
+ *     scene.load("city.obj")
+ *     meshes = scene.compute(origins, 256, 256, radius_max=50.0)
+ *     vertices, triangles = meshes[0]
+ *
+ * line_of_sight(sites, targets) gives the mutual visibility matrix of two
+ * point sets, traced with the any-hit BVH traversal of line_of_sight.hpp.
+ *
+ * range_map() keeps the depth images of one origin resident instead, and its
+ * visible() classifies batches of points without a mesh, see range_cube_map.hpp.
+ *
+ * vertices is a float32 (n, 3) array and triangles a uint32 (m, 3) array of
+ * 0-based indices. Both view the memory of the C++ mesh through the buffer
+ * protocol, which stays alive as long as either array does. NumPy is only
+ * needed at run time; without it memoryviews of the same buffers are
+ * returned. The GIL is released while volumes are computed.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "cube_faces.hpp"
+#include "cube_lattice.hpp"
+#include "line_of_sight.hpp"
+#include "parallel.hpp"
+#include "range_cube_map.hpp"
+#include "raycast_renderer.hpp"
+#include "scene_geometry.hpp"
+#include "soft_rasterizer.hpp"
+#include "volume_mesh.hpp"
+#include "volume_unprojector.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// as in ogl_depthrenderer.cpp
+static const float zNear = 1.0e-2f;
+static const float MAX_DEPTH = 1e5f;
+
+// MeshArray: one (n, 3) buffer of a VolumeMesh
+
+typedef struct {
+    PyObject_HEAD
+    std::shared_ptr<VolumeMesh> *mesh;
+    // vertices (float32) or triangles (uint32)
+    bool triangles;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} MeshArray;
+
+static void MeshArray_dealloc(MeshArray *self) {
+    delete self->mesh;
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int MeshArray_getbuffer(MeshArray *self, Py_buffer *view, int flags) {
+    static float empty[3];
+    VolumeMesh& mesh = **self->mesh;
+    void *data = self->triangles ? (void *) mesh.triangles.data() : (void *) mesh.vertices.data();
+    view->obj = (PyObject *) self;
+    Py_INCREF(self);
+    view->buf = (self->shape[0] > 0) ? data : (void *) empty;
+    view->len = self->shape[0] * 3 * 4;
+    view->readonly = 0;
+    view->itemsize = 4;
+    view->format = (flags & PyBUF_FORMAT) ? (char *) (self->triangles ? "I" : "f") : nullptr;
+    view->ndim = 2;
+    view->shape = (flags & PyBUF_ND) ? self->shape : nullptr;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? self->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+static PyBufferProcs MeshArray_as_buffer = {
+    (getbufferproc) MeshArray_getbuffer,
+    nullptr
+};
+
+static PyTypeObject MeshArrayType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+static PyObject *numpy_asarray = nullptr;
+
+// a NumPy array viewing one buffer of mesh, or a memoryview without NumPy
+
+static PyObject *meshArray(const std::shared_ptr<VolumeMesh>& mesh, bool triangles) {
+    MeshArray *array = PyObject_New(MeshArray, &MeshArrayType);
+    if (array == nullptr) {
+        return nullptr;
+    }
+    array->mesh = new std::shared_ptr<VolumeMesh>(mesh);
+    array->triangles = triangles;
+    array->shape[0] = triangles ? mesh->triangles.size() : mesh->vertices.size();
+    array->shape[1] = 3;
+    array->strides[0] = 3 * 4;
+    array->strides[1] = 4;
+    PyObject *result = (numpy_asarray != nullptr) ?
+            PyObject_CallFunctionObjArgs(numpy_asarray, (PyObject *) array, nullptr) :
+            PyMemoryView_FromObject((PyObject *) array);
+    Py_DECREF(array);
+    return result;
+}
+
+// Scene: world geometry and the CPU renderer built from it
+
+typedef struct {
+    PyObject_HEAD
+    SceneGeometry *geometry;
+    CpuDepthRenderer *renderer;
+    // BVH of the raster backend for line_of_sight(), the raytrace backend has its own
+    BVH *bvh;
+    bool raster;
+} Scene;
+
+static void Scene_dealloc(Scene *self) {
+    delete self->bvh;
+    delete self->renderer;
+    delete self->geometry;
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+// geometry changed, the renderer and BVH are rebuilt when next needed
+
+static void Scene_invalidate(Scene *self) {
+    delete self->bvh;
+    delete self->renderer;
+    self->bvh = nullptr;
+    self->renderer = nullptr;
+}
+
+// the geometry exists from allocation on, so methods never see a null
+// pointer, e.g. on Scene.__new__(Scene) without __init__
+
+static PyObject *Scene_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
+    Scene *self = (Scene *) type->tp_alloc(type, 0);
+    if (self == nullptr) {
+        return nullptr;
+    }
+    self->geometry = new SceneGeometry();
+    self->renderer = nullptr;
+    self->bvh = nullptr;
+    self->raster = false;
+    return (PyObject *) self;
+}
+
+static int Scene_init(Scene *self, PyObject *args, PyObject *kwds) {
+    static const char *kwlist[] = {"backend", nullptr};
+    const char *backend = "raytrace";
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|s", (char **) kwlist, &backend)) {
+        return -1;
+    }
+    std::string name(backend);
+    if (name != "raytrace" && name != "raster") {
+        PyErr_SetString(PyExc_ValueError, "backend must be \"raytrace\" or \"raster\"");
+        return -1;
+    }
+    // __init__ called again starts over with an empty scene
+    Scene_invalidate(self);
+    self->geometry->clear();
+    self->raster = (name == "raster");
+    return 0;
+}
+
+static PyObject *Scene_load(Scene *self, PyObject *args) {
+    const char *path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return nullptr;
+    }
+    Scene_invalidate(self);
+    bool loaded;
+    Py_BEGIN_ALLOW_THREADS
+    loaded = self->geometry->loadModel(path);
+    Py_END_ALLOW_THREADS
+    if (!loaded) {
+        PyErr_Format(PyExc_IOError, "could not load %s", path);
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+// the rows of an (n, 3) sequence, false with a Python error set otherwise
+
+template <typename T>
+static bool readRows(PyObject *rows, const char *name, std::vector<T>& out) {
+    PyObject *seq = PySequence_Fast(rows, name);
+    if (seq == nullptr) {
+        return false;
+    }
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    out.resize(n);
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *row = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, i), name);
+        if (row == nullptr || PySequence_Fast_GET_SIZE(row) != 3) {
+            Py_XDECREF(row);
+            Py_DECREF(seq);
+            PyErr_Format(PyExc_ValueError, "%s must have 3 columns", name);
+            return false;
+        }
+        for (int c = 0; c < 3; c++) {
+            double value = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(row, c));
+            if (std::is_integral<typename T::value_type>::value && value < 0) {
+                value = std::numeric_limits<typename T::value_type>::max();
+            }
+            out[i][c] = (typename T::value_type) value;
+        }
+        Py_DECREF(row);
+    }
+    Py_DECREF(seq);
+    return !PyErr_Occurred();
+}
+
+static PyObject *Scene_add_mesh(Scene *self, PyObject *args) {
+    PyObject *vertex_rows, *triangle_rows;
+    if (!PyArg_ParseTuple(args, "OO", &vertex_rows, &triangle_rows)) {
+        return nullptr;
+    }
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::u32vec3> triangles;
+    if (!readRows(vertex_rows, "vertices", vertices) || !readRows(triangle_rows, "triangles", triangles)) {
+        return nullptr;
+    }
+    for (const glm::u32vec3& face : triangles) {
+        if (face.x >= vertices.size() || face.y >= vertices.size() || face.z >= vertices.size()) {
+            PyErr_SetString(PyExc_IndexError, "triangle index out of range");
+            return nullptr;
+        }
+    }
+    Scene_invalidate(self);
+    SceneGeometry& geometry = *self->geometry;
+    unsigned int base = (unsigned int) geometry.vertices.size();
+    geometry.vertices.insert(geometry.vertices.end(), vertices.begin(), vertices.end());
+    for (const glm::u32vec3& face : triangles) {
+        geometry.triangles.push_back(face + glm::u32vec3(base));
+    }
+    Py_RETURN_NONE;
+}
+
+// points of a C contiguous (n, 3) float32 or float64 buffer without a Python
+// object per value, any other (n, 3) sequence row by row
+
+static bool readPoints(PyObject *rows, const char *name, std::vector<glm::vec3>& out) {
+    Py_buffer view;
+    if (PyObject_CheckBuffer(rows) && PyObject_GetBuffer(rows, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == 0) {
+        const char *format = (view.format != nullptr) ? view.format : "B";
+        if (*format == '@' || *format == '=' || *format == '<') {
+            format++;
+        }
+        bool single = std::strcmp(format, "f") == 0, twice = std::strcmp(format, "d") == 0;
+        bool read = view.ndim == 2 && view.shape[1] == 3 && (single || twice);
+        if (read) {
+            out.resize(view.shape[0]);
+            if (single) {
+                std::memcpy(out.data(), view.buf, out.size() * sizeof (glm::vec3));
+            } else {
+                const double *values = (const double *) view.buf;
+                for (size_t n = 0; n < out.size(); n++) {
+                    out[n] = glm::vec3(values[3 * n], values[3 * n + 1], values[3 * n + 2]);
+                }
+            }
+        }
+        PyBuffer_Release(&view);
+        if (read) {
+            return true;
+        }
+    }
+    PyErr_Clear();
+    return readRows(rows, name, out);
+}
+
+// a bool array viewing the bytes of a bytearray, a memoryview without NumPy.
+// With rows >= 0 the array has shape (rows, columns), except for memoryviews
+// of no elements, which can not be cast to two dimensions and stay flat.
+
+static PyObject *boolArray(PyObject *bytes, Py_ssize_t rows = -1, Py_ssize_t columns = 0) {
+    PyObject *view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (view == nullptr) {
+        return nullptr;
+    }
+    bool shaped = rows >= 0 && (numpy_asarray != nullptr || rows * columns > 0);
+    PyObject *flags = (shaped && numpy_asarray == nullptr) ?
+            PyObject_CallMethod(view, "cast", "s[nn]", "?", rows, columns) :
+            PyObject_CallMethod(view, "cast", "s", "?");
+    Py_DECREF(view);
+    if (flags == nullptr || numpy_asarray == nullptr) {
+        return flags;
+    }
+    PyObject *array = PyObject_CallFunctionObjArgs(numpy_asarray, flags, nullptr);
+    Py_DECREF(flags);
+    if (array == nullptr || !shaped) {
+        return array;
+    }
+    PyObject *matrix = PyObject_CallMethod(array, "reshape", "nn", rows, columns);
+    Py_DECREF(array);
+    return matrix;
+}
+
+// RangeMap: the resident depth images of one origin
+
+typedef struct {
+    PyObject_HEAD
+    RangeCubeMap *map;
+} RangeMap;
+
+static void RangeMap_dealloc(RangeMap *self) {
+    delete self->map;
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *RangeMap_visible(RangeMap *self, PyObject *args) {
+    PyObject *point_rows;
+    if (!PyArg_ParseTuple(args, "O", &point_rows)) {
+        return nullptr;
+    }
+    std::vector<glm::vec3> points;
+    if (!readPoints(point_rows, "points", points)) {
+        return nullptr;
+    }
+    PyObject *bytes = PyByteArray_FromStringAndSize(nullptr, (Py_ssize_t) points.size());
+    if (bytes == nullptr) {
+        return nullptr;
+    }
+    uint8_t *visible = (uint8_t *) PyByteArray_AS_STRING(bytes);
+    Py_BEGIN_ALLOW_THREADS
+    self->map->classify(points.data(), points.size(), visible);
+    Py_END_ALLOW_THREADS
+    return boolArray(bytes);
+}
+
+static PyObject *RangeMap_nbytes(RangeMap *self, void *) {
+    return PyLong_FromSize_t(self->map->imageBytes());
+}
+
+static PyObject *RangeMap_quantized(RangeMap *self, void *) {
+    return PyBool_FromLong(self->map->quantized());
+}
+
+static PyMethodDef RangeMap_methods[] = {
+    {"visible", (PyCFunction) RangeMap_visible, METH_VARARGS,
+        "visible(points): bool array, True for the (x, y, z) points inside the visibility volume"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyGetSetDef RangeMap_getset[] = {
+    {(char *) "nbytes", (getter) RangeMap_nbytes, nullptr, (char *) "memory of the depth images", nullptr},
+    {(char *) "quantized", (getter) RangeMap_quantized, nullptr, (char *) "depth stored in 16 bits", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+static PyTypeObject RangeMapType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+// the renderer, built on first use. Call without the GIL.
+
+static CpuDepthRenderer *Scene_renderer(Scene *self) {
+    if (self->renderer == nullptr) {
+        if (self->raster) {
+            self->renderer = new SoftRasterizer(*self->geometry);
+        } else {
+            self->renderer = new RaycastRenderer(*self->geometry);
+        }
+    }
+    return self->renderer;
+}
+
+// the BVH of the raytrace renderer or one built for the raster backend. Call without the GIL.
+
+static const BVH& Scene_bvh(Scene *self) {
+    if (!self->raster) {
+        return static_cast<RaycastRenderer *> (Scene_renderer(self))->getBVH();
+    }
+    if (self->bvh == nullptr) {
+        self->bvh = new BVH();
+        self->bvh->build(*self->geometry);
+    }
+    return *self->bvh;
+}
+
+// renders the cube faces of origin into depth_images and sets up unprojector
+// with the limits. Call without the GIL.
+
+static void Scene_render(Scene *self, const glm::vec3& origin, int width, int height, float radius_max,
+        float up_min, float up_max, float **depth_images, VolumeUnprojector& unprojector) {
+    const glm::vec3 front(1.0f, 0.0f, 0.0f), up(0.0f, 1.0f, 0.0f);
+    glm::mat4 views[CUBE_FACES];
+    for (int k = 0; k < CUBE_FACES; k++) {
+        views[k] = cubeFaceView(origin, front, up, CUBE_FACE_THETAS[k], CUBE_FACE_PHIS[k]);
+    }
+    Scene_renderer(self)->renderDepth(views, CUBE_FACES, glm::radians(90.0f), 1.0f, zNear, width, height, depth_images);
+    unprojector.setupRays(views, CUBE_FACES, glm::radians(90.0f), 1.0f, width, height, false);
+    // the default world coordinate system, the identity frame at the origin
+    unprojector.setLimits(origin, zNear, zNear / MAX_DEPTH, glm::mat3(1.0f), radius_max,
+            glm::vec3(0.0f), up, up, up_min, up_max);
+}
+
+static PyObject *Scene_compute(Scene *self, PyObject *args, PyObject *kwds) {
+    static const char *kwlist[] = {"origins", "width", "height", "radius_max", "up_min", "up_max",
+        "tolerance", nullptr};
+    PyObject *origin_rows;
+    int width, height;
+    float radius_max = std::numeric_limits<float>::max();
+    float up_min = -std::numeric_limits<float>::max(), up_max = std::numeric_limits<float>::max();
+    float tolerance = 0.0f;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oii|ffff", (char **) kwlist, &origin_rows,
+            &width, &height, &radius_max, &up_min, &up_max, &tolerance)) {
+        return nullptr;
+    }
+    if (width != height || width < 1) {
+        PyErr_SetString(PyExc_ValueError, "the cube faces must be square, width == height > 0");
+        return nullptr;
+    }
+    std::vector<glm::vec3> origins;
+    if (!readRows(origin_rows, "origins", origins)) {
+        return nullptr;
+    }
+    std::vector<std::shared_ptr<VolumeMesh> > meshes(origins.size());
+    bool welded = true;
+    Py_BEGIN_ALLOW_THREADS
+    std::vector<float> depth(CUBE_FACES * width * height);
+    float *depth_images[CUBE_FACES];
+    for (int k = 0; k < CUBE_FACES; k++) {
+        depth_images[k] = &depth[k * width * height];
+    }
+    CubeLattice lattice;
+    for (size_t n = 0; n < origins.size() && welded; n++) {
+        VolumeUnprojector unprojector;
+        Scene_render(self, origins[n], width, height, radius_max, up_min, up_max, depth_images, unprojector);
+        if (n == 0) {
+            welded = lattice.setup(unprojector);
+        }
+        if (welded) {
+            meshes[n] = std::make_shared<VolumeMesh>();
+            lattice.mesh(unprojector, depth_images, tolerance, *meshes[n]);
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (!welded) {
+        PyErr_SetString(PyExc_RuntimeError, "the cube faces could not be welded");
+        return nullptr;
+    }
+    PyObject *result = PyList_New(meshes.size());
+    if (result == nullptr) {
+        return nullptr;
+    }
+    for (size_t n = 0; n < meshes.size(); n++) {
+        PyObject *vertices = meshArray(meshes[n], false);
+        PyObject *triangles = (vertices != nullptr) ? meshArray(meshes[n], true) : nullptr;
+        if (triangles == nullptr) {
+            Py_XDECREF(vertices);
+            Py_DECREF(result);
+            return nullptr;
+        }
+        PyList_SET_ITEM(result, n, PyTuple_Pack(2, vertices, triangles));
+        Py_DECREF(vertices);
+        Py_DECREF(triangles);
+    }
+    return result;
+}
+
+static PyObject *Scene_range_map(Scene *self, PyObject *args, PyObject *kwds) {
+    static const char *kwlist[] = {"origin", "width", "height", "radius_max", "up_min", "up_max",
+        "quantize", nullptr};
+    float x, y, z;
+    int width, height;
+    float radius_max = std::numeric_limits<float>::max();
+    float up_min = -std::numeric_limits<float>::max(), up_max = std::numeric_limits<float>::max();
+    int quantize = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "(fff)ii|fffp", (char **) kwlist, &x, &y, &z,
+            &width, &height, &radius_max, &up_min, &up_max, &quantize)) {
+        return nullptr;
+    }
+    if (width < 1 || height < 1) {
+        PyErr_SetString(PyExc_ValueError, "width and height must be positive");
+        return nullptr;
+    }
+    RangeMap *map = PyObject_New(RangeMap, &RangeMapType);
+    if (map == nullptr) {
+        return nullptr;
+    }
+    map->map = new RangeCubeMap();
+    Py_BEGIN_ALLOW_THREADS
+    std::vector<float> depth(CUBE_FACES * width * height);
+    float *depth_images[CUBE_FACES];
+    for (int k = 0; k < CUBE_FACES; k++) {
+        depth_images[k] = &depth[k * width * height];
+    }
+    VolumeUnprojector unprojector;
+    Scene_render(self, glm::vec3(x, y, z), width, height, radius_max, up_min, up_max, depth_images, unprojector);
+    map->map->setup(unprojector, depth_images, quantize != 0);
+    Py_END_ALLOW_THREADS
+    return (PyObject *) map;
+}
+
+static PyObject *Scene_line_of_sight(Scene *self, PyObject *args, PyObject *kwds) {
+    static const char *kwlist[] = {"sites", "targets", "tolerance", nullptr};
+    PyObject *site_rows, *target_rows;
+    float tolerance = 1.0e-3f;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|f", (char **) kwlist, &site_rows, &target_rows, &tolerance)) {
+        return nullptr;
+    }
+    std::vector<glm::vec3> sites, targets;
+    if (!readPoints(site_rows, "sites", sites) || !readPoints(target_rows, "targets", targets)) {
+        return nullptr;
+    }
+    PyObject *bytes = PyByteArray_FromStringAndSize(nullptr, (Py_ssize_t) (sites.size() * targets.size()));
+    if (bytes == nullptr) {
+        return nullptr;
+    }
+    uint8_t *visible = (uint8_t *) PyByteArray_AS_STRING(bytes);
+    Py_BEGIN_ALLOW_THREADS
+    size_t words = LineOfSight::rowWords(targets.size());
+    std::vector<uint64_t> bits(sites.size() * words);
+    LineOfSight(Scene_bvh(self), tolerance).matrix(sites.data(), sites.size(), targets.data(), targets.size(), bits.data());
+    for (size_t i = 0; i < sites.size(); i++) {
+        for (size_t j = 0; j < targets.size(); j++) {
+            visible[i * targets.size() + j] = (uint8_t) ((bits[i * words + j / 64] >> (j % 64)) & 1);
+        }
+    }
+    Py_END_ALLOW_THREADS
+    return boolArray(bytes, (Py_ssize_t) sites.size(), (Py_ssize_t) targets.size());
+}
+
+static PyObject *Scene_num_triangles(Scene *self, void *) {
+    return PyLong_FromUnsignedLong(self->geometry->numTriangles());
+}
+
+static PyMethodDef Scene_methods[] = {
+    {"load", (PyCFunction) Scene_load, METH_VARARGS,
+        "load(path): add the meshes of a model file read with Assimp"},
+    {"add_mesh", (PyCFunction) Scene_add_mesh, METH_VARARGS,
+        "add_mesh(vertices, triangles): add an (n, 3) vertex and an (m, 3) 0-based index array"},
+    {"compute", (PyCFunction) Scene_compute, METH_VARARGS | METH_KEYWORDS,
+        "compute(origins, width, height, radius_max=inf, up_min=-inf, up_max=inf, tolerance=0.0)\n"
+        "visibility volume of every (x, y, z) origin, a list of (vertices, triangles) arrays.\n"
+        "Heights are measured along +y, tolerance > 0 meshes adaptively."},
+    {"range_map", (PyCFunction) Scene_range_map, METH_VARARGS | METH_KEYWORDS,
+        "range_map(origin, width, height, radius_max=inf, up_min=-inf, up_max=inf, quantize=False)\n"
+        "RangeMap of the depth images of one (x, y, z) origin, quantize stores them in 16 bits."},
+    {"line_of_sight", (PyCFunction) Scene_line_of_sight, METH_VARARGS | METH_KEYWORDS,
+        "line_of_sight(sites, targets, tolerance=1e-3)\n"
+        "(n, m) bool array, True where site i sees target j. tolerance is left free at both ends."},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyGetSetDef Scene_getset[] = {
+    {(char *) "num_triangles", (getter) Scene_num_triangles, nullptr, (char *) "triangles of the scene", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+static PyTypeObject SceneType = {
+    PyVarObject_HEAD_INIT(nullptr, 0)
+};
+
+static PyObject *set_num_threads(PyObject *, PyObject *args) {
+    int numThreads;
+    if (!PyArg_ParseTuple(args, "i", &numThreads)) {
+        return nullptr;
+    }
+    ThreadPool::setNumThreads(numThreads);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef module_methods[] = {
+    {"set_num_threads", set_num_threads, METH_VARARGS,
+        "set_num_threads(n): worker threads of the CPU backends, 0 uses all cores"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static struct PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "ogl_visibility",
+    "Visibility volumes of the CPU backends as arrays", -1, module_methods
+};
+
+PyMODINIT_FUNC PyInit_ogl_visibility(void) {
+    MeshArrayType.tp_name = "ogl_visibility.MeshArray";
+    MeshArrayType.tp_basicsize = sizeof (MeshArray);
+    MeshArrayType.tp_dealloc = (destructor) MeshArray_dealloc;
+    MeshArrayType.tp_as_buffer = &MeshArray_as_buffer;
+    MeshArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+    MeshArrayType.tp_doc = "Buffer of a visibility volume mesh";
+    RangeMapType.tp_name = "ogl_visibility.RangeMap";
+    RangeMapType.tp_basicsize = sizeof (RangeMap);
+    RangeMapType.tp_dealloc = (destructor) RangeMap_dealloc;
+    RangeMapType.tp_flags = Py_TPFLAGS_DEFAULT;
+    RangeMapType.tp_doc = "Resident depth images of a visibility volume, see Scene.range_map()";
+    RangeMapType.tp_methods = RangeMap_methods;
+    RangeMapType.tp_getset = RangeMap_getset;
+    SceneType.tp_name = "ogl_visibility.Scene";
+    SceneType.tp_basicsize = sizeof (Scene);
+    SceneType.tp_dealloc = (destructor) Scene_dealloc;
+    SceneType.tp_flags = Py_TPFLAGS_DEFAULT;
+    SceneType.tp_doc = "Scene(backend=\"raytrace\"): world geometry and its CPU renderer";
+    SceneType.tp_methods = Scene_methods;
+    SceneType.tp_getset = Scene_getset;
+    SceneType.tp_init = (initproc) Scene_init;
+    SceneType.tp_new = Scene_new;
+    if (PyType_Ready(&MeshArrayType) < 0 || PyType_Ready(&RangeMapType) < 0 || PyType_Ready(&SceneType) < 0) {
+        return nullptr;
+    }
+    PyObject *module = PyModule_Create(&module_def);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(&SceneType);
+    PyModule_AddObject(module, "Scene", (PyObject *) &SceneType);
+    PyObject *numpy = PyImport_ImportModule("numpy");
+    if (numpy != nullptr) {
+        numpy_asarray = PyObject_GetAttrString(numpy, "asarray");
+        Py_DECREF(numpy);
+    }
+    PyErr_Clear();
+    return module;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parallel.hpp"
+
+static int requestedNumThreads = 0;
+
+// set on the pool's worker threads for good and on a calling thread while it
+// runs items of a job, a nested parallelFor() then runs inline
+static thread_local bool insidePool = false;
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool(requestedNumThreads);
+    return pool;
+}
+
+void ThreadPool::setNumThreads(int numThreads) {
+    requestedNumThreads = numThreads;
+}
+
+ThreadPool::ThreadPool(int numThreads) : shutdown(false), job(nullptr), jobEnd(0),
+jobGeneration(0), activeWorkers(0), nextIndex(0) {
+    if (numThreads <= 0) {
+        numThreads = (int) std::thread::hardware_concurrency();
+    }
+    if (numThreads <= 0) {
+        numThreads = 1;
+    }
+    for (int t = 1; t < numThreads; t++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
+    wakeWorkers.notify_all();
+    for (unsigned int t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+}
+
+void ThreadPool::runItems() {
+    int index;
+    while ((index = nextIndex.fetch_add(1)) < jobEnd) {
+        (*job)(index);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    insidePool = true;
+    unsigned int seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wakeWorkers.wait(lock, [&] {
+            return shutdown || jobGeneration != seenGeneration; });
+        if (shutdown) {
+            return;
+        }
+        seenGeneration = jobGeneration;
+        activeWorkers++;
+        lock.unlock();
+        runItems();
+        lock.lock();
+        if (--activeWorkers == 0) {
+            jobDone.notify_all();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int)>& fn) {
+    if (end <= begin) {
+        return;
+    }
+    if (insidePool || workers.size() == 0 || end - begin == 1) {
+        for (int index = begin; index < end; index++) {
+            fn(index);
+        }
+        return;
+    }
+    // one job at a time, concurrent callers from outside the pool queue up here
+    static std::mutex submitMutex;
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // a worker that woke up after the previous job finished may still be leaving it
+        jobDone.wait(lock, [&] {
+            return activeWorkers == 0; });
+        job = &fn;
+        jobEnd = end;
+        nextIndex.store(begin);
+        jobGeneration++;
+    }
+    wakeWorkers.notify_all();
+    // items run here may nest parallelFor() calls, which must not submit again
+    insidePool = true;
+    runItems();
+    insidePool = false;
+    // workers that woke up late find no items left and leave immediately
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [&] {
+        return activeWorkers == 0; });
+    job = nullptr;
+}
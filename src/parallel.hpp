@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   parallel.hpp
+ *
+ * Persistent worker pool shared by the CPU visibility stages. Work items are
+ * handed out dynamically from an atomic counter so unevenly expensive items
+ * (e.g., image tiles looking at dense geometry) balance across the cores.
+ * The calling thread participates in the work. A parallelFor() issued from
+ * inside an item, on a worker or on the calling thread, runs serially, so
+ * nested calls can not deadlock.
+ */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    // the process wide pool, created with numThreads() workers on first use
+    static ThreadPool& instance();
+
+    // 0 selects std::thread::hardware_concurrency(), takes effect before
+    // the first call to instance()
+    static void setNumThreads(int numThreads);
+
+    int numThreads() const {
+        return (int) workers.size() + 1;
+    }
+
+    // calls fn(index) for every index in [begin, end) and returns when all calls completed
+    void parallelFor(int begin, int end, const std::function<void(int)>& fn);
+
+    ~ThreadPool();
+
+private:
+    ThreadPool(int numThreads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void workerLoop();
+    void runItems();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeWorkers, jobDone;
+    bool shutdown;
+
+    // the job currently being processed
+    const std::function<void(int)> *job;
+    int jobEnd;
+    unsigned int jobGeneration;
+    int activeWorkers;
+    std::atomic<int> nextIndex;
+};
+
+inline void parallel_for(int begin, int end, const std::function<void(int)>& fn) {
+    ThreadPool::instance().parallelFor(begin, end, fn);
+}
+
+#endif /* PARALLEL_HPP */
+
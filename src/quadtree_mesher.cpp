@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quadtree_mesher.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+
+constexpr float QuadtreeMesher::DISCONTINUITY_RATIO;
+
+QuadtreeMesher::QuadtreeMesher(float _tolerance) : tolerance(_tolerance) {
+}
+
+void QuadtreeMesher::mesh(const float * const *depth_images, const glm::vec3 *points, int numViews,
+        int width, int height, std::vector<glm::u32vec3>& triangles) const {
+    std::vector<std::vector<glm::u32vec3> > faceTriangles(numViews);
+    parallel_for(0, numViews, [&](int k) {
+        meshFace(depth_images[k], points + k * width * height, width, height,
+                k * width * height, faceTriangles[k]);
+    });
+    for (int k = 0; k < numViews; k++) {
+        triangles.insert(triangles.end(), faceTriangles[k].begin(), faceTriangles[k].end());
+    }
+}
+
+// block corners (i0, j0), (i0, j1), (i1, j0), (i1, j1) are split along the
+// (i0, j1) - (i1, j0) diagonal like the full resolution mesh
+
+bool QuadtreeMesher::isFlat(const glm::vec3 *points, int width, int i0, int j0, int size) const {
+    int i1 = i0 + size, j1 = j0 + size;
+    const glm::vec3& A = points[i0 * width + j0];
+    const glm::vec3& B = points[i0 * width + j1];
+    const glm::vec3& C = points[i1 * width + j0];
+    const glm::vec3& D = points[i1 * width + j1];
+    glm::vec3 n0 = glm::cross(B - A, C - A);
+    glm::vec3 n1 = glm::cross(C - D, B - D);
+    float len0 = glm::dot(n0, n0), len1 = glm::dot(n1, n1);
+    if (len0 == 0.0f || len1 == 0.0f) {
+        return false;
+    }
+    // |dot(p - a, n)| <= tolerance * |n| without the square roots
+    float tol0 = tolerance * tolerance * len0, tol1 = tolerance * tolerance * len1;
+    for (int i = i0; i <= i1; i++) {
+        const glm::vec3 *row = points + i * width;
+        for (int j = j0; j <= j1; j++) {
+            bool first = (i - i0) + (j - j0) <= size;
+            float d = first ? glm::dot(row[j] - A, n0) : glm::dot(row[j] - D, n1);
+            if (d * d > (first ? tol0 : tol1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void QuadtreeMesher::meshFace(const float *depth, const glm::vec3 *points, int width, int height,
+        unsigned int offset, std::vector<glm::u32vec3>& triangles) const {
+    int cellsY = height - 1, cellsX = width - 1;
+    if (cellsY < 1 || cellsX < 1) {
+        return;
+    }
+    // depth range pyramid over the cells, level l holds blocks of 2^l x 2^l cells
+    std::vector<std::vector<float> > zmin(1), zmax(1);
+    std::vector<int> levelWidth(1, cellsX), levelHeight(1, cellsY);
+    zmin[0].resize(cellsX * cellsY);
+    zmax[0].resize(cellsX * cellsY);
+    for (int i = 0; i < cellsY; i++) {
+        for (int j = 0; j < cellsX; j++) {
+            float z00 = depth[i * width + j], z01 = depth[i * width + j + 1];
+            float z10 = depth[(i + 1) * width + j], z11 = depth[(i + 1) * width + j + 1];
+            zmin[0][i * cellsX + j] = std::min(std::min(z00, z01), std::min(z10, z11));
+            zmax[0][i * cellsX + j] = std::max(std::max(z00, z01), std::max(z10, z11));
+        }
+    }
+    int rootSize = 1;
+    while (rootSize < std::max(cellsX, cellsY)) {
+        int l = (int) zmin.size();
+        int w = (levelWidth[l - 1] + 1) / 2, h = (levelHeight[l - 1] + 1) / 2;
+        zmin.push_back(std::vector<float>(w * h));
+        zmax.push_back(std::vector<float>(w * h));
+        levelWidth.push_back(w);
+        levelHeight.push_back(h);
+        for (int i = 0; i < h; i++) {
+            for (int j = 0; j < w; j++) {
+                float lo = zmin[l - 1][2 * i * levelWidth[l - 1] + 2 * j];
+                float hi = zmax[l - 1][2 * i * levelWidth[l - 1] + 2 * j];
+                for (int c = 1; c < 4; c++) {
+                    int ci = 2 * i + (c >> 1), cj = 2 * j + (c & 1);
+                    if (ci < levelHeight[l - 1] && cj < levelWidth[l - 1]) {
+                        lo = std::min(lo, zmin[l - 1][ci * levelWidth[l - 1] + cj]);
+                        hi = std::max(hi, zmax[l - 1][ci * levelWidth[l - 1] + cj]);
+                    }
+                }
+                zmin[l][i * w + j] = lo;
+                zmax[l][i * w + j] = hi;
+            }
+        }
+        rootSize *= 2;
+    }
+
+    // refine top down, blocks sticking out of the face are always split
+    std::vector<Block> leaves;
+    std::vector<Block> stack(1, Block{0, 0, rootSize});
+    while (!stack.empty()) {
+        Block b = stack.back();
+        stack.pop_back();
+        if (b.i >= cellsY || b.j >= cellsX) {
+            continue;
+        }
+        if (b.size > 1) {
+            bool split = b.i + b.size > cellsY || b.j + b.size > cellsX;
+            if (!split) {
+                int l = 0;
+                while ((1 << l) < b.size) {
+                    l++;
+                }
+                int idx = (b.i >> l) * levelWidth[l] + (b.j >> l);
+                split = zmax[l][idx] > DISCONTINUITY_RATIO * zmin[l][idx] ||
+                        !isFlat(points, width, b.i, b.j, b.size);
+            }
+            if (split) {
+                int h = b.size / 2;
+                stack.push_back(Block{b.i + h, b.j + h, h});
+                stack.push_back(Block{b.i + h, b.j, h});
+                stack.push_back(Block{b.i, b.j + h, h});
+                stack.push_back(Block{b.i, b.j, h});
+                continue;
+            }
+        }
+        leaves.push_back(b);
+    }
+
+    // vertices other leaves and the seams connect to
+    std::vector<unsigned char> used(width * height, 0);
+    for (int j = 0; j < width; j++) {
+        used[j] = used[(height - 1) * width + j] = 1;
+    }
+    for (int i = 0; i < height; i++) {
+        used[i * width] = used[i * width + width - 1] = 1;
+    }
+    for (const Block& b : leaves) {
+        used[b.i * width + b.j] = used[b.i * width + b.j + b.size] = 1;
+        used[(b.i + b.size) * width + b.j] = used[(b.i + b.size) * width + b.j + b.size] = 1;
+    }
+
+    std::vector<unsigned int> ring;
+    for (const Block& b : leaves) {
+        int i0 = b.i, j0 = b.j, i1 = b.i + b.size, j1 = b.j + b.size;
+        // boundary clockwise in (j, i): up the j0 column, along the i1 row,
+        // down the j1 column and back along the i0 row
+        ring.clear();
+        for (int i = i0; i < i1; i++) {
+            if (used[i * width + j0]) {
+                ring.push_back(i * width + j0);
+            }
+        }
+        for (int j = j0; j < j1; j++) {
+            if (used[i1 * width + j]) {
+                ring.push_back(i1 * width + j);
+            }
+        }
+        for (int i = i1; i > i0; i--) {
+            if (used[i * width + j1]) {
+                ring.push_back(i * width + j1);
+            }
+        }
+        for (int j = j1; j > j0; j--) {
+            if (used[i0 * width + j]) {
+                ring.push_back(i0 * width + j);
+            }
+        }
+        if (ring.size() == 4) {
+            unsigned int A = offset + i0 * width + j0, B = offset + i0 * width + j1;
+            unsigned int C = offset + i1 * width + j0, D = offset + i1 * width + j1;
+            triangles.push_back(glm::u32vec3(B, A, C));
+            triangles.push_back(glm::u32vec3(C, D, B));
+        } else {
+            unsigned int center = offset + (i0 + b.size / 2) * width + j0 + b.size / 2;
+            for (size_t n = 0; n < ring.size(); n++) {
+                size_t next = (n + 1 == ring.size()) ? 0 : n + 1;
+                triangles.push_back(glm::u32vec3(center, offset + ring[n], offset + ring[next]));
+            }
+        }
+    }
+}
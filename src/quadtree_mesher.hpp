@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   quadtree_mesher.hpp
+ *
+ * Adaptive triangulation of the cube faces of a visibility volume. Each face
+ * is covered by a quadtree of square blocks of pixel cells that is refined
+ * only where the surface is discontinuous or curved:
+ *
+ *  - a min/max pyramid of the face depth rejects blocks whose depth range
+ *    exceeds DISCONTINUITY_RATIO (silhouettes, background next to geometry)
+ *    without looking at their pixels,
+ *  - the remaining blocks are kept when every pixel lies within tolerance of
+ *    the plane of the block corner triangle it falls in.
+ *
+ * Leaf corners, and all pixels on the face border so the seams between faces
+ * can be stitched at full resolution, are marked as used. A leaf whose edges
+ * hold no used vertex besides its corners becomes two triangles split like
+ * the full resolution mesh, other leaves become a fan around their center
+ * through every used vertex on their boundary, so the output has neither
+ * cracks nor T-junctions.
+ */
+
+#ifndef QUADTREE_MESHER_HPP
+#define QUADTREE_MESHER_HPP
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class QuadtreeMesher {
+public:
+    // blocks whose largest depth exceeds this multiple of the smallest are split
+    static constexpr float DISCONTINUITY_RATIO = 2.0f;
+
+    // tolerance is the largest distance in world units of a pixel from the mesh
+    QuadtreeMesher(float tolerance);
+
+    // triangles of all faces, 0 based indices into points laid out as
+    // points[(k * height + i) * width + j], wound like the full resolution cube mesh
+    void mesh(const float * const *depth_images, const glm::vec3 *points, int numViews,
+            int width, int height, std::vector<glm::u32vec3>& triangles) const;
+
+private:
+    struct Block {
+        int i, j, size;
+    };
+
+    void meshFace(const float *depth, const glm::vec3 *points, int width, int height,
+            unsigned int offset, std::vector<glm::u32vec3>& triangles) const;
+
+    bool isFlat(const glm::vec3 *points, int width, int i0, int j0, int size) const;
+
+    float tolerance;
+};
+
+#endif /* QUADTREE_MESHER_HPP */
+
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "range_cube_map.hpp"
+#include "parallel.hpp"
+#include "simd4.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+void RangeCubeMap::setup(const VolumeUnprojector& unprojector, const float * const *depth_images, bool quantize) {
+    numViews = unprojector.numViews;
+    width = unprojector.width;
+    height = unprojector.height;
+    axisX.resize(numViews);
+    axisY.resize(numViews);
+    axisZ.resize(numViews);
+    for (int k = 0; k < numViews; k++) {
+        axisX[k] = unprojector.rotations[k][0];
+        axisY[k] = unprojector.rotations[k][1];
+        axisZ[k] = unprojector.rotations[k][2];
+    }
+    scaleX = unprojector.focal / unprojector.aspect;
+    scaleY = unprojector.focal;
+    // background and far surfaces are bounded at depth_min as in VolumeUnprojector
+    int facePixels = width * height;
+    depth32.clear();
+    depth16.clear();
+    if (quantize) {
+        depth16.resize(numViews * facePixels);
+    } else {
+        depth32.resize(numViews * facePixels);
+    }
+    for (int k = 0; k < numViews; k++) {
+        for (int n = 0; n < facePixels; n++) {
+            float depth = std::max(depth_images[k][n], unprojector.depth_min);
+            if (quantize) {
+                depth16[k * facePixels + n] = encodeDepth(depth);
+            } else {
+                depth32[k * facePixels + n] = depth;
+            }
+        }
+    }
+    origin = unprojector.origin;
+    zNear = unprojector.zNear;
+    wcs_basis = unprojector.wcs_basis;
+    wcs_offset = unprojector.wcs_offset;
+    radius_max = unprojector.radius_max;
+    wcs_origin = unprojector.wcs_origin;
+    wcs_up = unprojector.wcs_up;
+    up_min = unprojector.up_min;
+    up_max = unprojector.up_max;
+}
+
+uint16_t RangeCubeMap::encodeDepth(float depth) {
+    // exponents 2^-31 .. 2^0 and the 11 leading mantissa bits, rounded to nearest
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof (bits));
+    bits += 1u << 11;
+    int exponent = (int) (bits >> 23) - 96;
+    if (exponent < 0) {
+        return 0;
+    }
+    if (exponent > 31) {
+        return 0xFFFF;
+    }
+    return (uint16_t) ((exponent << 11) | ((bits >> 12) & 0x7FF));
+}
+
+float RangeCubeMap::decodeDepth(uint16_t code) {
+    uint32_t bits = ((uint32_t) ((code >> 11) + 96) << 23) | ((uint32_t) (code & 0x7FF) << 12);
+    float depth;
+    std::memcpy(&depth, &bits, sizeof (depth));
+    return depth;
+}
+
+bool RangeCubeMap::contains(const glm::vec3& p) const {
+    uint8_t visible;
+    classifyRange(&p, 0, 1, &visible);
+    return visible != 0;
+}
+
+void RangeCubeMap::classify(const glm::vec3 *points, size_t count, uint8_t *visible) const {
+    int numTasks = (int) ((count + POINTS_PER_TASK - 1) / POINTS_PER_TASK);
+    parallel_for(0, numTasks, [&](int task) {
+        size_t begin = (size_t) task * POINTS_PER_TASK;
+        classifyRange(points, begin, std::min(begin + POINTS_PER_TASK, count), visible);
+    });
+}
+
+void RangeCubeMap::classifyRange(const glm::vec3 *points, size_t begin, size_t end, uint8_t *visible) const {
+    const vfloat4 ox(origin.x), oy(origin.y), oz(origin.z);
+    const glm::mat3& B = wcs_basis;
+    const vfloat4 cx(wcs_offset.x), cy(wcs_offset.y), cz(wcs_offset.z);
+    const vfloat4 radius2((float) std::min((double) radius_max * radius_max,
+            (double) std::numeric_limits<float>::max()));
+    const vfloat4 hx(wcs_origin.x), hy(wcs_origin.y), hz(wcs_origin.z);
+    const vfloat4 upMin(up_min), upMax(up_max);
+    const vfloat4 halfWidth(0.5f * width), halfHeight(0.5f * height);
+    const vfloat4 lastColumn((float) (width - 1)), lastRow((float) (height - 1));
+    for (size_t n = begin; n < end; n += 4) {
+        int count = (int) std::min((size_t) 4, end - n);
+        // unused lanes sit at the origin
+        float px[4] = {origin.x, origin.x, origin.x, origin.x};
+        float py[4] = {origin.y, origin.y, origin.y, origin.y};
+        float pz[4] = {origin.z, origin.z, origin.z, origin.z};
+        for (int l = 0; l < count; l++) {
+            px[l] = points[n + l].x;
+            py[l] = points[n + l].y;
+            pz[l] = points[n + l].z;
+        }
+        vfloat4 x = vfloat4::load(px), y = vfloat4::load(py), z = vfloat4::load(pz);
+        vfloat4 dx = x - ox, dy = y - oy, dz = z - oz;
+        // the face with the largest eye depth, the first one on ties as in VolumeUnprojector::locate()
+        vfloat4 eyeDepth(-std::numeric_limits<float>::max()), eyeX(0.0f), eyeY(0.0f), face(0.0f);
+        for (int k = 0; k < numViews; k++) {
+            vfloat4 depth = -(dx * axisZ[k].x + dy * axisZ[k].y + dz * axisZ[k].z);
+            vbool4 nearer = depth > eyeDepth;
+            eyeDepth = select(nearer, depth, eyeDepth);
+            eyeX = select(nearer, dx * axisX[k].x + dy * axisX[k].y + dz * axisX[k].z, eyeX);
+            eyeY = select(nearer, dx * axisY[k].x + dy * axisY[k].y + dz * axisY[k].z, eyeY);
+            face = select(nearer, vfloat4((float) k), face);
+        }
+        vfloat4 scale = vfloat4(1.0f) / vmax(eyeDepth, vfloat4(std::numeric_limits<float>::min()));
+        vfloat4 column = vclamp((eyeX * scale * vfloat4(scaleX) + vfloat4(1.0f)) * halfWidth, vfloat4(0.0f), lastColumn);
+        vfloat4 row = vclamp((eyeY * scale * vfloat4(scaleY) + vfloat4(1.0f)) * halfHeight, vfloat4(0.0f), lastRow);
+        float columns[4], rows[4], faces[4], depth[4];
+        column.store(columns);
+        row.store(rows);
+        face.store(faces);
+        for (int l = 0; l < 4; l++) {
+            depth[l] = depthAt(((int) faces[l] * height + (int) rows[l]) * width + (int) columns[l]);
+        }
+        vbool4 inside = eyeDepth * vfloat4::load(depth) <= vfloat4(zNear);
+        // radius and height limits
+        vfloat4 rx = cx + dx * B[0][0] + dy * B[1][0] + dz * B[2][0];
+        vfloat4 ry = cy + dx * B[0][1] + dy * B[1][1] + dz * B[2][1];
+        vfloat4 rz = cz + dx * B[0][2] + dy * B[1][2] + dz * B[2][2];
+        inside = inside & (rx * rx + ry * ry + rz * rz <= radius2);
+        vfloat4 h = (x - hx) * wcs_up.x + (y - hy) * wcs_up.y + (z - hz) * wcs_up.z;
+        inside = inside & (h >= upMin) & (h <= upMax);
+        int mask = inside.mask();
+        for (int l = 0; l < count; l++) {
+            visible[n + l] = (uint8_t) ((mask >> l) & 1);
+        }
+    }
+}
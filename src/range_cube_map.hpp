@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   range_cube_map.hpp
+ *
+ * Point in visibility volume queries without a mesh. A visibility volume is
+ * star-shaped about its origin, so a point lies inside it when its eye depth
+ * in the cube face that sees it is no larger than that of the surface seen
+ * through the same pixel, and it is within the radius and height limits. The
+ * test is one lookup of the nearest pixel:
+ *
+ *     -dot(R_k[2], p - origin) * depth[k][pixel] <= zNear
+ *
+ * The map keeps its own copy of the six depth images, either as floats or
+ * quantized to 16 bits: a 5 bit exponent covering depths 2^-31 .. 1 and the
+ * 11 leading mantissa bits, which bounds the relative range error at 2^-12
+ * and halves the memory. Batches of points are classified 4 at a time with
+ * the SIMD vector of simd4.hpp, and blocks of POINTS_PER_TASK points run in
+ * parallel.
+ */
+
+#ifndef RANGE_CUBE_MAP_HPP
+#define RANGE_CUBE_MAP_HPP
+
+#include "volume_unprojector.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class RangeCubeMap {
+public:
+    // points classified by one task
+    static const int POINTS_PER_TASK = 4096;
+
+    // copies the depth images and the limits of a volume, quantized to 16
+    // bits per pixel when quantize is set
+    void setup(const VolumeUnprojector& unprojector, const float * const *depth_images, bool quantize = false);
+
+    bool contains(const glm::vec3& p) const;
+
+    // visible[n] = 1 when points[n] lies inside the volume, 0 otherwise
+    void classify(const glm::vec3 *points, size_t count, uint8_t *visible) const;
+
+    bool quantized() const {
+        return !depth16.empty();
+    }
+
+    // memory held by the depth images
+    size_t imageBytes() const {
+        return depth32.size() * sizeof (float) + depth16.size() * sizeof (uint16_t);
+    }
+
+    static uint16_t encodeDepth(float depth);
+
+    static float decodeDepth(uint16_t code);
+
+private:
+    // points [begin, end), the depth image lookups of one block
+    void classifyRange(const glm::vec3 *points, size_t begin, size_t end, uint8_t *visible) const;
+
+    float depthAt(int index) const {
+        return depth16.empty() ? depth32[index] : decodeDepth(depth16[index]);
+    }
+
+    int numViews, width, height;
+    // columns of the camera to world rotation of every face
+    std::vector<glm::vec3> axisX, axisY, axisZ;
+    float scaleX, scaleY;
+    std::vector<float> depth32;
+    std::vector<uint16_t> depth16;
+
+    glm::vec3 origin;
+    float zNear;
+    glm::mat3 wcs_basis;
+    glm::vec3 wcs_offset;
+    float radius_max;
+    glm::vec3 wcs_origin, wcs_up;
+    float up_min, up_max;
+};
+
+#endif /* RANGE_CUBE_MAP_HPP */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "raycast_renderer.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+RaycastRenderer::RaycastRenderer(const SceneGeometry& scene) {
+    bvh.build(scene);
+}
+
+void RaycastRenderer::renderDepth(const glm::mat4 *views, int numViews, float fovY_radians,
+        float aspectWbyH, float zNear, int width, int height, float **depth_images) {
+    float f = 1.0f / std::tan(fovY_radians / 2.0f);
+    // camera to world rotation and camera position of every face
+    std::vector<glm::mat3> rotations(numViews);
+    std::vector<glm::vec3> eyes(numViews);
+    for (int k = 0; k < numViews; k++) {
+        glm::mat4 view_inv = glm::inverse(views[k]);
+        rotations[k] = glm::mat3(view_inv);
+        eyes[k] = glm::vec3(view_inv[3]);
+    }
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesPerView = tilesX * tilesY;
+    const float tfar = std::numeric_limits<float>::max();
+
+    parallel_for(0, numViews * tilesPerView, [&](int task) {
+        int k = task / tilesPerView;
+        int tile = task % tilesPerView;
+        int j0 = (tile % tilesX) * TILE_SIZE;
+        int i0 = (tile / tilesX) * TILE_SIZE;
+        int j1 = std::min(j0 + TILE_SIZE, width);
+        int i1 = std::min(i0 + TILE_SIZE, height);
+        const glm::mat3& R = rotations[k];
+        float *depth = depth_images[k];
+        RayPacket4 packet;
+        float hits[4];
+        for (int i = i0; i < i1; i += 2) {
+            for (int j = j0; j < j1; j += 2) {
+                // lanes: (i, j), (i, j + 1), (i + 1, j), (i + 1, j + 1)
+                for (int lane = 0; lane < 4; lane++) {
+                    int pi = i + (lane >> 1), pj = j + (lane & 1);
+                    if (pi >= i1 || pj >= j1) {
+                        packet.disableLane(lane);
+                        continue;
+                    }
+                    // pixel center through the inverse projection, eye space z = -1
+                    // so the hit distance along the ray is the eye space depth
+                    glm::vec3 dir_eye((2.0f * (pj + 0.5f) / width - 1.0f) * aspectWbyH / f,
+                            (2.0f * (pi + 0.5f) / height - 1.0f) / f, -1.0f);
+                    // the near plane clips everything closer than zNear
+                    packet.setRay(lane, eyes[k], R * dir_eye, zNear, tfar);
+                }
+                packet.finalize();
+                vbool4 hit = bvh.intersect(packet);
+                packet.tmax.store(hits);
+                for (int lane = 0; lane < 4; lane++) {
+                    int pi = i + (lane >> 1), pj = j + (lane & 1);
+                    if (pi < i1 && pj < j1) {
+                        depth[pi * width + pj] = hit[lane] ? zNear / hits[lane] : 0.0f;
+                    }
+                }
+            }
+        }
+    });
+}
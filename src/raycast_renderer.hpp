@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   raycast_renderer.hpp
+ *
+ * CPU ray casting backend. One ray is cast through every pixel center of
+ * every face; rays of 2x2 pixel quads are traced together as a SIMD packet
+ * through the scene BVH. Work is split over the thread pool in square tiles
+ * of every face so all cores stay busy even when one face sees most of the
+ * geometry.
+ */
+
+#ifndef RAYCAST_RENDERER_HPP
+#define RAYCAST_RENDERER_HPP
+
+#include "bvh.hpp"
+#include "cpu_depth_renderer.hpp"
+#include "scene_geometry.hpp"
+
+class RaycastRenderer : public CpuDepthRenderer {
+public:
+    static const int TILE_SIZE = 32;
+
+    // builds the BVH, the scene geometry is not referenced afterwards
+    RaycastRenderer(const SceneGeometry& scene);
+
+    void renderDepth(const glm::mat4 *views, int numViews, float fovY_radians,
+            float aspectWbyH, float zNear, int width, int height, float **depth_images);
+
+    const BVH& getBVH() const {
+        return bvh;
+    }
+
+private:
+    BVH bvh;
+};
+
+#endif /* RAYCAST_RENDERER_HPP */
+
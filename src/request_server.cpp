@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "request_server.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// write all of text, false when the reader has gone away
+
+static bool writeAll(int fd, const std::string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t n = ::write(fd, text.data() + written, text.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+RequestServer::RequestServer() : listen_fd(-1), reply_fd(-1) {
+}
+
+RequestServer::~RequestServer() {
+    close();
+}
+
+bool RequestServer::openStdio() {
+    close();
+    // a client closing its end must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    std::cout.flush();
+    fflush(stdout);
+    reply_fd = dup(STDOUT_FILENO);
+    if (reply_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        std::cerr << "Could not redirect stdout for replies: " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    std::cerr << "Serving visibility volume requests on stdin." << std::endl;
+    return true;
+}
+
+bool RequestServer::openSocket(const std::string& path) {
+    close();
+    signal(SIGPIPE, SIG_IGN);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof (address.sun_path)) {
+        std::cout << "Invalid socket path \"" << path << "\"." << std::endl;
+        return false;
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof (address.sun_path) - 1);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        std::cout << "Could not create a socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+    unlink(path.c_str());
+    if (bind(listen_fd, (struct sockaddr *) &address, sizeof (address)) < 0 || listen(listen_fd, 16) < 0) {
+        std::cout << "Could not listen on " << path << ": " << strerror(errno) << std::endl;
+        close();
+        return false;
+    }
+    socket_path = path;
+    std::cout << "Serving visibility volume requests on " << path << "." << std::endl;
+    return true;
+}
+
+void RequestServer::close() {
+    if (listen_fd >= 0) {
+        ::close(listen_fd);
+        unlink(socket_path.c_str());
+        listen_fd = -1;
+        socket_path.clear();
+    }
+    if (reply_fd >= 0) {
+        // give stdout back to the replies
+        fflush(stdout);
+        dup2(reply_fd, STDOUT_FILENO);
+        ::close(reply_fd);
+        reply_fd = -1;
+    }
+}
+
+void RequestServer::serve(const Handler& handler) {
+    if (reply_fd >= 0) {
+        serveConnection(STDIN_FILENO, reply_fd, handler);
+        return;
+    }
+    while (listen_fd >= 0) {
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cout << "Could not accept a connection: " << strerror(errno) << std::endl;
+            return;
+        }
+        bool more = serveConnection(client_fd, client_fd, handler);
+        ::close(client_fd);
+        if (!more) {
+            return;
+        }
+    }
+}
+
+bool RequestServer::serveConnection(int in_fd, int out_fd, const Handler& handler) {
+    std::string pending;
+    char buffer[4096];
+    bool eof = false;
+    while (true) {
+        size_t eol = pending.find('\n');
+        if (eol == std::string::npos) {
+            if (eof) {
+                if (pending.empty()) {
+                    return true;
+                }
+                // last line without a newline
+                eol = pending.size();
+                pending += '\n';
+            } else {
+                ssize_t n = ::read(in_fd, buffer, sizeof (buffer));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    eof = true;
+                } else {
+                    pending.append(buffer, n);
+                }
+                continue;
+            }
+        }
+        std::string line = pending.substr(0, eol);
+        pending.erase(0, eol + 1);
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            continue;
+        }
+        line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+        if (line == "quit") {
+            return false;
+        }
+        if (!writeAll(out_fd, handler(line) + "\n")) {
+            // the client went away, its remaining requests have no one to answer to
+            return true;
+        }
+    }
+}
+
+std::string RequestServer::quoteJSON(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"':
+                quoted += "\\\"";
+                break;
+            case '\\':
+                quoted += "\\\\";
+                break;
+            case '\n':
+                quoted += "\\n";
+                break;
+            case '\r':
+                quoted += "\\r";
+                break;
+            case '\t':
+                quoted += "\\t";
+                break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof (escape), "\\u%04x", (unsigned char) c);
+                    quoted += escape;
+                } else {
+                    quoted += c;
+                }
+        }
+    }
+    return quoted + "\"";
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   request_server.hpp
+ *
+ * Line based request loop of the persistent visibility server. Requests are
+ * read one line at a time, from stdin or from the clients of a local Unix
+ * domain socket, and every non-empty line is answered with exactly one reply
+ * line. Socket clients are served one after another on the thread that owns
+ * the OpenGL context, so a handler never runs concurrently with itself. The
+ * server only moves lines; what a request means is up to the handler. The
+ * line "quit" stops the server, as does the end of stdin.
+ *
+ * In stdin mode the replies are the only output on stdout: the original
+ * stdout is kept for them and everything else the process prints, including
+ * the diagnostics of the renderer, goes to stderr.
+ */
+
+#ifndef REQUEST_SERVER_HPP
+#define REQUEST_SERVER_HPP
+
+#include <functional>
+#include <string>
+
+class RequestServer {
+public:
+    // one request line in, one reply line out, both without the newline
+    typedef std::function<std::string(const std::string&)> Handler;
+
+    RequestServer();
+    ~RequestServer();
+
+    // requests on stdin, replies on stdout
+    bool openStdio();
+
+    // listen on a Unix domain socket, a stale socket file at path is replaced
+    bool openSocket(const std::string& path);
+
+    // answer requests until "quit", or the end of stdin
+    void serve(const Handler& handler);
+
+    void close();
+
+    // text as a double quoted JSON string
+    static std::string quoteJSON(const std::string& text);
+
+private:
+    // answer the lines of one client, false once "quit" was received
+    bool serveConnection(int in_fd, int out_fd, const Handler& handler);
+
+    int listen_fd, reply_fd;
+    std::string socket_path;
+};
+
+#endif /* REQUEST_SERVER_HPP */
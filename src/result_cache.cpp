@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "result_cache.hpp"
+#include "binary_io.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// read and copy buffer
+static const size_t COPY_BUFFER_SIZE = 1 << 20;
+
+static const uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001b3ULL;
+
+ContentHash::ContentHash() : tailSize(0) {
+    lanes[0] = FNV_OFFSET;
+    // the second lane starts from a different basis and sees the words rotated
+    lanes[1] = FNV_OFFSET ^ 0x9e3779b97f4a7c15ULL;
+}
+
+void ContentHash::mixWord(uint64_t word) {
+    // a multiply only carries bits upwards, the shifts fold them back down
+    lanes[0] = (lanes[0] ^ word) * FNV_PRIME;
+    lanes[0] ^= lanes[0] >> 29;
+    lanes[1] = (lanes[1] ^ ((word << 29) | (word >> 35))) * FNV_PRIME;
+    lanes[1] ^= lanes[1] >> 32;
+}
+
+// little endian word so the key does not depend on the host
+static uint64_t loadWordLE(const unsigned char *bytes) {
+    uint64_t word = 0;
+    for (int b = 7; b >= 0; b--) {
+        word = (word << 8) | bytes[b];
+    }
+    return word;
+}
+
+void ContentHash::update(const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    while (size > 0) {
+        size_t count = std::min(size, sizeof (tail) - tailSize);
+        memcpy(tail + tailSize, bytes, count);
+        tailSize += count;
+        bytes += count;
+        size -= count;
+        if (tailSize == sizeof (tail)) {
+            mixWord(loadWordLE(tail));
+            tailSize = 0;
+        }
+    }
+}
+
+bool ContentHash::updateFile(const std::string& path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<char> buffer(COPY_BUFFER_SIZE);
+    uint64_t total = 0;
+    size_t count;
+    while ((count = fread(&buffer[0], 1, buffer.size(), file)) > 0) {
+        update(&buffer[0], count);
+        total += count;
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    update(total);
+    return ok;
+}
+
+std::string ContentHash::hex() const {
+    // the pending bytes padded with zeros, then their count
+    ContentHash last(*this);
+    memset(last.tail + tailSize, 0, sizeof (tail) - tailSize);
+    last.mixWord(loadWordLE(last.tail));
+    last.mixWord(tailSize);
+    char digits[33];
+    snprintf(digits, sizeof (digits), "%016llx%016llx", (unsigned long long) last.lanes[0],
+            (unsigned long long) last.lanes[1]);
+    return digits;
+}
+
+// bytes copied, or -1 on error
+static long long copyFile(const std::string& from, const std::string& to) {
+    FILE *in = fopen(from.c_str(), "rb");
+    if (in == nullptr) {
+        return -1;
+    }
+    FILE *out = fopen(to.c_str(), "wb");
+    if (out == nullptr) {
+        fclose(in);
+        return -1;
+    }
+    std::vector<char> buffer(COPY_BUFFER_SIZE);
+    long long total = 0;
+    size_t count;
+    bool ok = true;
+    while (ok && (count = fread(&buffer[0], 1, buffer.size(), in)) > 0) {
+        ok = fwrite(&buffer[0], 1, count, out) == count;
+        total += count;
+    }
+    ok = ok && !ferror(in);
+    fclose(in);
+    ok = (fclose(out) == 0) && ok;
+    return ok ? total : -1;
+}
+
+ResultCache::ResultCache() : hits(0), misses(0), bytesRead(0), bytesWritten(0) {
+}
+
+ResultCache::~ResultCache() {
+    if (enabled()) {
+        std::cout << "Cache " << directory << ": " << hits << " hits, " << misses << " misses, "
+                << bytesRead << " bytes read, " << bytesWritten << " bytes written." << std::endl;
+    }
+}
+
+bool ResultCache::open(const std::string& path) {
+    if (mkdir(path.c_str(), 0777) != 0 && errno != EEXIST) {
+        std::cout << "Could not create the cache directory " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    directory = path;
+    return true;
+}
+
+std::string ResultCache::entryPath(const std::string& key) const {
+    return directory + "/" + key;
+}
+
+bool ResultCache::fetch(const std::string& key, const std::string& path) {
+    long long bytes = copyFile(entryPath(key), path);
+    if (bytes < 0) {
+        misses++;
+        return false;
+    }
+    hits++;
+    bytesRead += bytes;
+    return true;
+}
+
+bool ResultCache::store(const std::string& key, const std::string& path) {
+    std::string entry = entryPath(key);
+    std::string temporary = entry + ".tmp" + std::to_string((long long) getpid());
+    long long bytes = copyFile(path, temporary);
+    if (bytes < 0 || rename(temporary.c_str(), entry.c_str()) != 0) {
+        remove(temporary.c_str());
+        std::cout << "Could not store " << path << " in the cache." << std::endl;
+        return false;
+    }
+    bytesWritten += bytes;
+    return true;
+}
+
+bool ResultCache::fetchBounds(const std::string& key, glm::vec3& lo, glm::vec3& hi) const {
+    FILE *file = fopen(entryPath(key).c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    float bounds[6];
+    bool ok = readWordsLE(file, bounds, 6);
+    fclose(file);
+    if (ok) {
+        lo = glm::vec3(bounds[0], bounds[1], bounds[2]);
+        hi = glm::vec3(bounds[3], bounds[4], bounds[5]);
+    }
+    return ok;
+}
+
+bool ResultCache::storeBounds(const std::string& key, const glm::vec3& lo, const glm::vec3& hi) const {
+    std::string entry = entryPath(key);
+    std::string temporary = entry + ".tmp" + std::to_string((long long) getpid());
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    float bounds[6] = {lo.x, lo.y, lo.z, hi.x, hi.y, hi.z};
+    bool ok = writeWordsLE(file, bounds, 6);
+    ok = (fclose(file) == 0) && ok && rename(temporary.c_str(), entry.c_str()) == 0;
+    if (!ok) {
+        remove(temporary.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   result_cache.hpp
+ *
+ * Content addressed on-disk cache of visibility volume outputs. The key of a
+ * result is a hash of everything it depends on: the bytes of the scene mesh
+ * files, their transforms, and the parameters of the volume. A rerun with
+ * unchanged inputs therefore finds its files in the cache and copies them
+ * to the output paths, with no rendering context and no model loading.
+ * Entries are written under a temporary name and renamed into place, so
+ * concurrent runs sharing a directory never see partial files.
+ *
+ * The cache also keeps the world bounds of every mesh it has seen, keyed by
+ * the hash of the mesh file and transform, so that the dependencies of a
+ * volume on the meshes near it are found without loading unchanged meshes.
+ */
+
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 128 bit hash of a byte stream, two FNV-1a style lanes over 8 byte words
+class ContentHash {
+public:
+    ContentHash();
+
+    void update(const void *data, size_t size);
+
+    void update(const std::string& text) {
+        update(&text[0], text.size());
+        update((uint64_t) text.size());
+    }
+
+    void update(uint64_t value) {
+        update(&value, sizeof (value));
+    }
+
+    void update(float value) {
+        update(&value, sizeof (value));
+    }
+
+    void update(const glm::vec3& v) {
+        update(&v[0], sizeof (v));
+    }
+
+    void update(const glm::mat4& m) {
+        update(&m[0][0], sizeof (m));
+    }
+
+    // the contents of a file followed by its size, false when it cannot be read
+    bool updateFile(const std::string& path);
+
+    // 32 hexadecimal digits
+    std::string hex() const;
+
+private:
+    uint64_t lanes[2];
+    // bytes of an incomplete word carried to the next update
+    unsigned char tail[8];
+    size_t tailSize;
+
+    void mixWord(uint64_t word);
+};
+
+class ResultCache {
+public:
+    ResultCache();
+
+    // prints the statistics of an enabled cache
+    ~ResultCache();
+
+    // cache files in directory, which is created when missing
+    bool open(const std::string& directory);
+
+    bool enabled() const {
+        return !directory.empty();
+    }
+
+    // copies the entry of key to path, false on a miss
+    bool fetch(const std::string& key, const std::string& path);
+
+    // stores a copy of the file at path as the entry of key
+    bool store(const std::string& key, const std::string& path);
+
+    // world bounds stored for key, e.g. of a scene mesh, false on a miss
+    bool fetchBounds(const std::string& key, glm::vec3& lo, glm::vec3& hi) const;
+
+    bool storeBounds(const std::string& key, const glm::vec3& lo, const glm::vec3& hi) const;
+
+    size_t hits, misses;
+    uint64_t bytesRead, bytesWritten;
+
+private:
+    std::string entryPath(const std::string& key) const;
+
+    std::string directory;
+};
+
+#endif /* RESULT_CACHE_HPP */
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scene_geometry.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <iostream>
+
+// visits the node hierarchy like Model::processNode(), node transforms are
+// ignored there as well so both backends see identical geometry
+
+static void appendNode(SceneGeometry& geometry, const aiNode *node, const aiScene *scene, const glm::mat4& xform) {
+    for (unsigned int m = 0; m < node->mNumMeshes; m++) {
+        const aiMesh *mesh = scene->mMeshes[node->mMeshes[m]];
+        unsigned int base = (unsigned int) geometry.vertices.size();
+        for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
+            glm::vec3 p(mesh->mVertices[v].x, mesh->mVertices[v].y, mesh->mVertices[v].z);
+            geometry.vertices.push_back(SceneGeometry::transformPoint(xform, p));
+        }
+        for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+            const aiFace& face = mesh->mFaces[f];
+            // points and lines do not occlude
+            if (face.mNumIndices != 3) {
+                continue;
+            }
+            geometry.triangles.push_back(glm::u32vec3(base + face.mIndices[0],
+                    base + face.mIndices[1], base + face.mIndices[2]));
+        }
+    }
+    for (unsigned int c = 0; c < node->mNumChildren; c++) {
+        appendNode(geometry, node->mChildren[c], scene, xform);
+    }
+}
+
+bool SceneGeometry::loadModel(const std::string& path, const glm::mat4& xform) {
+    Assimp::Importer importer;
+    // only positions are needed, skip the normal/tangent/uv processing of Model
+    const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    appendNode(*this, scene->mRootNode, scene, xform);
+    return true;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   scene_geometry.hpp
+ *
+ * World space triangle soup of the meshes listed in a YAML configuration.
+ * This is the scene representation of the CPU backends; it is filled either
+ * straight from the mesh files (no OpenGL context needed) or from Models that
+ * were already loaded for the OpenGL path.
+ */
+
+#ifndef SCENE_GEOMETRY_HPP
+#define SCENE_GEOMETRY_HPP
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+class SceneGeometry {
+public:
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::u32vec3> triangles;
+
+    // load all meshes of a model file with Assimp, positions are mapped to
+    // world coordinates by xform the same way the vertex shader applies "model"
+    bool loadModel(const std::string& path, const glm::mat4& xform = glm::mat4(1.0f));
+
+    // append the meshes of an already loaded learnopengl Model
+    template <typename ModelType>
+    void addModel(const ModelType& model, const glm::mat4& xform) {
+        for (unsigned int m = 0; m < model.meshes.size(); m++) {
+            unsigned int base = (unsigned int) vertices.size();
+            // position() reads the packed stream of depth-only meshes as well
+            for (unsigned int v = 0; v < model.meshes[m].numVertices(); v++) {
+                vertices.push_back(transformPoint(xform, model.meshes[m].position(v)));
+            }
+            const std::vector<unsigned int>& indices = model.meshes[m].indices;
+            for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+                triangles.push_back(glm::u32vec3(base + indices[i], base + indices[i + 1], base + indices[i + 2]));
+            }
+        }
+    }
+
+    void addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+        unsigned int base = (unsigned int) vertices.size();
+        vertices.push_back(a);
+        vertices.push_back(b);
+        vertices.push_back(c);
+        triangles.push_back(glm::u32vec3(base, base + 1, base + 2));
+    }
+
+    void clear() {
+        vertices.clear();
+        triangles.clear();
+    }
+
+    unsigned int numTriangles() const {
+        return (unsigned int) triangles.size();
+    }
+
+    bool empty() const {
+        return triangles.empty();
+    }
+
+    // homogeneous transform with perspective divide, matches gl_Position = M * vec4(p, 1)
+    static glm::vec3 transformPoint(const glm::mat4& xform, const glm::vec3& p) {
+        glm::vec4 q = xform * glm::vec4(p, 1.0f);
+        return glm::vec3(q) / q.w;
+    }
+
+    // world bounds of the box [lo, hi] placed by xform. The YAML transforms
+    // keep the position in row 3, the w row, so every corner gets its own
+    // divide by w and the box is not just moved; the bounds of the corners
+    // hold the whole image as long as w keeps its sign over the box.
+    static void transformBox(const glm::mat4& xform, const glm::vec3& lo, const glm::vec3& hi,
+            glm::vec3& worldLo, glm::vec3& worldHi) {
+        worldLo = worldHi = transformPoint(xform, lo);
+        for (int c = 1; c < 8; c++) {
+            glm::vec3 corner((c & 1) ? hi.x : lo.x, (c & 2) ? hi.y : lo.y, (c & 4) ? hi.z : lo.z);
+            glm::vec3 p = transformPoint(xform, corner);
+            worldLo = glm::min(worldLo, p);
+            worldHi = glm::max(worldHi, p);
+        }
+    }
+};
+
+#endif /* SCENE_GEOMETRY_HPP */
+
@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   simd4.hpp
+ *
+ * Minimal 4-wide float vector used by the CPU visibility kernels. Maps onto
+ * SSE when available and falls back to plain arrays otherwise.
+ */
+
+#ifndef SIMD4_HPP
+#define SIMD4_HPP
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD4_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef SIMD4_SSE
+
+struct vbool4 {
+    __m128 m;
+
+    vbool4() {
+    }
+
+    explicit vbool4(__m128 _m) : m(_m) {
+    }
+
+    int mask() const {
+        return _mm_movemask_ps(m);
+    }
+
+    bool any() const {
+        return mask() != 0;
+    }
+
+    bool all() const {
+        return mask() == 0xF;
+    }
+
+    bool operator[](int i) const {
+        return (mask() >> i) & 1;
+    }
+};
+
+inline vbool4 operator&(const vbool4& a, const vbool4& b) {
+    return vbool4(_mm_and_ps(a.m, b.m));
+}
+
+inline vbool4 operator|(const vbool4& a, const vbool4& b) {
+    return vbool4(_mm_or_ps(a.m, b.m));
+}
+
+inline vbool4 andnot(const vbool4& a, const vbool4& b) {
+    // a & ~b
+    return vbool4(_mm_andnot_ps(b.m, a.m));
+}
+
+struct vfloat4 {
+    __m128 m;
+
+    vfloat4() {
+    }
+
+    explicit vfloat4(__m128 _m) : m(_m) {
+    }
+
+    vfloat4(float f) : m(_mm_set1_ps(f)) {
+    }
+
+    vfloat4(float a, float b, float c, float d) : m(_mm_setr_ps(a, b, c, d)) {
+    }
+
+    static vfloat4 load(const float *p) {
+        return vfloat4(_mm_loadu_ps(p));
+    }
+
+    void store(float *p) const {
+        _mm_storeu_ps(p, m);
+    }
+
+    float operator[](int i) const {
+        float v[4];
+        store(v);
+        return v[i];
+    }
+};
+
+inline vfloat4 operator+(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(_mm_add_ps(a.m, b.m));
+}
+
+inline vfloat4 operator-(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(_mm_sub_ps(a.m, b.m));
+}
+
+inline vfloat4 operator*(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(_mm_mul_ps(a.m, b.m));
+}
+
+inline vfloat4 operator/(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(_mm_div_ps(a.m, b.m));
+}
+
+inline vfloat4 operator-(const vfloat4& a) {
+    return vfloat4(_mm_xor_ps(a.m, _mm_set1_ps(-0.0f)));
+}
+
+inline vfloat4 vmin(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(_mm_min_ps(a.m, b.m));
+}
+
+inline vfloat4 vmax(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(_mm_max_ps(a.m, b.m));
+}
+
+inline vfloat4 vabs(const vfloat4& a) {
+    return vfloat4(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.m));
+}
+
+inline vfloat4 vsqrt(const vfloat4& a) {
+    return vfloat4(_mm_sqrt_ps(a.m));
+}
+
+inline vbool4 operator<(const vfloat4& a, const vfloat4& b) {
+    return vbool4(_mm_cmplt_ps(a.m, b.m));
+}
+
+inline vbool4 operator<=(const vfloat4& a, const vfloat4& b) {
+    return vbool4(_mm_cmple_ps(a.m, b.m));
+}
+
+inline vbool4 operator>(const vfloat4& a, const vfloat4& b) {
+    return vbool4(_mm_cmpgt_ps(a.m, b.m));
+}
+
+inline vbool4 operator>=(const vfloat4& a, const vfloat4& b) {
+    return vbool4(_mm_cmpge_ps(a.m, b.m));
+}
+
+// per lane mask ? a : b
+
+inline vfloat4 select(const vbool4& mask, const vfloat4& a, const vfloat4& b) {
+    return vfloat4(_mm_or_ps(_mm_and_ps(mask.m, a.m), _mm_andnot_ps(mask.m, b.m)));
+}
+
+#else
+
+struct vbool4 {
+    bool b[4];
+
+    vbool4() {
+    }
+
+    vbool4(bool b0, bool b1, bool b2, bool b3) {
+        b[0] = b0;
+        b[1] = b1;
+        b[2] = b2;
+        b[3] = b3;
+    }
+
+    int mask() const {
+        return (b[0] ? 1 : 0) | (b[1] ? 2 : 0) | (b[2] ? 4 : 0) | (b[3] ? 8 : 0);
+    }
+
+    bool any() const {
+        return mask() != 0;
+    }
+
+    bool all() const {
+        return mask() == 0xF;
+    }
+
+    bool operator[](int i) const {
+        return b[i];
+    }
+};
+
+inline vbool4 operator&(const vbool4& a, const vbool4& b) {
+    return vbool4(a.b[0] && b.b[0], a.b[1] && b.b[1], a.b[2] && b.b[2], a.b[3] && b.b[3]);
+}
+
+inline vbool4 operator|(const vbool4& a, const vbool4& b) {
+    return vbool4(a.b[0] || b.b[0], a.b[1] || b.b[1], a.b[2] || b.b[2], a.b[3] || b.b[3]);
+}
+
+inline vbool4 andnot(const vbool4& a, const vbool4& b) {
+    return vbool4(a.b[0] && !b.b[0], a.b[1] && !b.b[1], a.b[2] && !b.b[2], a.b[3] && !b.b[3]);
+}
+
+struct vfloat4 {
+    float f[4];
+
+    vfloat4() {
+    }
+
+    vfloat4(float v) {
+        f[0] = f[1] = f[2] = f[3] = v;
+    }
+
+    vfloat4(float a, float b, float c, float d) {
+        f[0] = a;
+        f[1] = b;
+        f[2] = c;
+        f[3] = d;
+    }
+
+    static vfloat4 load(const float *p) {
+        return vfloat4(p[0], p[1], p[2], p[3]);
+    }
+
+    void store(float *p) const {
+        p[0] = f[0];
+        p[1] = f[1];
+        p[2] = f[2];
+        p[3] = f[3];
+    }
+
+    float operator[](int i) const {
+        return f[i];
+    }
+};
+
+#define SIMD4_BINARY_OP(OP) \
+inline vfloat4 operator OP(const vfloat4& a, const vfloat4& b) { \
+    return vfloat4(a.f[0] OP b.f[0], a.f[1] OP b.f[1], a.f[2] OP b.f[2], a.f[3] OP b.f[3]); \
+}
+SIMD4_BINARY_OP(+)
+SIMD4_BINARY_OP(-)
+SIMD4_BINARY_OP(*)
+SIMD4_BINARY_OP(/)
+#undef SIMD4_BINARY_OP
+
+#define SIMD4_COMPARE_OP(OP) \
+inline vbool4 operator OP(const vfloat4& a, const vfloat4& b) { \
+    return vbool4(a.f[0] OP b.f[0], a.f[1] OP b.f[1], a.f[2] OP b.f[2], a.f[3] OP b.f[3]); \
+}
+SIMD4_COMPARE_OP(<)
+SIMD4_COMPARE_OP(<=)
+SIMD4_COMPARE_OP(>)
+SIMD4_COMPARE_OP(>=)
+#undef SIMD4_COMPARE_OP
+
+inline vfloat4 operator-(const vfloat4& a) {
+    return vfloat4(-a.f[0], -a.f[1], -a.f[2], -a.f[3]);
+}
+
+inline vfloat4 vmin(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(std::min(a.f[0], b.f[0]), std::min(a.f[1], b.f[1]), std::min(a.f[2], b.f[2]), std::min(a.f[3], b.f[3]));
+}
+
+inline vfloat4 vmax(const vfloat4& a, const vfloat4& b) {
+    return vfloat4(std::max(a.f[0], b.f[0]), std::max(a.f[1], b.f[1]), std::max(a.f[2], b.f[2]), std::max(a.f[3], b.f[3]));
+}
+
+inline vfloat4 vabs(const vfloat4& a) {
+    return vfloat4(std::abs(a.f[0]), std::abs(a.f[1]), std::abs(a.f[2]), std::abs(a.f[3]));
+}
+
+inline vfloat4 vsqrt(const vfloat4& a) {
+    return vfloat4(std::sqrt(a.f[0]), std::sqrt(a.f[1]), std::sqrt(a.f[2]), std::sqrt(a.f[3]));
+}
+
+inline vfloat4 select(const vbool4& mask, const vfloat4& a, const vfloat4& b) {
+    return vfloat4(mask.b[0] ? a.f[0] : b.f[0], mask.b[1] ? a.f[1] : b.f[1],
+            mask.b[2] ? a.f[2] : b.f[2], mask.b[3] ? a.f[3] : b.f[3]);
+}
+
+#endif /* SIMD4_SSE */
+
+// helpers shared by both implementations
+
+inline vfloat4 vclamp(const vfloat4& a, const vfloat4& lo, const vfloat4& hi) {
+    return vmin(vmax(a, lo), hi);
+}
+
+inline float hmin(const vfloat4& a) {
+    return std::min(std::min(a[0], a[1]), std::min(a[2], a[3]));
+}
+
+inline float hmax(const vfloat4& a) {
+    return std::max(std::max(a[0], a[1]), std::max(a[2], a[3]));
+}
+
+#endif /* SIMD4_HPP */
+
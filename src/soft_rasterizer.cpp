@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "soft_rasterizer.hpp"
+#include "parallel.hpp"
+#include "simd4.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+    // clip space position. With the infinite reversed-Z projection clip z is
+    // the constant zNear, so only x, y and w are kept.
+
+    struct ClipVertex {
+        float x, y, w;
+    };
+
+    // screen space triangle ready for rasterization
+
+    struct ScreenTriangle {
+        // edge k is evaluated as sign * (dx * (py - y0) - dy * (px - x0)) from
+        // its lexicographically smaller end point (x0, y0)
+        float x0[3], y0[3], dx[3], dy[3], sign[3];
+        // a pixel center exactly on an owned edge is inside the triangle
+        bool owned[3];
+        // depth plane z = z0 + zx * (px - px0) + zy * (py - py0)
+        float px0, py0, z0, zx, zy;
+        // pixel bounds, inclusive and clamped to the image
+        int jmin, jmax, imin, imax;
+    };
+
+    // guard band in normalized device coordinates, triangles reaching beyond
+    // it are clipped so screen coordinates stay small enough for float edges
+    const float GUARD_BAND = 2.0f;
+    const int MAX_POLY = 9;
+
+    inline bool lessXY(float ax, float ay, float bx, float by) {
+        return ax < bx || (ax == bx && ay < by);
+    }
+
+    inline bool lessClip(const ClipVertex& a, const ClipVertex& b) {
+        if (a.x != b.x) return a.x < b.x;
+        if (a.y != b.y) return a.y < b.y;
+        return a.w < b.w;
+    }
+
+    // signed distance to clip plane p: 0 near, 1..4 guard band
+
+    inline float planeDistance(int p, const ClipVertex& v, float zNear) {
+        switch (p) {
+            case 0: return v.w - zNear;
+            case 1: return GUARD_BAND * v.w - v.x;
+            case 2: return GUARD_BAND * v.w + v.x;
+            case 3: return GUARD_BAND * v.w - v.y;
+            default: return GUARD_BAND * v.w + v.y;
+        }
+    }
+
+    // Sutherland-Hodgman against one plane. Intersections are computed from
+    // the canonically ordered end points so both triangles sharing an edge
+    // produce the same clipped vertex.
+
+    int clipPolygon(int p, const ClipVertex *in, int n, ClipVertex *out, float zNear) {
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            const ClipVertex& a = in[i];
+            const ClipVertex& b = in[(i + 1) % n];
+            float da = planeDistance(p, a, zNear);
+            float db = planeDistance(p, b, zNear);
+            if (da >= 0.0f) {
+                out[m++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                bool forward = lessClip(a, b);
+                const ClipVertex& s = forward ? a : b;
+                const ClipVertex& e = forward ? b : a;
+                float ds = forward ? da : db;
+                float de = forward ? db : da;
+                float t = ds / (ds - de);
+                ClipVertex c;
+                c.x = s.x + t * (e.x - s.x);
+                c.y = s.y + t * (e.y - s.y);
+                c.w = s.w + t * (e.w - s.w);
+                if (p == 0) {
+                    // exactly on the near plane
+                    c.w = zNear;
+                }
+                out[m++] = c;
+            }
+        }
+        return m;
+    }
+
+    struct ScreenVertex {
+        float x, y, z;
+    };
+
+    bool setupTriangle(const ScreenVertex& a, const ScreenVertex& b0, const ScreenVertex& c0,
+            int width, int height, ScreenTriangle& tri) {
+        float area = (b0.x - a.x) * (c0.y - a.y) - (c0.x - a.x) * (b0.y - a.y);
+        if (area == 0.0f || !(area == area)) {
+            return false;
+        }
+        // no face culling, make the winding counter clockwise
+        const ScreenVertex& b = (area > 0.0f) ? b0 : c0;
+        const ScreenVertex& c = (area > 0.0f) ? c0 : b0;
+        area = std::abs(area);
+        float minX = std::min(a.x, std::min(b.x, c.x));
+        float maxX = std::max(a.x, std::max(b.x, c.x));
+        float minY = std::min(a.y, std::min(b.y, c.y));
+        float maxY = std::max(a.y, std::max(b.y, c.y));
+        tri.jmin = std::max(0, (int) std::ceil(minX - 0.5f));
+        tri.jmax = std::min(width - 1, (int) std::floor(maxX - 0.5f));
+        tri.imin = std::max(0, (int) std::ceil(minY - 0.5f));
+        tri.imax = std::min(height - 1, (int) std::floor(maxY - 0.5f));
+        if (tri.jmin > tri.jmax || tri.imin > tri.imax) {
+            return false;
+        }
+        const ScreenVertex * v[3] = {&a, &b, &c};
+        for (int k = 0; k < 3; k++) {
+            const ScreenVertex& s = *v[k];
+            const ScreenVertex& e = *v[(k + 1) % 3];
+            bool forward = lessXY(s.x, s.y, e.x, e.y);
+            const ScreenVertex& p = forward ? s : e;
+            const ScreenVertex& q = forward ? e : s;
+            tri.x0[k] = p.x;
+            tri.y0[k] = p.y;
+            tri.dx[k] = q.x - p.x;
+            tri.dy[k] = q.y - p.y;
+            tri.sign[k] = forward ? 1.0f : -1.0f;
+            // oriented edge normal, the two triangles of a shared edge have opposite normals
+            float nx = -tri.sign[k] * tri.dy[k];
+            float ny = tri.sign[k] * tri.dx[k];
+            tri.owned[k] = nx > 0.0f || (nx == 0.0f && ny > 0.0f);
+        }
+        tri.px0 = a.x;
+        tri.py0 = a.y;
+        tri.z0 = a.z;
+        float dz1 = b.z - a.z, dz2 = c.z - a.z;
+        float dx1 = b.x - a.x, dx2 = c.x - a.x;
+        float dy1 = b.y - a.y, dy2 = c.y - a.y;
+        tri.zx = (dz1 * dy2 - dz2 * dy1) / area;
+        tri.zy = (dz2 * dx1 - dz1 * dx2) / area;
+        return true;
+    }
+
+    void rasterizeTriangle(const ScreenTriangle& tri, int i0, int j0, int i1, int j1, float *tileDepth) {
+        int imin = std::max(tri.imin, i0), imax = std::min(tri.imax, i1 - 1);
+        int jmin = std::max(tri.jmin, j0), jmax = std::min(tri.jmax, j1 - 1);
+        if (imin > imax || jmin > jmax) {
+            return;
+        }
+        // first 4 pixel group inside the tile buffer
+        jmin = j0 + ((jmin - j0) & ~3);
+        vfloat4 x0[3], y0[3], dx[3], dy[3], sign[3];
+        for (int k = 0; k < 3; k++) {
+            x0[k] = vfloat4(tri.x0[k]);
+            y0[k] = vfloat4(tri.y0[k]);
+            dx[k] = vfloat4(tri.dx[k]);
+            dy[k] = vfloat4(tri.dy[k]);
+            sign[k] = vfloat4(tri.sign[k]);
+        }
+        const vfloat4 zero(0.0f), one(1.0f);
+        const vfloat4 laneOffset(0.5f, 1.5f, 2.5f, 3.5f);
+        vfloat4 zx(tri.zx), zy(tri.zy), z0(tri.z0), px0(tri.px0), py0(tri.py0);
+        for (int i = imin; i <= imax; i++) {
+            vfloat4 py((float) i + 0.5f);
+            float *row = tileDepth + (i - i0) * SoftRasterizer::TILE_SIZE - j0;
+            for (int j = jmin; j <= jmax; j += 4) {
+                vfloat4 px = vfloat4((float) j) + laneOffset;
+                vbool4 inside = zero < one;
+                for (int k = 0; k < 3; k++) {
+                    vfloat4 e = sign[k] * (dx[k] * (py - y0[k]) - dy[k] * (px - x0[k]));
+                    inside = inside & (tri.owned[k] ? (e >= zero) : (e > zero));
+                }
+                if (!inside.any()) {
+                    continue;
+                }
+                vfloat4 z = vclamp(z0 + zx * (px - px0) + zy * (py - py0), zero, one);
+                vfloat4 zbuf = vfloat4::load(row + j);
+                vbool4 pass = inside & (z > zbuf);
+                select(pass, z, zbuf).store(row + j);
+            }
+        }
+    }
+}
+
+SoftRasterizer::SoftRasterizer(const SceneGeometry& _scene) : scene(_scene) {
+}
+
+void SoftRasterizer::renderDepth(const glm::mat4 *views, int numViews, float fovY_radians,
+        float aspectWbyH, float zNear, int width, int height, float **depth_images) {
+    float f = 1.0f / std::tan(fovY_radians / 2.0f);
+    unsigned int numVertices = (unsigned int) scene.vertices.size();
+    unsigned int numTriangles = scene.numTriangles();
+    int numChunks = (int) ((numTriangles + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesPerView = tilesX * tilesY;
+
+    // vertex stage: eye = view * p, clip = MakeInfReversedZProjRH * eye
+    std::vector<std::vector<ClipVertex> > clipVertices(numViews, std::vector<ClipVertex>(numVertices));
+    int vertexChunks = (int) ((numVertices + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    parallel_for(0, numViews * vertexChunks, [&](int task) {
+        int k = task / vertexChunks;
+        unsigned int begin = (task % vertexChunks) * CHUNK_SIZE;
+        unsigned int end = std::min(begin + CHUNK_SIZE, numVertices);
+        for (unsigned int v = begin; v < end; v++) {
+            glm::vec4 eye = views[k] * glm::vec4(scene.vertices[v], 1.0f);
+            ClipVertex& c = clipVertices[k][v];
+            c.x = f / aspectWbyH * eye.x;
+            c.y = f * eye.y;
+            c.w = -eye.z;
+        }
+    });
+
+    // setup and binning stage, one task per (face, triangle chunk)
+    std::vector<std::vector<ScreenTriangle> > chunkTriangles(numViews * numChunks);
+    std::vector<std::vector<std::vector<unsigned int> > > chunkBins(numViews * numChunks);
+    parallel_for(0, numViews * numChunks, [&](int task) {
+        int k = task / numChunks;
+        unsigned int begin = (task % numChunks) * CHUNK_SIZE;
+        unsigned int end = std::min(begin + CHUNK_SIZE, numTriangles);
+        const std::vector<ClipVertex>& clip = clipVertices[k];
+        std::vector<ScreenTriangle>& tris = chunkTriangles[task];
+        std::vector<std::vector<unsigned int> >& bins = chunkBins[task];
+        bins.resize(tilesPerView);
+        ClipVertex poly[2][MAX_POLY];
+        for (unsigned int t = begin; t < end; t++) {
+            const glm::u32vec3& face = scene.triangles[t];
+            poly[0][0] = clip[face.x];
+            poly[0][1] = clip[face.y];
+            poly[0][2] = clip[face.z];
+            int n = 3, cur = 0;
+            // trivial reject: all vertices beyond one frustum side plane
+            int outsideSide[4] = {0, 0, 0, 0};
+            for (int v = 0; v < 3; v++) {
+                const ClipVertex& c = poly[0][v];
+                outsideSide[0] += (c.x > c.w);
+                outsideSide[1] += (c.x < -c.w);
+                outsideSide[2] += (c.y > c.w);
+                outsideSide[3] += (c.y < -c.w);
+            }
+            if (outsideSide[0] == 3 || outsideSide[1] == 3 || outsideSide[2] == 3 || outsideSide[3] == 3) {
+                continue;
+            }
+            // clip only against the near and guard band planes that are crossed
+            bool rejected = false;
+            int crossed = 0;
+            for (int p = 0; p < 5 && !rejected; p++) {
+                int outside = 0;
+                for (int v = 0; v < 3; v++) {
+                    if (planeDistance(p, poly[0][v], zNear) < 0.0f) {
+                        outside++;
+                    }
+                }
+                rejected = (outside == 3);
+                if (outside > 0) {
+                    crossed |= 1 << p;
+                }
+            }
+            if (rejected) {
+                continue;
+            }
+            for (int p = 0; p < 5 && n >= 3; p++) {
+                if (crossed & (1 << p)) {
+                    n = clipPolygon(p, poly[cur], n, poly[1 - cur], zNear);
+                    cur = 1 - cur;
+                }
+            }
+            if (n < 3) {
+                continue;
+            }
+            // viewport transform, depth = zNear / w
+            ScreenVertex sv[MAX_POLY];
+            for (int v = 0; v < n; v++) {
+                const ClipVertex& c = poly[cur][v];
+                sv[v].x = (c.x / c.w * 0.5f + 0.5f) * width;
+                sv[v].y = (c.y / c.w * 0.5f + 0.5f) * height;
+                sv[v].z = zNear / c.w;
+            }
+            for (int v = 1; v + 1 < n; v++) {
+                ScreenTriangle tri;
+                if (!setupTriangle(sv[0], sv[v], sv[v + 1], width, height, tri)) {
+                    continue;
+                }
+                unsigned int index = (unsigned int) tris.size();
+                tris.push_back(tri);
+                for (int ty = tri.imin / TILE_SIZE; ty <= tri.imax / TILE_SIZE; ty++) {
+                    for (int tx = tri.jmin / TILE_SIZE; tx <= tri.jmax / TILE_SIZE; tx++) {
+                        bins[ty * tilesX + tx].push_back(index);
+                    }
+                }
+            }
+        }
+    });
+
+    // raster stage, one task per (face, tile). Chunks are visited in order so
+    // equal depth ties resolve the same way on every run.
+    parallel_for(0, numViews * tilesPerView, [&](int task) {
+        int k = task / tilesPerView;
+        int tile = task % tilesPerView;
+        int j0 = (tile % tilesX) * TILE_SIZE;
+        int i0 = (tile / tilesX) * TILE_SIZE;
+        int j1 = std::min(j0 + TILE_SIZE, width);
+        int i1 = std::min(i0 + TILE_SIZE, height);
+        float tileDepth[TILE_SIZE * TILE_SIZE];
+        std::fill(tileDepth, tileDepth + TILE_SIZE * TILE_SIZE, 0.0f);
+        for (int chunk = 0; chunk < numChunks; chunk++) {
+            const std::vector<ScreenTriangle>& tris = chunkTriangles[k * numChunks + chunk];
+            const std::vector<unsigned int>& bin = chunkBins[k * numChunks + chunk][tile];
+            for (unsigned int b = 0; b < bin.size(); b++) {
+                rasterizeTriangle(tris[bin[b]], i0, j0, i1, j1, tileDepth);
+            }
+        }
+        float *depth = depth_images[k];
+        for (int i = i0; i < i1; i++) {
+            std::copy(tileDepth + (i - i0) * TILE_SIZE, tileDepth + (i - i0) * TILE_SIZE + (j1 - j0),
+                    depth + i * width + j0);
+        }
+    });
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   soft_rasterizer.hpp
+ *
+ * Depth-only software rasterizer that reproduces the reversed-Z pipeline of
+ * depth_testing_revZ.vs: vertices go through the view and the infinite
+ * reversed-Z projection of MakeInfReversedZProjRH, triangles are clipped
+ * against the near plane (and a guard band), and fragments pass when their
+ * depth is GREATER than the float depth buffer cleared to 0.
+ *
+ * Work is done in two parallel phases per face. First the triangles are set
+ * up in chunks and binned into screen tiles, then every tile of every face is
+ * rasterized independently into a tile sized depth buffer. Edge functions
+ * and depth are evaluated for 4 pixels at a time with the SIMD vector of
+ * simd4.hpp. Shared edges are evaluated from a canonical vertex order and
+ * ties are broken by a top-left style rule so a pixel center lying on an
+ * edge is covered by exactly one of the two adjacent triangles.
+ */
+
+#ifndef SOFT_RASTERIZER_HPP
+#define SOFT_RASTERIZER_HPP
+
+#include "cpu_depth_renderer.hpp"
+#include "scene_geometry.hpp"
+
+class SoftRasterizer : public CpuDepthRenderer {
+public:
+    static const int TILE_SIZE = 32;
+    // triangles set up and binned by one task
+    static const unsigned int CHUNK_SIZE = 1 << 16;
+
+    // the scene geometry is referenced, not copied, and must outlive the rasterizer
+    SoftRasterizer(const SceneGeometry& scene);
+
+    void renderDepth(const glm::mat4 *views, int numViews, float fovY_radians,
+            float aspectWbyH, float zNear, int width, int height, float **depth_images);
+
+private:
+    const SceneGeometry& scene;
+};
+
+#endif /* SOFT_RASTERIZER_HPP */
+
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spherical_grid.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SphericalGrid::SphericalGrid() : rows(0), cols(0),
+front(1.0f, 0.0f, 0.0f), up(0.0f, 1.0f, 0.0f), other(0.0f, 0.0f, 1.0f) {
+}
+
+void SphericalGrid::setup(const glm::vec3& _front, const glm::vec3& _up, int _rows) {
+    rows = std::max(_rows, 2);
+    cols = 2 * rows;
+    up = glm::normalize(_up);
+    front = glm::normalize(_front - glm::dot(_front, up) * up);
+    other = glm::cross(front, up);
+    sinTheta.resize(rows + 1);
+    cosTheta.resize(rows + 1);
+    for (int i = 0; i <= rows; i++) {
+        double theta = M_PI * i / rows;
+        sinTheta[i] = (float) std::sin(theta);
+        cosTheta[i] = (float) std::cos(theta);
+    }
+    // the poles are exact
+    sinTheta[0] = sinTheta[rows] = 0.0f;
+    sinPhi.resize(cols);
+    cosPhi.resize(cols);
+    for (int j = 0; j < cols; j++) {
+        double phi = 2.0 * M_PI * j / cols;
+        sinPhi[j] = (float) std::sin(phi);
+        cosPhi[j] = (float) std::cos(phi);
+    }
+}
+
+int SphericalGrid::defaultRows(float fovY_radians, int height) {
+    float pitch = 2.0f * std::tan(fovY_radians / 2.0f) / height;
+    return std::max((int) std::ceil(M_PI / pitch), 2);
+}
+
+glm::vec3 SphericalGrid::direction(int row, int col) const {
+    return sinTheta[row] * (cosPhi[col] * front + sinPhi[col] * other) + cosTheta[row] * up;
+}
+
+void SphericalGrid::resample(const VolumeUnprojector& unprojector, const float * const *depth_images,
+        VolumeMesh& mesh) const {
+    // vertex 0 is the up pole, ring i starts at 1 + (i - 1) * cols, the last vertex is the down pole
+    unsigned int numRingVertices = (rows - 1) * cols;
+    unsigned int downPole = 1 + numRingVertices;
+    mesh.vertices.resize(numRingVertices + 2);
+    mesh.triangles.resize(2 * cols * (rows - 1));
+
+    auto sample = [&](const glm::vec3& d) {
+        int view;
+        float x, y, scale;
+        unprojector.locate(d, view, x, y, scale);
+        float depth = unprojector.sampleDepth(depth_images, view, x, y);
+        return unprojector.unprojectDirection(scale * d, depth);
+    };
+
+    parallel_for(0, rows + 1, [&](int i) {
+        if (i == 0) {
+            mesh.vertices[0] = sample(direction(0, 0));
+        } else if (i == rows) {
+            mesh.vertices[downPole] = sample(direction(rows, 0));
+        } else {
+            glm::vec3 *ring = &mesh.vertices[1 + (i - 1) * cols];
+            for (int j = 0; j < cols; j++) {
+                ring[j] = sample(direction(i, j));
+            }
+        }
+        // triangles of the band between ring i - 1 and ring i, the pole fans have one per column
+        if (i == 0) {
+            return;
+        }
+        glm::u32vec3 *band = &mesh.triangles[(i == 1) ? 0 : cols + 2 * cols * (i - 2)];
+        for (int j = 0; j < cols; j++) {
+            int jn = (j + 1 == cols) ? 0 : j + 1;
+            if (i == 1) {
+                band[j] = glm::u32vec3(0, 1 + jn, 1 + j);
+            } else if (i == rows) {
+                unsigned int a = 1 + (rows - 2) * cols;
+                band[j] = glm::u32vec3(downPole, a + j, a + jn);
+            } else {
+                unsigned int a = 1 + (i - 2) * cols, b = 1 + (i - 1) * cols;
+                band[2 * j] = glm::u32vec3(a + j, a + jn, b + j);
+                band[2 * j + 1] = glm::u32vec3(a + jn, b + jn, b + j);
+            }
+        }
+    });
+}
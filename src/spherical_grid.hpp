@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   spherical_grid.hpp
+ *
+ * Equirectangular parameterization of a visibility volume. The six cube face
+ * depth images are resampled onto a uniform (theta, phi) grid where theta is
+ * the polar angle from the up vector and phi the azimuth from the front
+ * vector, so the volume becomes a single closed grid mesh: two pole vertices,
+ * rows - 1 rings of cols = 2 * rows vertices, triangle fans around the poles
+ * and quad strips that wrap around in phi. No seams or corners between faces
+ * need to be stitched and the angular sampling no longer varies over the
+ * faces of the cube.
+ */
+
+#ifndef SPHERICAL_GRID_HPP
+#define SPHERICAL_GRID_HPP
+
+#include "volume_mesh.hpp"
+#include "volume_unprojector.hpp"
+
+#include <glm/glm.hpp>
+
+class SphericalGrid {
+public:
+    SphericalGrid();
+
+    // rows polar steps of pi / rows, the frame is orthonormalized keeping up
+    void setup(const glm::vec3& front, const glm::vec3& up, int rows);
+
+    // rows matching the angular pixel pitch at the center of a cube face
+    static int defaultRows(float fovY_radians, int height);
+
+    // unit direction of ring row (0 and rows are the poles) and column col
+    glm::vec3 direction(int row, int col) const;
+
+    // sample the cube face depth images at every grid direction and build the mesh
+    void resample(const VolumeUnprojector& unprojector, const float * const *depth_images,
+            VolumeMesh& mesh) const;
+
+    int rows, cols;
+
+private:
+    glm::vec3 front, up, other;
+    std::vector<float> sinTheta, cosTheta, sinPhi, cosPhi;
+};
+
+#endif /* SPHERICAL_GRID_HPP */
+
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "submesh_index.hpp"
+
+#include <algorithm>
+
+void SubmeshIndex::build(const std::vector<glm::vec3>& lo, const std::vector<glm::vec3>& hi) {
+    itemLo = lo;
+    itemHi = hi;
+    nodes.clear();
+    order.resize(lo.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (int) i;
+    }
+    if (!order.empty()) {
+        nodes.reserve(2 * order.size() / LEAF_SIZE + 1);
+        nodes.push_back(Node());
+        buildNode(0, 0, (int) order.size());
+    }
+}
+
+void SubmeshIndex::buildNode(int index, int begin, int end) {
+    glm::vec3 lo = itemLo[order[begin]], hi = itemHi[order[begin]];
+    glm::vec3 clo = 0.5f * (lo + hi), chi = clo;
+    for (int i = begin; i < end; i++) {
+        lo = glm::min(lo, itemLo[order[i]]);
+        hi = glm::max(hi, itemHi[order[i]]);
+        glm::vec3 c = 0.5f * (itemLo[order[i]] + itemHi[order[i]]);
+        clo = glm::min(clo, c);
+        chi = glm::max(chi, c);
+    }
+    nodes[index].lo = lo;
+    nodes[index].hi = hi;
+    if (end - begin <= LEAF_SIZE) {
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        return;
+    }
+    // median split of the box centers along their widest axis
+    glm::vec3 extent = chi - clo;
+    int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+    int mid = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+        return itemLo[a][axis] + itemHi[a][axis] < itemLo[b][axis] + itemHi[b][axis];
+    });
+    // children are allocated next to each other
+    int left = (int) nodes.size();
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    nodes[index].first = left;
+    nodes[index].count = 0;
+    buildNode(left, begin, mid);
+    buildNode(left + 1, mid, end);
+}
+
+bool SubmeshIndex::overlaps(const glm::vec3& lo, const glm::vec3& hi, const glm::vec3& center, float radius,
+        const Frustum *frustum) {
+    glm::vec3 nearest = glm::clamp(center, lo, hi);
+    glm::vec3 d = nearest - center;
+    if ((double) glm::dot(d, d) > (double) radius * radius) {
+        return false;
+    }
+    return frustum == nullptr || isBoxOnFrustum(*frustum, lo, hi);
+}
+
+void SubmeshIndex::query(const glm::vec3& center, float radius, const Frustum *frustum,
+        std::vector<int>& items) const {
+    items.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (!overlaps(node.lo, node.hi, center, radius, frustum)) {
+            continue;
+        }
+        if (node.count == 0) {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++) {
+            int item = order[i];
+            if (node.count == 1 || overlaps(itemLo[item], itemHi[item], center, radius, frustum)) {
+                items.push_back(item);
+            }
+        }
+    }
+    std::sort(items.begin(), items.end());
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   submesh_index.hpp
+ *
+ * Bounding box hierarchy over the world bounds of the submeshes of a scene,
+ * so a visibility volume only draws what can reach its depth images. A
+ * volume is clamped to its radius, so anything outside the radius sphere
+ * around its origin is culled, and each cube face further culls what lies
+ * outside its frustum, with the box test of learnopengl/frustum.h.
+ *
+ * Whole subtrees are culled at once, so the cost of a query follows the
+ * number of submeshes near the observer rather than the size of the scene.
+ */
+
+#ifndef SUBMESH_INDEX_HPP
+#define SUBMESH_INDEX_HPP
+
+#include <glm/glm.hpp>
+#include <learnopengl/frustum.h>
+
+#include <vector>
+
+class SubmeshIndex {
+public:
+    // items per leaf
+    static const int LEAF_SIZE = 4;
+
+    // hierarchy over the boxes [lo[i], hi[i]] of items 0 .. lo.size() - 1
+    void build(const std::vector<glm::vec3>& lo, const std::vector<glm::vec3>& hi);
+
+    // items, in increasing order, whose box meets the sphere and, given a
+    // frustum, is on or in front of all its planes
+    void query(const glm::vec3& center, float radius, const Frustum *frustum, std::vector<int>& items) const;
+
+    int size() const {
+        return (int) itemLo.size();
+    }
+
+private:
+    struct Node {
+        glm::vec3 lo, hi;
+        // leaves hold items order[first, first + count), inner nodes have
+        // count 0 and their children at first and first + 1
+        int first, count;
+    };
+
+    // fills nodes[index] with the items order[begin, end)
+    void buildNode(int index, int begin, int end);
+
+    // whether a box can hold anything to draw
+    static bool overlaps(const glm::vec3& lo, const glm::vec3& hi, const glm::vec3& center, float radius,
+            const Frustum *frustum);
+
+    std::vector<Node> nodes;
+    std::vector<int> order;
+    std::vector<glm::vec3> itemLo, itemHi;
+};
+
+#endif /* SUBMESH_INDEX_HPP */
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "volume_intersection.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+constexpr float VolumeIntersection::COINCIDENCE_PIXELS;
+constexpr float VolumeIntersection::SPLIT_PIXELS;
+
+// vertices whose signed range is evaluated by one task
+static const int VERTICES_PER_TASK = 4096;
+
+void VolumeIntersection::add(const VolumeUnprojector& unprojector, const float * const *depth_images,
+        const VolumeMesh& mesh) {
+    std::unique_ptr<Volume> volume(new Volume);
+    volume->unprojector = unprojector;
+    int facePixels = unprojector.width * unprojector.height;
+    volume->depth.resize(unprojector.numViews * facePixels);
+    volume->faces.resize(unprojector.numViews);
+    for (int k = 0; k < unprojector.numViews; k++) {
+        std::copy(depth_images[k], depth_images[k] + facePixels, &volume->depth[k * facePixels]);
+        volume->faces[k] = &volume->depth[k * facePixels];
+    }
+    volume->mesh = mesh;
+    // a pixel step at the face center, where the direction has unit length
+    float cx = 0.5f * unprojector.width, cy = 0.5f * unprojector.height;
+    volume->pixelAngle = glm::length(unprojector.direction(0, cx + 1.0f, cy) - unprojector.direction(0, cx, cy));
+    volumes.push_back(std::move(volume));
+}
+
+float VolumeIntersection::signedRange(int v, const glm::vec3& p) const {
+    return volumes[v]->unprojector.signedRange(&volumes[v]->faces[0], p);
+}
+
+float VolumeIntersection::signedRangeAll(const glm::vec3& p, int skip) const {
+    float distance = std::numeric_limits<float>::max();
+    for (int v = 0; v < size(); v++) {
+        if (v != skip) {
+            distance = std::min(distance, signedRange(v, p));
+        }
+    }
+    return distance;
+}
+
+float VolumeIntersection::ownedRange(const glm::vec3& p, int owner) const {
+    float distance = std::numeric_limits<float>::max();
+    for (int v = 0; v < size(); v++) {
+        if (v == owner) {
+            continue;
+        }
+        float tolerance = COINCIDENCE_PIXELS * volumes[v]->pixelAngle *
+                glm::length(p - volumes[v]->unprojector.rayOrigin());
+        distance = std::min(distance, signedRange(v, p) + ((v > owner) ? tolerance : -tolerance));
+    }
+    return distance;
+}
+
+bool VolumeIntersection::splitEdge(const glm::vec3& a, const glm::vec3& b, int owner) const {
+    for (int v = 0; v < size(); v++) {
+        if (v == owner) {
+            continue;
+        }
+        glm::vec3 da = a - volumes[v]->unprojector.rayOrigin(), db = b - volumes[v]->unprojector.rayOrigin();
+        float angle = std::atan2(glm::length(glm::cross(da, db)), glm::dot(da, db));
+        if (angle > SPLIT_PIXELS * volumes[v]->pixelAngle) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void VolumeIntersection::refine(int v, std::vector<glm::vec3>& vertices, std::vector<glm::u32vec3>& triangles,
+        std::vector<float>& inside) const {
+    static const unsigned int NO_SPLIT = std::numeric_limits<unsigned int>::max();
+    vertices = volumes[v]->mesh.vertices;
+    // whether an edge is split depends on its end points only, so a triangle
+    // that kept all its edges in one round keeps them for good
+    std::vector<glm::u32vec3> active = volumes[v]->mesh.triangles;
+    triangles.clear();
+    inside.clear();
+    for (int round = 0;; round++) {
+        // owned range of the vertices added by the previous round
+        size_t evaluated = inside.size();
+        inside.resize(vertices.size());
+        int numTasks = (int) ((vertices.size() - evaluated + VERTICES_PER_TASK - 1) / VERTICES_PER_TASK);
+        parallel_for(0, numTasks, [&](int task) {
+            size_t begin = evaluated + (size_t) task * VERTICES_PER_TASK;
+            size_t end = std::min(begin + VERTICES_PER_TASK, vertices.size());
+            for (size_t n = begin; n < end; n++) {
+                inside[n] = ownedRange(vertices[n], v);
+            }
+        });
+        if (round == MAX_REFINEMENTS || active.empty()) {
+            break;
+        }
+        // midpoint of every edge to split, decided once per edge so both
+        // triangles sharing it split it alike
+        std::unordered_map<uint64_t, unsigned int> midpoints;
+        auto midpoint = [&](unsigned int a, unsigned int b) {
+            // an edge ending on a coincident boundary may pass well inside,
+            // only edges deeper outside than they are long are left alone
+            if (std::max(inside[a], inside[b]) < -glm::length(vertices[a] - vertices[b])) {
+                return NO_SPLIT;
+            }
+            uint64_t key = ((uint64_t) std::min(a, b) << 32) | std::max(a, b);
+            std::unordered_map<uint64_t, unsigned int>::iterator it = midpoints.find(key);
+            if (it != midpoints.end()) {
+                return it->second;
+            }
+            unsigned int index = NO_SPLIT;
+            if (splitEdge(vertices[a], vertices[b], v)) {
+                index = (unsigned int) vertices.size();
+                vertices.push_back(0.5f * (vertices[a] + vertices[b]));
+            }
+            midpoints[key] = index;
+            return index;
+        };
+        std::vector<glm::u32vec3> refined;
+        for (const glm::u32vec3& face : active) {
+            unsigned int c[3] = {face.x, face.y, face.z};
+            // m[e] splits the edge from c[e] to c[e + 1]
+            unsigned int m[3];
+            int numSplit = 0, split = 0, kept = 0;
+            for (int e = 0; e < 3; e++) {
+                m[e] = midpoint(c[e], c[(e + 1) % 3]);
+                if (m[e] != NO_SPLIT) {
+                    numSplit++;
+                    split = e;
+                } else {
+                    kept = e;
+                }
+            }
+            int e1 = (kept + 1) % 3, e2 = (kept + 2) % 3;
+            switch (numSplit) {
+                case 0:
+                    triangles.push_back(face);
+                    break;
+                case 1:
+                    refined.push_back(glm::u32vec3(c[split], m[split], c[(split + 2) % 3]));
+                    refined.push_back(glm::u32vec3(m[split], c[(split + 1) % 3], c[(split + 2) % 3]));
+                    break;
+                case 2:
+                    refined.push_back(glm::u32vec3(m[e1], c[e2], m[e2]));
+                    refined.push_back(glm::u32vec3(c[kept], c[e1], m[e1]));
+                    refined.push_back(glm::u32vec3(c[kept], m[e1], m[e2]));
+                    break;
+                default:
+                    refined.push_back(glm::u32vec3(c[0], m[0], m[2]));
+                    refined.push_back(glm::u32vec3(m[0], c[1], m[1]));
+                    refined.push_back(glm::u32vec3(m[2], m[1], c[2]));
+                    refined.push_back(glm::u32vec3(m[0], m[1], m[2]));
+                    break;
+            }
+        }
+        active.swap(refined);
+    }
+    triangles.insert(triangles.end(), active.begin(), active.end());
+}
+
+void VolumeIntersection::intersect(VolumeMesh& result) const {
+    result.clear();
+    int numVolumes = size();
+    // every refined vertex is an output vertex, unreferenced ones are dropped at the end
+    std::vector<std::vector<glm::u32vec3> > triangles(numVolumes);
+    std::vector<float> inside;
+    std::vector<unsigned int> offsets(numVolumes + 1, 0);
+    for (int v = 0; v < numVolumes; v++) {
+        std::vector<glm::vec3> vertices;
+        std::vector<float> range;
+        refine(v, vertices, triangles[v], range);
+        offsets[v + 1] = offsets[v] + (unsigned int) vertices.size();
+        result.vertices.insert(result.vertices.end(), vertices.begin(), vertices.end());
+        inside.insert(inside.end(), range.begin(), range.end());
+    }
+
+    // one crossing vertex per edge that leaves the common region
+    struct Crossing {
+        int volume;
+        unsigned int in, out;
+    };
+    std::vector<Crossing> crossings;
+    std::unordered_map<uint64_t, unsigned int> crossingIndex;
+    auto crossing = [&](int v, unsigned int a, unsigned int b) {
+        unsigned int in = (inside[a] >= 0) ? a : b;
+        unsigned int out = (in == a) ? b : a;
+        uint64_t key = ((uint64_t) in << 32) | out;
+        std::unordered_map<uint64_t, unsigned int>::iterator it = crossingIndex.find(key);
+        if (it != crossingIndex.end()) {
+            return it->second;
+        }
+        unsigned int index = (unsigned int) (result.vertices.size() + crossings.size());
+        crossingIndex[key] = index;
+        Crossing c = {v, in, out};
+        crossings.push_back(c);
+        return index;
+    };
+    for (int v = 0; v < numVolumes; v++) {
+        for (const glm::u32vec3& face : triangles[v]) {
+            unsigned int corner[3] = {offsets[v] + face.x, offsets[v] + face.y, offsets[v] + face.z};
+            int numInside = (inside[corner[0]] >= 0) + (inside[corner[1]] >= 0) + (inside[corner[2]] >= 0);
+            if (numInside == 3) {
+                result.triangles.push_back(glm::u32vec3(corner[0], corner[1], corner[2]));
+            } else if (numInside > 0) {
+                // the part with non-negative range, in the winding order of the face
+                unsigned int polygon[4];
+                int count = 0;
+                for (int c = 0; c < 3; c++) {
+                    unsigned int a = corner[c], b = corner[(c + 1) % 3];
+                    if (inside[a] >= 0) {
+                        polygon[count++] = a;
+                    }
+                    if ((inside[a] >= 0) != (inside[b] >= 0)) {
+                        polygon[count++] = crossing(v, a, b);
+                    }
+                }
+                for (int c = 2; c < count; c++) {
+                    result.triangles.push_back(glm::u32vec3(polygon[0], polygon[c - 1], polygon[c]));
+                }
+            }
+        }
+    }
+
+    // bisection on the owned range along every crossing edge
+    size_t base = result.vertices.size();
+    result.vertices.resize(base + crossings.size());
+    int numTasks = (int) ((crossings.size() + VERTICES_PER_TASK - 1) / VERTICES_PER_TASK);
+    parallel_for(0, numTasks, [&](int task) {
+        size_t begin = (size_t) task * VERTICES_PER_TASK;
+        size_t end = std::min(begin + VERTICES_PER_TASK, crossings.size());
+        for (size_t n = begin; n < end; n++) {
+            const Crossing& c = crossings[n];
+            glm::vec3 a = result.vertices[c.in], b = result.vertices[c.out];
+            float lo = 0.0f, hi = 1.0f;
+            for (int step = 0; step < BISECTIONS; step++) {
+                float t = 0.5f * (lo + hi);
+                if (ownedRange(a + t * (b - a), c.volume) >= 0) {
+                    lo = t;
+                } else {
+                    hi = t;
+                }
+            }
+            result.vertices[base + n] = a + lo * (b - a);
+        }
+    });
+    result.removeUnreferencedVertices();
+}
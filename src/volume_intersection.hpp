@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   volume_intersection.hpp
+ *
+ * Intersection of visibility volumes without a general mesh boolean. Every
+ * volume is star-shaped about its origin, so whether a point lies inside it
+ * is a single lookup in its range cube map (VolumeUnprojector::signedRange).
+ * The boundary of the common region is made of those parts of each volume's
+ * boundary that lie inside all the other volumes. Every boundary mesh is
+ * therefore clipped against the signed range of the others. Triangles that
+ * cross the zero level are cut at edge points found by bisection on the
+ * signed range. The crossing points are shared along an edge, so each clipped
+ * piece stays free of cracks. A triangle whose corners all lie inside may
+ * still be crossed by the shadow of another volume, so edges are first split
+ * until none spans more than SPLIT_PIXELS pixels of any other range image.
+ * Pieces of different volumes meet along the intersection curves, up to the
+ * resolution of the range images.
+ *
+ * Volumes often share parts of their boundary, e.g. a wall seen from every
+ * origin. There the signed range is zero up to noise. A plain sign test would
+ * keep a random half of each copy of the wall, or both copies. Boundaries
+ * within COINCIDENCE_PIXELS pixel footprints of each other are therefore
+ * taken as coincident. Only the copy of the volume added first is kept.
+ *
+ * The range lookups, which dominate the cost, run in parallel across the
+ * vertices added by each round of refinement and across the crossing edges.
+ */
+
+#ifndef VOLUME_INTERSECTION_HPP
+#define VOLUME_INTERSECTION_HPP
+
+#include "volume_mesh.hpp"
+#include "volume_unprojector.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+class VolumeIntersection {
+public:
+    // bisection steps along a crossing edge, the cut lands within 2^-BISECTIONS of the edge length
+    static const int BISECTIONS = 20;
+    // boundaries closer than this many pixel footprints are treated as one
+    static constexpr float COINCIDENCE_PIXELS = 2.0f;
+    // longest edge, in pixels of the other range images, left after refinement
+    static constexpr float SPLIT_PIXELS = 2.0f;
+    // rounds of edge splitting, bounds the growth near the other origins
+    static const int MAX_REFINEMENTS = 12;
+
+    // keeps copies of the depth images and the closed boundary mesh of one volume
+    void add(const VolumeUnprojector& unprojector, const float * const *depth_images, const VolumeMesh& mesh);
+
+    int size() const {
+        return (int) volumes.size();
+    }
+
+    void clear() {
+        volumes.clear();
+    }
+
+    // radial distance of p from the boundary of volume v, positive inside
+    float signedRange(int v, const glm::vec3& p) const;
+
+    // smallest signed range over all volumes but skip, positive inside all of them
+    float signedRangeAll(const glm::vec3& p, int skip = -1) const;
+
+    // boundary mesh of the region inside every volume
+    void intersect(VolumeMesh& result) const;
+
+private:
+    // signed range of p on the boundary of volume owner with respect to all
+    // other volumes, shifted so coincident boundaries count as inside the
+    // volumes added after owner and outside those added before it
+    float ownedRange(const glm::vec3& p, int owner) const;
+
+    // whether edge (a, b) of volume owner, not entirely outside, subtends
+    // more than SPLIT_PIXELS pixels as seen from another origin
+    bool splitEdge(const glm::vec3& a, const glm::vec3& b, int owner) const;
+
+    // the boundary mesh of volume v, edges split where needed, and the owned
+    // range of every vertex
+    void refine(int v, std::vector<glm::vec3>& vertices, std::vector<glm::u32vec3>& triangles,
+            std::vector<float>& inside) const;
+
+    struct Volume {
+        VolumeUnprojector unprojector;
+        std::vector<float> depth;
+        std::vector<const float *> faces;
+        VolumeMesh mesh;
+        // angle of one pixel at the center of a face
+        float pixelAngle;
+    };
+    std::vector<std::unique_ptr<Volume> > volumes;
+};
+
+#endif /* VOLUME_INTERSECTION_HPP */
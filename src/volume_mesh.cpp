@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "volume_mesh.hpp"
+#include "obj_stream_writer.hpp"
+#include "binary_io.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+// stdio buffer of the mesh files
+static const size_t FILE_BUFFER_SIZE = 1 << 20;
+
+static FILE *openMeshFile(const std::string& filename, const char *mode, std::vector<char>& buffer) {
+    FILE *file = fopen(filename.c_str(), mode);
+    if (file == nullptr) {
+        std::cout << "Could not open " << filename << " for writing." << std::endl;
+        return nullptr;
+    }
+    buffer.resize(FILE_BUFFER_SIZE);
+    setvbuf(file, &buffer[0], _IOFBF, buffer.size());
+    return file;
+}
+
+static bool closeMeshFile(FILE *file, const std::string& filename, bool ok) {
+    if (fclose(file) != 0 || !ok) {
+        std::cout << "Error writing " << filename << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void VolumeMesh::removeUnreferencedVertices() {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    unsigned int count = 0;
+    for (glm::u32vec3& face : triangles) {
+        for (int c = 0; c < 3; c++) {
+            if (remap[face[c]] == unused) {
+                remap[face[c]] = count++;
+            }
+            face[c] = remap[face[c]];
+        }
+    }
+    std::vector<glm::vec3> compact(count);
+    for (size_t n = 0; n < vertices.size(); n++) {
+        if (remap[n] != unused) {
+            compact[remap[n]] = vertices[n];
+        }
+    }
+    vertices.swap(compact);
+}
+
+std::string VolumeMesh::formatFromFilename(const std::string& filename) {
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return "obj";
+    }
+    std::string ext = filename.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+        return (char) std::tolower(c);
+    });
+    return ext;
+}
+
+bool VolumeMesh::write(const std::string& filename, const std::string& format) const {
+    std::string fmt = format.empty() ? formatFromFilename(filename) : format;
+    if (fmt == "ply") {
+        return writePLY(filename);
+    } else if (fmt == "glb") {
+        return writeGLB(filename);
+    } else if (fmt != "obj") {
+        std::cout << "Unknown mesh format \"" << fmt << "\" for " << filename << ", writing OBJ." << std::endl;
+    }
+    return writeOBJ(filename);
+}
+
+bool VolumeMesh::writeOBJ(const std::string& filename) const {
+    ObjStreamWriter obj;
+    if (!obj.open(filename)) {
+        return false;
+    }
+    if (!vertices.empty()) {
+        obj.writeVertices(&vertices[0], vertices.size());
+    }
+    // OBJ indices are 1 based
+    const size_t FACES_PER_BLOCK = 1 << 16;
+    std::vector<glm::u32vec3> block;
+    for (size_t n = 0; n < triangles.size(); n += FACES_PER_BLOCK) {
+        size_t count = std::min(triangles.size() - n, FACES_PER_BLOCK);
+        block.resize(count);
+        for (size_t f = 0; f < count; f++) {
+            block[f] = triangles[n + f] + glm::u32vec3(1);
+        }
+        obj.writeFaces(&block[0], count);
+    }
+    return obj.close();
+}
+
+bool VolumeMesh::writePLY(const std::string& filename) const {
+    std::vector<char> buffer;
+    FILE *fply = openMeshFile(filename, "wb", buffer);
+    if (fply == nullptr) {
+        return false;
+    }
+    fprintf(fply, "ply\nformat binary_little_endian 1.0\n"
+            "element vertex %zu\nproperty float x\nproperty float y\nproperty float z\n"
+            "element face %zu\nproperty list uchar uint vertex_indices\nend_header\n",
+            vertices.size(), triangles.size());
+    bool ok = vertices.empty() || writeWordsLE(fply, &vertices[0], 3 * vertices.size());
+    // face records are 13 bytes, packed into blocks of 4096 faces
+    const size_t FACE_RECORD_SIZE = 1 + 3 * sizeof (uint32_t);
+    const size_t FACES_PER_BLOCK = 4096;
+    std::vector<unsigned char> block(FACE_RECORD_SIZE * FACES_PER_BLOCK);
+    for (size_t n = 0; ok && n < triangles.size(); n += FACES_PER_BLOCK) {
+        size_t count = std::min(triangles.size() - n, FACES_PER_BLOCK);
+        unsigned char *record = &block[0];
+        for (size_t f = 0; f < count; f++, record += FACE_RECORD_SIZE) {
+            record[0] = 3;
+            for (int c = 0; c < 3; c++) {
+                uint32_t index = triangles[n + f][c];
+                // least significant byte first on any host
+                for (int b = 0; b < 4; b++) {
+                    record[1 + 4 * c + b] = (unsigned char) (index >> (8 * b));
+                }
+            }
+        }
+        ok = fwrite(&block[0], FACE_RECORD_SIZE, count, fply) == count;
+    }
+    return closeMeshFile(fply, filename, ok);
+}
+
+bool VolumeMesh::writeGLB(const std::string& filename) const {
+    glm::vec3 bmin(0.0f), bmax(0.0f);
+    if (!vertices.empty()) {
+        bmin = bmax = vertices[0];
+        for (const glm::vec3& v : vertices) {
+            bmin = glm::min(bmin, v);
+            bmax = glm::max(bmax, v);
+        }
+    }
+    size_t positionBytes = vertices.size() * 3 * sizeof (float);
+    size_t indexBytes = triangles.size() * 3 * sizeof (uint32_t);
+    std::ostringstream json;
+    json.precision(9);
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"ogl_depthrenderer\"},"
+            << "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+            << "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0},\"indices\":1,\"mode\":4}]}],"
+            << "\"accessors\":["
+            << "{\"bufferView\":0,\"componentType\":5126,\"count\":" << vertices.size() << ",\"type\":\"VEC3\","
+            << "\"min\":[" << bmin.x << "," << bmin.y << "," << bmin.z << "],"
+            << "\"max\":[" << bmax.x << "," << bmax.y << "," << bmax.z << "]},"
+            << "{\"bufferView\":1,\"componentType\":5125,\"count\":" << 3 * triangles.size() << ",\"type\":\"SCALAR\"}],"
+            << "\"bufferViews\":["
+            << "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << positionBytes << ",\"target\":34962},"
+            << "{\"buffer\":0,\"byteOffset\":" << positionBytes << ",\"byteLength\":" << indexBytes << ",\"target\":34963}],"
+            << "\"buffers\":[{\"byteLength\":" << positionBytes + indexBytes << "}]}";
+    std::string header = json.str();
+    // chunks are 4 byte aligned, JSON padded with spaces
+    while (header.size() % 4 != 0) {
+        header += ' ';
+    }
+    // both arrays are made of 4 byte words, so the binary chunk needs no padding
+    size_t binaryBytes = positionBytes + indexBytes;
+    uint64_t totalBytes = 12 + 8 + header.size() + 8 + binaryBytes;
+    if (totalBytes > UINT32_MAX) {
+        std::cout << "Mesh too large for GLB (" << totalBytes << " bytes): " << filename << std::endl;
+        return false;
+    }
+    std::vector<char> buffer;
+    FILE *fglb = openMeshFile(filename, "wb", buffer);
+    if (fglb == nullptr) {
+        return false;
+    }
+    uint32_t words[3] = {0x46546C67u /* glTF */, 2u, (uint32_t) totalBytes};
+    bool ok = writeWordsLE(fglb, words, 3);
+    uint32_t jsonChunk[2] = {(uint32_t) header.size(), 0x4E4F534Au /* JSON */};
+    ok = ok && writeWordsLE(fglb, jsonChunk, 2) && fwrite(header.data(), 1, header.size(), fglb) == header.size();
+    uint32_t binChunk[2] = {(uint32_t) binaryBytes, 0x004E4942u /* BIN */};
+    ok = ok && writeWordsLE(fglb, binChunk, 2);
+    ok = ok && (vertices.empty() || writeWordsLE(fglb, &vertices[0], 3 * vertices.size()));
+    ok = ok && (triangles.empty() || writeWordsLE(fglb, &triangles[0], 3 * triangles.size()));
+    return closeMeshFile(fglb, filename, ok);
+}
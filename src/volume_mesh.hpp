@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   volume_mesh.hpp
+ *
+ * Closed triangle mesh of a visibility volume. Triangle indices are 0 based
+ * and wound counter-clockwise seen from outside the volume.
+ *
+ * Besides ASCII OBJ the mesh can be written as binary little endian PLY or as
+ * binary glTF (GLB). The binary writers dump the vertex and index arrays with
+ * a few large fwrite calls through a 1 MB stdio buffer.
+ */
+
+#ifndef VOLUME_MESH_HPP
+#define VOLUME_MESH_HPP
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+class VolumeMesh {
+public:
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::u32vec3> triangles;
+
+    void clear() {
+        vertices.clear();
+        triangles.clear();
+    }
+
+    // drop vertices no triangle refers to and renumber the triangles
+    void removeUnreferencedVertices();
+
+    // "obj", "ply" or "glb", an empty format is taken from the file extension
+    bool write(const std::string& filename, const std::string& format = "") const;
+
+    // ASCII Wavefront OBJ, "v x y z" and 1 based "f a b c" records with
+    // shortest round trip coordinates
+    bool writeOBJ(const std::string& filename) const;
+
+    // binary little endian PLY, faces as uchar count + 3 uint indices
+    bool writePLY(const std::string& filename) const;
+
+    // glTF 2.0 binary container holding a single indexed triangle primitive
+    bool writeGLB(const std::string& filename) const;
+
+    // lower case extension of filename, "obj" when there is none
+    static std::string formatFromFilename(const std::string& filename);
+};
+
+#endif /* VOLUME_MESH_HPP */
+
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "volume_unprojector.hpp"
+#include "parallel.hpp"
+#include "simd4.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// rows of pixels per task
+static const int ROWS_PER_TASK = 16;
+
+VolumeUnprojector::VolumeUnprojector() : numViews(0), width(0), height(0), focal(1.0f), aspect(1.0f), faceStride(0),
+origin(0.0f), zNear(1.0e-2f), depth_min(0.0f), wcs_basis(1.0f), wcs_offset(0.0f),
+radius_max(std::numeric_limits<float>::max()), wcs_origin(0.0f), wcs_up(0.0f, 1.0f, 0.0f),
+up(0.0f, 1.0f, 0.0f), up_min(-std::numeric_limits<float>::max()), up_max(std::numeric_limits<float>::max()) {
+}
+
+void VolumeUnprojector::setupRays(const glm::mat4 *views, int _numViews, float fovY_radians,
+        float aspectWbyH, int _width, int _height, bool tables) {
+    numViews = _numViews;
+    width = _width;
+    height = _height;
+    faceStride = (width * height + 3) & ~3;
+    focal = 1.0f / std::tan(fovY_radians / 2.0f);
+    aspect = aspectWbyH;
+    rotations.resize(numViews);
+    for (int k = 0; k < numViews; k++) {
+        rotations[k] = glm::mat3(glm::inverse(views[k]));
+    }
+    if (!tables) {
+        dirX.clear();
+        dirY.clear();
+        dirZ.clear();
+        return;
+    }
+    // vector loads of a row range may run up to 3 floats past the last face
+    dirX.assign(numViews * faceStride + 3, 0.0f);
+    dirY.assign(numViews * faceStride + 3, 0.0f);
+    dirZ.assign(numViews * faceStride + 3, 0.0f);
+    for (int k = 0; k < numViews; k++) {
+        for (int pixel = 0; pixel < width * height; pixel++) {
+            glm::vec3 d = rotations[k] * eyeDirection(pixel);
+            int idx = k * faceStride + pixel;
+            dirX[idx] = d.x;
+            dirY[idx] = d.y;
+            dirZ[idx] = d.z;
+        }
+    }
+}
+
+void VolumeUnprojector::setLimits(const glm::vec3& _origin, float _zNear, float _depth_min,
+        const glm::mat3& _wcs_basis, float _radius_max,
+        const glm::vec3& _wcs_origin, const glm::vec3& _wcs_up,
+        const glm::vec3& _up, float _up_min, float _up_max) {
+    origin = _origin;
+    zNear = _zNear;
+    depth_min = _depth_min;
+    wcs_basis = _wcs_basis;
+    wcs_offset = wcs_basis * origin - origin;
+    radius_max = _radius_max;
+    wcs_origin = _wcs_origin;
+    wcs_up = _wcs_up;
+    up = _up;
+    up_min = _up_min;
+    up_max = _up_max;
+}
+
+glm::vec3 VolumeUnprojector::unprojectPixel(int view, int pixel, float depth) const {
+    return unprojectDirection(direction(view, pixel), depth);
+}
+
+glm::vec3 VolumeUnprojector::unprojectDirection(const glm::vec3& d, float depth) const {
+    float t = zNear / std::max(depth, depth_min);
+    glm::vec3 p = origin + t * d;
+    glm::vec3 q = wcs_offset + t * (wcs_basis * d);
+    float r = glm::length(q);
+    if (r > radius_max) {
+        p = origin + q * (radius_max / r);
+    }
+    float h = glm::dot(p - wcs_origin, wcs_up);
+    if (h > up_max) {
+        p = p - (h - up_max) * up;
+    } else if (h < up_min) {
+        p = p + (up_min - h) * up;
+    }
+    return p;
+}
+
+void VolumeUnprojector::locate(const glm::vec3& d, int& view, float& x, float& y, float& scale) const {
+    // the face with the largest eye depth component has the direction closest to its axis
+    view = 0;
+    glm::vec3 eye(0.0f, 0.0f, 1.0f);
+    for (int k = 0; k < numViews; k++) {
+        // inverse of a rotation is its transpose
+        glm::vec3 e = glm::transpose(rotations[k]) * d;
+        if (k == 0 || -e.z > -eye.z) {
+            view = k;
+            eye = e;
+        }
+    }
+    scale = 1.0f / -eye.z;
+    float ndc_x = eye.x * scale * focal / aspect;
+    float ndc_y = eye.y * scale * focal;
+    x = std::min(std::max((ndc_x + 1.0f) * 0.5f * width, 0.5f), width - 0.5f);
+    y = std::min(std::max((ndc_y + 1.0f) * 0.5f * height, 0.5f), height - 0.5f);
+}
+
+float VolumeUnprojector::sampleDepth(const float * const *depth_images, int view, float x, float y) const {
+    const float *depth = depth_images[view];
+    float fx = x - 0.5f, fy = y - 0.5f;
+    int j0 = std::min(std::max((int) std::floor(fx), 0), width - 1);
+    int i0 = std::min(std::max((int) std::floor(fy), 0), height - 1);
+    int j1 = std::min(j0 + 1, width - 1), i1 = std::min(i0 + 1, height - 1);
+    float ax = std::min(std::max(fx - j0, 0.0f), 1.0f);
+    float ay = std::min(std::max(fy - i0, 0.0f), 1.0f);
+    float z00 = depth[i0 * width + j0], z01 = depth[i0 * width + j1];
+    float z10 = depth[i1 * width + j0], z11 = depth[i1 * width + j1];
+    float zlo = std::min(std::min(z00, z01), std::min(z10, z11));
+    float zhi = std::max(std::max(z00, z01), std::max(z10, z11));
+    // background (depth below depth_min) or a range jump of more than 25%
+    if (zlo < depth_min || zhi > 1.25f * zlo) {
+        int j = (ax < 0.5f) ? j0 : j1;
+        int i = (ay < 0.5f) ? i0 : i1;
+        return depth[i * width + j];
+    }
+    // 1 / eye depth is linear in the image for planar surfaces
+    return (1.0f - ay) * ((1.0f - ax) * z00 + ax * z01) + ay * ((1.0f - ax) * z10 + ax * z11);
+}
+
+float VolumeUnprojector::signedRange(const float * const *depth_images, const glm::vec3& p) const {
+    glm::vec3 d = p - origin;
+    float range = glm::length(d);
+    float distance = zNear / depth_min;
+    if (range > 0) {
+        int view;
+        float x, y, scale;
+        locate(d, view, x, y, scale);
+        // the eye depth of p is 1 / scale, that of the surface zNear / depth
+        float depth = std::max(sampleDepth(depth_images, view, x, y), depth_min);
+        distance = range * (zNear / depth * scale - 1.0f);
+    }
+    float r = glm::length(wcs_offset + wcs_basis * d);
+    float h = glm::dot(p - wcs_origin, wcs_up);
+    return std::min(std::min(distance, radius_max - r), std::min(up_max - h, h - up_min));
+}
+
+void VolumeUnprojector::unprojectRange(int view, int begin, int end, const float *depth, glm::vec3 *points) const {
+    if (!dirX.empty()) {
+        int idx = view * faceStride + begin;
+        unprojectRange(&dirX[idx], &dirY[idx], &dirZ[idx], end - begin, depth, points);
+        return;
+    }
+    // directions of this range only, padded to whole vectors
+    int padded = (end - begin + 3) & ~3;
+    std::vector<float> dirs(3 * padded, 0.0f);
+    float *dx = &dirs[0], *dy = dx + padded, *dz = dy + padded;
+    for (int n = begin; n < end; n++) {
+        glm::vec3 d = rotations[view] * eyeDirection(n);
+        dx[n - begin] = d.x;
+        dy[n - begin] = d.y;
+        dz[n - begin] = d.z;
+    }
+    unprojectRange(dx, dy, dz, end - begin, depth, points);
+}
+
+void VolumeUnprojector::unprojectRange(const float *dx, const float *dy, const float *dz, int count,
+        const float *depth, glm::vec3 *points) const {
+    const vfloat4 ox(origin.x), oy(origin.y), oz(origin.z);
+    const vfloat4 cx(wcs_offset.x), cy(wcs_offset.y), cz(wcs_offset.z);
+    const glm::mat3& B = wcs_basis;
+    const vfloat4 vzNear(zNear), vdepth_min(depth_min);
+    // radius_max^2 may overflow to inf, which never clamps
+    const vfloat4 rmax(radius_max), rmax2((float) ((double) radius_max * radius_max));
+    const vfloat4 wox(wcs_origin.x), woy(wcs_origin.y), woz(wcs_origin.z);
+    const vfloat4 wux(wcs_up.x), wuy(wcs_up.y), wuz(wcs_up.z);
+    const vfloat4 ux(up.x), uy(up.y), uz(up.z);
+    const vfloat4 hmaxv(up_max), hminv(up_min);
+    float zbuf[4];
+    float out[3][4];
+    for (int n = 0; n < count; n += 4) {
+        int lanes = std::min(4, count - n);
+        for (int l = 0; l < 4; l++) {
+            zbuf[l] = (l < lanes) ? depth[n + l] : 1.0f;
+        }
+        vfloat4 t = vzNear / vmax(vfloat4::load(zbuf), vdepth_min);
+        vfloat4 vx = vfloat4::load(dx + n), vy = vfloat4::load(dy + n), vz = vfloat4::load(dz + n);
+        vfloat4 px = ox + t * vx, py = oy + t * vy, pz = oz + t * vz;
+        // distance measured in the world coordinate system
+        vfloat4 qx = cx + t * (vfloat4(B[0][0]) * vx + vfloat4(B[1][0]) * vy + vfloat4(B[2][0]) * vz);
+        vfloat4 qy = cy + t * (vfloat4(B[0][1]) * vx + vfloat4(B[1][1]) * vy + vfloat4(B[2][1]) * vz);
+        vfloat4 qz = cz + t * (vfloat4(B[0][2]) * vx + vfloat4(B[1][2]) * vy + vfloat4(B[2][2]) * vz);
+        vfloat4 r2 = qx * qx + qy * qy + qz * qz;
+        vbool4 far = r2 > rmax2;
+        if (far.any()) {
+            vfloat4 s = rmax / vsqrt(r2);
+            px = select(far, ox + qx * s, px);
+            py = select(far, oy + qy * s, py);
+            pz = select(far, oz + qz * s, pz);
+        }
+        vfloat4 h = (px - wox) * wux + (py - woy) * wuy + (pz - woz) * wuz;
+        vbool4 above = h > hmaxv;
+        vbool4 below = andnot(h < hminv, above);
+        if ((above | below).any()) {
+            vfloat4 shift = select(above, hmaxv - h, select(below, hminv - h, vfloat4(0.0f)));
+            px = px + shift * ux;
+            py = py + shift * uy;
+            pz = pz + shift * uz;
+        }
+        px.store(out[0]);
+        py.store(out[1]);
+        pz.store(out[2]);
+        for (int l = 0; l < lanes; l++) {
+            points[n + l] = glm::vec3(out[0][l], out[1][l], out[2][l]);
+        }
+    }
+}
+
+void VolumeUnprojector::unproject(const float * const *depth_images, glm::vec3 *points) const {
+    int blocksPerView = (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    parallel_for(0, numViews * blocksPerView, [&](int task) {
+        int k = task / blocksPerView;
+        int i0 = (task % blocksPerView) * ROWS_PER_TASK;
+        int i1 = std::min(i0 + ROWS_PER_TASK, height);
+        unprojectRange(k, i0 * width, i1 * width, depth_images[k] + i0 * width,
+                points + (k * height + i0) * width);
+    });
+}
+
+void VolumeUnprojector::unprojectRows(int view, int i0, int i1, const float *depth, glm::vec3 *points) const {
+    int numBlocks = (i1 - i0 + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    parallel_for(0, numBlocks, [&](int block) {
+        int r0 = i0 + block * ROWS_PER_TASK;
+        int r1 = std::min(r0 + ROWS_PER_TASK, i1);
+        unprojectRange(view, r0 * width, r1 * width, depth + r0 * width, points + (r0 - i0) * width);
+    });
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   volume_unprojector.hpp
+ *
+ * Converts the reversed-Z depth images of a visibility volume back to world
+ * space points. With the infinite projection of MakeInfReversedZProjRH the
+ * inverse of view * projection collapses to
+ *
+ *     p = origin + (zNear / depth) * dir
+ *
+ * where dir is the world space direction through the pixel center with unit
+ * eye space depth, so the per face matrices reduce to a table of directions
+ * computed once per volume. The radius and height limits of the volume are
+ * applied as in the original per pixel code, without the trigonometric
+ * round trip through spherical coordinates: a point beyond radius_max is
+ * scaled back onto the sphere.
+ */
+
+#ifndef VOLUME_UNPROJECTOR_HPP
+#define VOLUME_UNPROJECTOR_HPP
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+class VolumeUnprojector {
+public:
+    VolumeUnprojector();
+
+    // direction tables of every face, rows bottom to top like the depth images.
+    // Without tables the directions are computed for each block of rows as it
+    // is unprojected, which keeps memory independent of the face size.
+    void setupRays(const glm::mat4 *views, int numViews, float fovY_radians, float aspectWbyH,
+            int width, int height, bool tables = true);
+
+    // depth_min bounds the range at zNear / depth_min. Points whose distance
+    // from origin measured in the world coordinate system (basis columns
+    // front, up, other) exceeds radius_max are scaled back to radius_max, and
+    // the height dot(p - wcs_origin, wcs_up) is clamped to [up_min, up_max]
+    // by shifting along up.
+    void setLimits(const glm::vec3& origin, float zNear, float depth_min,
+            const glm::mat3& wcs_basis, float radius_max,
+            const glm::vec3& wcs_origin, const glm::vec3& wcs_up,
+            const glm::vec3& up, float up_min, float up_max);
+
+    // unproject all pixels of all faces, points[(k * height + i) * width + j]
+    void unproject(const float * const *depth_images, glm::vec3 *points) const;
+
+    // rows [i0, i1) of face view, points[(i - i0) * width + j]
+    void unprojectRows(int view, int i0, int i1, const float *depth, glm::vec3 *points) const;
+
+    // single pixel version of unproject()
+    glm::vec3 unprojectPixel(int view, int pixel, float depth) const;
+
+    // point at depth along a direction with unit eye space depth, limits applied
+    glm::vec3 unprojectDirection(const glm::vec3& dir, float depth) const;
+
+    // the face that sees world direction d best and the continuous pixel
+    // coordinates (pixel centers at integer + 0.5) of d in that face. scale
+    // converts d to the unit eye depth direction of the face, dir = scale * d.
+    // Directions falling in a gap between faces (fov < 90) are snapped to the
+    // border of the nearest face.
+    void locate(const glm::vec3& d, int& view, float& x, float& y, float& scale) const;
+
+    // depth at continuous pixel coordinates: bilinear across surfaces, nearest
+    // pixel across silhouettes so background never blends into geometry
+    float sampleDepth(const float * const *depth_images, int view, float x, float y) const;
+
+    // radial distance of p from the boundary of the volume, positive inside:
+    // the range of the surface seen in the direction of p less that of p,
+    // bounded by the distances to the radius and height limits
+    float signedRange(const float * const *depth_images, const glm::vec3& p) const;
+
+    glm::vec3 direction(int view, int pixel) const {
+        if (dirX.empty()) {
+            return rotations[view] * eyeDirection(pixel);
+        }
+        int idx = view * faceStride + pixel;
+        return glm::vec3(dirX[idx], dirY[idx], dirZ[idx]);
+    }
+
+    // direction with unit eye space depth at continuous pixel coordinates
+    glm::vec3 direction(int view, float x, float y) const {
+        return rotations[view] * glm::vec3((2.0f * x / width - 1.0f) * aspect / focal,
+                (2.0f * y / height - 1.0f) / focal, -1.0f);
+    }
+
+    const glm::vec3& rayOrigin() const {
+        return origin;
+    }
+
+    float nearPlane() const {
+        return zNear;
+    }
+
+    float minDepth() const {
+        return depth_min;
+    }
+
+    // camera to world rotation of a face
+    const glm::mat3& rotation(int view) const {
+        return rotations[view];
+    }
+
+    int numViews, width, height;
+
+private:
+    // copies the face rotations, projection and limits
+    friend class RangeCubeMap;
+
+    // pixels [begin, end) of a face, depth and points indexed from begin
+    void unprojectRange(int view, int begin, int end, const float *depth, glm::vec3 *points) const;
+
+    void unprojectRange(const float *dx, const float *dy, const float *dz, int count,
+            const float *depth, glm::vec3 *points) const;
+
+    // pixel center direction in eye space with unit depth
+    glm::vec3 eyeDirection(int pixel) const {
+        int i = pixel / width, j = pixel % width;
+        return glm::vec3((2.0f * (j + 0.5f) / width - 1.0f) * aspect / focal,
+                (2.0f * (i + 0.5f) / height - 1.0f) / focal, -1.0f);
+    }
+
+    // camera to world rotation of every face and the projection scales
+    std::vector<glm::mat3> rotations;
+    float focal, aspect;
+
+    // structure of arrays, faces start at multiples of 4 pixels
+    int faceStride;
+    std::vector<float> dirX, dirY, dirZ;
+
+    glm::vec3 origin;
+    float zNear, depth_min;
+    glm::mat3 wcs_basis;
+    // (wcs_basis - I) * origin, the world frame offset of the ray origin
+    glm::vec3 wcs_offset;
+    float radius_max;
+    glm::vec3 wcs_origin, wcs_up, up;
+    float up_min, up_max;
+};
+
+#endif /* VOLUME_UNPROJECTOR_HPP */
+
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "voxel_grid.hpp"
+#include "binary_io.hpp"
+#include "parallel.hpp"
+#include "simd4.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// bricks voxelized or combined by one task
+static const int BRICKS_PER_TASK = 64;
+
+static const int BRICK_VOXELS = VoxelGrid::BRICK_SIZE * VoxelGrid::BRICK_SIZE * VoxelGrid::BRICK_SIZE;
+
+static inline int popcount64(uint64_t w) {
+#if defined(__GNUC__)
+    return __builtin_popcountll(w);
+#else
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int) ((w * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// out = a & b, two 64 bit words per SSE2 register
+static inline void andBrick(const VoxelGrid::Brick& a, const VoxelGrid::Brick& b, VoxelGrid::Brick& out) {
+#ifdef SIMD4_SSE
+    for (int w = 0; w < VoxelGrid::BRICK_WORDS; w += 2) {
+        _mm_store_si128((__m128i *) &out.words[w], _mm_and_si128(_mm_load_si128((const __m128i *) &a.words[w]),
+                _mm_load_si128((const __m128i *) &b.words[w])));
+    }
+#else
+    for (int w = 0; w < VoxelGrid::BRICK_WORDS; w++) {
+        out.words[w] = a.words[w] & b.words[w];
+    }
+#endif
+}
+
+static inline void orBrick(VoxelGrid::Brick& a, const VoxelGrid::Brick& b) {
+#ifdef SIMD4_SSE
+    for (int w = 0; w < VoxelGrid::BRICK_WORDS; w += 2) {
+        _mm_store_si128((__m128i *) &a.words[w], _mm_or_si128(_mm_load_si128((const __m128i *) &a.words[w]),
+                _mm_load_si128((const __m128i *) &b.words[w])));
+    }
+#else
+    for (int w = 0; w < VoxelGrid::BRICK_WORDS; w++) {
+        a.words[w] |= b.words[w];
+    }
+#endif
+}
+
+static inline int popcountBrick(const VoxelGrid::Brick& brick) {
+    int count = 0;
+    for (int w = 0; w < VoxelGrid::BRICK_WORDS; w++) {
+        count += popcount64(brick.words[w]);
+    }
+    return count;
+}
+
+static inline bool emptyBrick(const VoxelGrid::Brick& brick) {
+    uint64_t any = 0;
+    for (int w = 0; w < VoxelGrid::BRICK_WORDS; w++) {
+        any |= brick.words[w];
+    }
+    return any == 0;
+}
+
+// brick of a voxel coordinate, rounding towards -infinity
+static inline int brickOf(int v) {
+    return (v >= 0) ? v / VoxelGrid::BRICK_SIZE : -((VoxelGrid::BRICK_SIZE - 1 - v) / VoxelGrid::BRICK_SIZE);
+}
+
+// a voxel of a brick, bit x + 8 y of word z
+static inline bool testBit(const VoxelGrid::Brick& brick, int x, int y, int z) {
+    return (brick.words[z] >> (x + VoxelGrid::BRICK_SIZE * y)) & 1;
+}
+
+VoxelGrid::VoxelGrid() : origin(0.0f), basis(1.0f), voxelSize(1.0f) {
+}
+
+void VoxelGrid::setup(const glm::vec3& grid_origin, const glm::mat3& grid_basis, float size) {
+    origin = grid_origin;
+    basis = grid_basis;
+    voxelSize = size;
+    bricks.clear();
+    keys.clear();
+    index.clear();
+}
+
+bool VoxelGrid::sameFrame(const VoxelGrid& other) const {
+    return origin == other.origin && basis == other.basis && voxelSize == other.voxelSize;
+}
+
+uint64_t VoxelGrid::packKey(int x, int y, int z) {
+    const uint64_t mask = ((uint64_t) 1 << 21) - 1;
+    return ((uint64_t) (x + VOXEL_LIMIT) & mask) | (((uint64_t) (y + VOXEL_LIMIT) & mask) << 21) |
+            (((uint64_t) (z + VOXEL_LIMIT) & mask) << 42);
+}
+
+glm::ivec3 VoxelGrid::unpackKey(uint64_t key) {
+    const uint64_t mask = ((uint64_t) 1 << 21) - 1;
+    return glm::ivec3((int) (key & mask) - VOXEL_LIMIT, (int) ((key >> 21) & mask) - VOXEL_LIMIT,
+            (int) ((key >> 42) & mask) - VOXEL_LIMIT);
+}
+
+int VoxelGrid::findBrick(int bx, int by, int bz) const {
+    std::unordered_map<uint64_t, int>::const_iterator it = index.find(packKey(bx, by, bz));
+    return (it == index.end()) ? -1 : it->second;
+}
+
+void VoxelGrid::addBrick(uint64_t key, const Brick& brick) {
+    std::unordered_map<uint64_t, int>::iterator it = index.find(key);
+    if (it != index.end()) {
+        orBrick(bricks[it->second], brick);
+        return;
+    }
+    index[key] = (int) bricks.size();
+    bricks.push_back(brick);
+    keys.push_back(key);
+}
+
+bool VoxelGrid::test(int x, int y, int z) const {
+    int bx = brickOf(x), by = brickOf(y), bz = brickOf(z);
+    int b = findBrick(bx, by, bz);
+    return b >= 0 && testBit(bricks[b], x - BRICK_SIZE * bx, y - BRICK_SIZE * by, z - BRICK_SIZE * bz);
+}
+
+void VoxelGrid::set(int x, int y, int z) {
+    int bx = brickOf(x), by = brickOf(y), bz = brickOf(z);
+    Brick brick;
+    memset(&brick, 0, sizeof (brick));
+    int lx = x - BRICK_SIZE * bx, ly = y - BRICK_SIZE * by, lz = z - BRICK_SIZE * bz;
+    brick.words[lz] = (uint64_t) 1 << (lx + BRICK_SIZE * ly);
+    addBrick(packKey(bx, by, bz), brick);
+}
+
+bool VoxelGrid::voxelize(const RangeCubeMap& map, const glm::vec3& lo, const glm::vec3& hi) {
+    // the box in voxel units of the grid frame, basis is orthonormal
+    glm::mat3 toGrid = glm::transpose(basis);
+    glm::vec3 vmin(FLT_MAX), vmax(-FLT_MAX);
+    for (int c = 0; c < 8; c++) {
+        glm::vec3 corner((c & 1) ? hi.x : lo.x, (c & 2) ? hi.y : lo.y, (c & 4) ? hi.z : lo.z);
+        glm::vec3 v = toGrid * (corner - origin) / voxelSize;
+        vmin = glm::min(vmin, v);
+        vmax = glm::max(vmax, v);
+    }
+    // voxels whose center (v + 0.5) lies in the box
+    glm::vec3 first = glm::ceil(vmin - 0.5f), last = glm::floor(vmax - 0.5f);
+    for (int a = 0; a < 3; a++) {
+        if (!(first[a] >= -VOXEL_LIMIT && last[a] < VOXEL_LIMIT)) {
+            std::cout << "Visibility volume exceeds the voxel grid range, choose a larger voxel size." << std::endl;
+            return false;
+        }
+    }
+    glm::ivec3 b0(brickOf((int) first.x), brickOf((int) first.y), brickOf((int) first.z));
+    glm::ivec3 b1(brickOf((int) last.x), brickOf((int) last.y), brickOf((int) last.z));
+    glm::ivec3 extent = glm::max(b1 - b0 + 1, glm::ivec3(0));
+    size_t numBoxBricks = (size_t) extent.x * extent.y * extent.z;
+    if (numBoxBricks > MAX_BOX_BRICKS) {
+        std::cout << "Voxelizing a volume of " << numBoxBricks << " bricks exceeds the limit of " << MAX_BOX_BRICKS
+                << " bricks, choose a larger voxel size." << std::endl;
+        return false;
+    }
+
+    // occupied bricks of every task, merged in box order
+    int numTasks = (int) ((numBoxBricks + BRICKS_PER_TASK - 1) / BRICKS_PER_TASK);
+    std::vector<std::vector<uint64_t> > taskKeys(numTasks);
+    std::vector<std::vector<Brick> > taskBricks(numTasks);
+    parallel_for(0, numTasks, [&](int task) {
+        std::vector<glm::vec3> centers(BRICK_VOXELS);
+        std::vector<uint8_t> inside(BRICK_VOXELS);
+        size_t end = std::min((size_t) (task + 1) * BRICKS_PER_TASK, numBoxBricks);
+        for (size_t n = (size_t) task * BRICKS_PER_TASK; n < end; n++) {
+            glm::ivec3 b = b0 + glm::ivec3((int) (n % extent.x), (int) ((n / extent.x) % extent.y),
+                    (int) (n / ((size_t) extent.x * extent.y)));
+            for (int v = 0; v < BRICK_VOXELS; v++) {
+                glm::ivec3 voxel = BRICK_SIZE * b + glm::ivec3(v % BRICK_SIZE, (v / BRICK_SIZE) % BRICK_SIZE,
+                        v / (BRICK_SIZE * BRICK_SIZE));
+                centers[v] = toWorld(glm::vec3(voxel) + 0.5f);
+            }
+            map.classify(&centers[0], BRICK_VOXELS, &inside[0]);
+            Brick brick;
+            for (int w = 0; w < BRICK_WORDS; w++) {
+                uint64_t word = 0;
+                for (int bit = 0; bit < 64; bit++) {
+                    word |= (uint64_t) (inside[64 * w + bit] != 0) << bit;
+                }
+                brick.words[w] = word;
+            }
+            if (!emptyBrick(brick)) {
+                taskKeys[task].push_back(packKey(b.x, b.y, b.z));
+                taskBricks[task].push_back(brick);
+            }
+        }
+    });
+    for (int task = 0; task < numTasks; task++) {
+        for (size_t n = 0; n < taskKeys[task].size(); n++) {
+            addBrick(taskKeys[task][n], taskBricks[task][n]);
+        }
+    }
+    return true;
+}
+
+void VoxelGrid::unite(const VoxelGrid& other) {
+    for (size_t n = 0; n < other.bricks.size(); n++) {
+        addBrick(other.keys[n], other.bricks[n]);
+    }
+}
+
+void VoxelGrid::intersect(const VoxelGrid& other) {
+    int numTasks = (int) ((bricks.size() + BRICKS_PER_TASK - 1) / BRICKS_PER_TASK);
+    parallel_for(0, numTasks, [&](int task) {
+        size_t end = std::min((size_t) (task + 1) * BRICKS_PER_TASK, bricks.size());
+        for (size_t n = (size_t) task * BRICKS_PER_TASK; n < end; n++) {
+            std::unordered_map<uint64_t, int>::const_iterator it = other.index.find(keys[n]);
+            if (it == other.index.end()) {
+                memset(&bricks[n], 0, sizeof (Brick));
+            } else {
+                andBrick(bricks[n], other.bricks[it->second], bricks[n]);
+            }
+        }
+    });
+    // drop the bricks left empty
+    size_t kept = 0;
+    index.clear();
+    for (size_t n = 0; n < bricks.size(); n++) {
+        if (!emptyBrick(bricks[n])) {
+            bricks[kept] = bricks[n];
+            keys[kept] = keys[n];
+            index[keys[kept]] = (int) kept;
+            kept++;
+        }
+    }
+    bricks.resize(kept);
+    keys.resize(kept);
+}
+
+uint64_t VoxelGrid::count() const {
+    int numTasks = (int) ((bricks.size() + BRICKS_PER_TASK - 1) / BRICKS_PER_TASK);
+    std::vector<uint64_t> counts(numTasks, 0);
+    parallel_for(0, numTasks, [&](int task) {
+        size_t end = std::min((size_t) (task + 1) * BRICKS_PER_TASK, bricks.size());
+        for (size_t n = (size_t) task * BRICKS_PER_TASK; n < end; n++) {
+            counts[task] += popcountBrick(bricks[n]);
+        }
+    });
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+        total += c;
+    }
+    return total;
+}
+
+uint64_t VoxelGrid::countIntersection(const VoxelGrid& a, const VoxelGrid& b) {
+    // look up the bricks of the smaller grid in the larger one
+    const VoxelGrid& small = (a.bricks.size() <= b.bricks.size()) ? a : b;
+    const VoxelGrid& large = (&small == &a) ? b : a;
+    int numTasks = (int) ((small.bricks.size() + BRICKS_PER_TASK - 1) / BRICKS_PER_TASK);
+    std::vector<uint64_t> counts(numTasks, 0);
+    parallel_for(0, numTasks, [&](int task) {
+        size_t end = std::min((size_t) (task + 1) * BRICKS_PER_TASK, small.bricks.size());
+        Brick common;
+        for (size_t n = (size_t) task * BRICKS_PER_TASK; n < end; n++) {
+            std::unordered_map<uint64_t, int>::const_iterator it = large.index.find(small.keys[n]);
+            if (it != large.index.end()) {
+                andBrick(small.bricks[n], large.bricks[it->second], common);
+                counts[task] += popcountBrick(common);
+            }
+        }
+    });
+    uint64_t total = 0;
+    for (uint64_t c : counts) {
+        total += c;
+    }
+    return total;
+}
+
+void VoxelGrid::extractSurface(VolumeMesh& mesh) const {
+    mesh.clear();
+    // surface nets vertex of every grid cell met, keyed by its lowest corner voxel
+    std::unordered_map<uint64_t, unsigned int> cellVertex;
+    const int PADDED = BRICK_SIZE + 2;
+    std::vector<uint8_t> occupied(PADDED * PADDED * PADDED);
+    for (size_t n = 0; n < bricks.size(); n++) {
+        glm::ivec3 b = unpackKey(keys[n]);
+        // the brick and a one voxel shell from its neighbours, padded index p = local + 1
+        const Brick *neighbours[27];
+        for (int k = 0; k < 27; k++) {
+            int found = findBrick(b.x + k % 3 - 1, b.y + (k / 3) % 3 - 1, b.z + k / 9 - 1);
+            neighbours[k] = (found >= 0) ? &bricks[found] : nullptr;
+        }
+        for (int p = 0; p < PADDED * PADDED * PADDED; p++) {
+            int l[3] = {p % PADDED - 1, (p / PADDED) % PADDED - 1, p / (PADDED * PADDED) - 1};
+            int k = 0, scale = 1;
+            for (int a = 0; a < 3; a++, scale *= 3) {
+                int offset = (l[a] < 0) ? 0 : ((l[a] >= BRICK_SIZE) ? 2 : 1);
+                k += offset * scale;
+                l[a] -= (offset - 1) * BRICK_SIZE;
+            }
+            occupied[p] = neighbours[k] != nullptr && testBit(*neighbours[k], l[0], l[1], l[2]);
+        }
+        auto at = [&](const glm::ivec3& local) {
+            return occupied[((local.z + 1) * PADDED + local.y + 1) * PADDED + local.x + 1] != 0;
+        };
+        auto vertex = [&](const glm::ivec3& cell) {
+            glm::ivec3 global = BRICK_SIZE * b + cell;
+            uint64_t key = packKey(global.x, global.y, global.z);
+            std::unordered_map<uint64_t, unsigned int>::iterator it = cellVertex.find(key);
+            if (it != cellVertex.end()) {
+                return it->second;
+            }
+            // mean of the midpoints of the cell edges whose ends differ
+            glm::vec3 sum(0.0f);
+            int crossings = 0;
+            for (int c = 0; c < 8; c++) {
+                glm::ivec3 corner(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+                for (int a = 0; a < 3; a++) {
+                    if (corner[a] == 0) {
+                        glm::ivec3 other = corner;
+                        other[a] = 1;
+                        if (at(cell + corner) != at(cell + other)) {
+                            sum += glm::vec3(corner + other) * 0.5f;
+                            crossings++;
+                        }
+                    }
+                }
+            }
+            unsigned int v = (unsigned int) mesh.vertices.size();
+            mesh.vertices.push_back(toWorld(glm::vec3(global) + 0.5f + sum / (float) crossings));
+            cellVertex[key] = v;
+            return v;
+        };
+        for (int z = 0; z < BRICK_SIZE; z++) {
+            for (int y = 0; y < BRICK_SIZE; y++) {
+                for (int x = 0; x < BRICK_SIZE; x++) {
+                    glm::ivec3 voxel(x, y, z);
+                    if (!at(voxel)) {
+                        continue;
+                    }
+                    for (int a = 0; a < 3; a++) {
+                        int a1 = (a + 1) % 3, a2 = (a + 2) % 3;
+                        for (int side = -1; side <= 1; side += 2) {
+                            glm::ivec3 step(0);
+                            step[a] = side;
+                            if (at(voxel + step)) {
+                                continue;
+                            }
+                            // the four cells around the edge to the empty neighbour,
+                            // counter-clockwise seen from +a
+                            glm::ivec3 cell = voxel;
+                            cell[a] += (side < 0) ? -1 : 0;
+                            glm::ivec3 d1(0), d2(0);
+                            d1[a1] = 1;
+                            d2[a2] = 1;
+                            unsigned int q[4] = {vertex(cell - d1 - d2), vertex(cell - d2), vertex(cell),
+                                vertex(cell - d1)};
+                            if (side > 0) {
+                                mesh.triangles.push_back(glm::u32vec3(q[0], q[1], q[2]));
+                                mesh.triangles.push_back(glm::u32vec3(q[0], q[2], q[3]));
+                            } else {
+                                mesh.triangles.push_back(glm::u32vec3(q[0], q[2], q[1]));
+                                mesh.triangles.push_back(glm::u32vec3(q[0], q[3], q[2]));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool VoxelGrid::write(const std::string& filename) const {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr) {
+        std::cout << "Could not open " << filename << " for writing." << std::endl;
+        return false;
+    }
+    float frame[13] = {voxelSize, origin.x, origin.y, origin.z};
+    memcpy(&frame[4], &basis[0][0], 9 * sizeof (float));
+    uint32_t numBricks = (uint32_t) bricks.size();
+    bool ok = fwrite("OGLVBM1\n", 1, 8, file) == 8 && writeWordsLE(file, frame, 13) && writeWordsLE(file, &numBricks, 1);
+    for (size_t n = 0; ok && n < bricks.size(); n++) {
+        glm::ivec3 b = unpackKey(keys[n]);
+        uint32_t record[3 + 2 * BRICK_WORDS] = {(uint32_t) b.x, (uint32_t) b.y, (uint32_t) b.z};
+        for (int w = 0; w < BRICK_WORDS; w++) {
+            record[3 + 2 * w] = (uint32_t) bricks[n].words[w];
+            record[4 + 2 * w] = (uint32_t) (bricks[n].words[w] >> 32);
+        }
+        ok = writeWordsLE(file, record, 3 + 2 * BRICK_WORDS);
+    }
+    if (fclose(file) != 0 || !ok) {
+        std::cout << "Error writing " << filename << "." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool VoxelGrid::read(const std::string& filename) {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        std::cout << "Could not open " << filename << "." << std::endl;
+        return false;
+    }
+    char magic[8];
+    float frame[13];
+    uint32_t numBricks = 0;
+    bool ok = fread(magic, 1, 8, file) == 8 && memcmp(magic, "OGLVBM1\n", 8) == 0 &&
+            readWordsLE(file, frame, 13) && readWordsLE(file, &numBricks, 1);
+    if (ok) {
+        glm::mat3 frameBasis;
+        memcpy(&frameBasis[0][0], &frame[4], 9 * sizeof (float));
+        setup(glm::vec3(frame[1], frame[2], frame[3]), frameBasis, frame[0]);
+    }
+    for (uint32_t n = 0; ok && n < numBricks; n++) {
+        uint32_t record[3 + 2 * BRICK_WORDS];
+        ok = readWordsLE(file, record, 3 + 2 * BRICK_WORDS);
+        if (!ok) {
+            break;
+        }
+        Brick brick;
+        for (int w = 0; w < BRICK_WORDS; w++) {
+            brick.words[w] = record[3 + 2 * w] | ((uint64_t) record[4 + 2 * w] << 32);
+        }
+        addBrick(packKey((int32_t) record[0], (int32_t) record[1], (int32_t) record[2]), brick);
+    }
+    fclose(file);
+    if (!ok) {
+        std::cout << "Error reading voxel grid " << filename << "." << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   voxel_grid.hpp
+ *
+ * Sparse voxel bitset of visibility volumes for set operations across many
+ * observers without mesh CSG. Voxels of side voxelSize are aligned with a
+ * world frame (origin plus the front, up, other basis of a
+ * YAML_CoordinateSystem), so the grids of all volumes of a config share one
+ * lattice. Occupied voxels are stored in bricks of 8 x 8 x 8 bits, 64 bytes
+ * each, looked up by brick coordinate; empty bricks are not stored.
+ *
+ * A volume is voxelized by classifying the voxel centers of every brick in
+ * its bounding box with its RangeCubeMap, bricks in parallel. Union,
+ * intersection and counting work brick by brick on SSE2 words with a
+ * popcount per 64 bit word. extractSurface() meshes the occupied voxels
+ * with surface nets, the dual of marching cubes: one vertex per grid cell
+ * with mixed corners, at the mean of the crossing edge midpoints, and one
+ * quad per pair of neighbouring voxels of which only one is set.
+ *
+ * write() stores the grid as a little endian binary file:
+ *
+ *     char     magic[8]     "OGLVBM1\n"
+ *     float32  voxel_size, origin[3], basis[3][3]   basis column major
+ *     uint32   num_bricks
+ *     num_bricks x { int32 brick[3]; uint32 words[16] }
+ *
+ * Bit (x + 8 * y + 64 * z) of a brick, counted from the low bit of the first
+ * word, is voxel 8 * brick + (x, y, z), centered at
+ * origin + basis * (voxel + 0.5) * voxel_size.
+ */
+
+#ifndef VOXEL_GRID_HPP
+#define VOXEL_GRID_HPP
+
+#include "range_cube_map.hpp"
+#include "volume_mesh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class VoxelGrid {
+public:
+    // voxels along each side of a brick
+    static const int BRICK_SIZE = 8;
+    static const int BRICK_WORDS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE / 64;
+    // largest bounding box voxelize() accepts, 2^24 bricks
+    static const size_t MAX_BOX_BRICKS = (size_t) 1 << 24;
+    // voxel coordinates span [-VOXEL_LIMIT, VOXEL_LIMIT) on every axis
+    static const int VOXEL_LIMIT = 1 << 20;
+
+    struct Brick {
+        alignas(16) uint64_t words[BRICK_WORDS];
+    };
+
+    VoxelGrid();
+
+    // empty grid, basis columns are the unit front, up and other axes
+    void setup(const glm::vec3& origin, const glm::mat3& basis, float voxelSize);
+
+    // same lattice, which the set operations require
+    bool sameFrame(const VoxelGrid& other) const;
+
+    // sets every voxel whose center lies inside the volume of map, which the
+    // world box [lo, hi] bounds; false when the box exceeds MAX_BOX_BRICKS
+    // or the voxel coordinate range
+    bool voxelize(const RangeCubeMap& map, const glm::vec3& lo, const glm::vec3& hi);
+
+    bool test(int x, int y, int z) const;
+
+    void set(int x, int y, int z);
+
+    // this = this | other
+    void unite(const VoxelGrid& other);
+
+    // this = this & other
+    void intersect(const VoxelGrid& other);
+
+    // number of voxels set
+    uint64_t count() const;
+
+    // number of voxels set in both grids, without building the intersection
+    static uint64_t countIntersection(const VoxelGrid& a, const VoxelGrid& b);
+
+    size_t numBricks() const {
+        return bricks.size();
+    }
+
+    // world volume of one voxel
+    double voxelVolume() const {
+        return (double) voxelSize * voxelSize * voxelSize;
+    }
+
+    // closed surface around the occupied voxels in world coordinates, non
+    // manifold where two voxels touch along an edge only
+    void extractSurface(VolumeMesh& mesh) const;
+
+    // false when the file could not be written or read
+    bool write(const std::string& filename) const;
+    bool read(const std::string& filename);
+
+    glm::vec3 origin;
+    glm::mat3 basis;
+    float voxelSize;
+
+private:
+    // 21 bits per axis, for bricks and voxels alike
+    static uint64_t packKey(int x, int y, int z);
+
+    static glm::ivec3 unpackKey(uint64_t key);
+
+    // index into bricks, -1 when the brick is empty
+    int findBrick(int bx, int by, int bz) const;
+
+    // appends a brick, or ORs into an existing one
+    void addBrick(uint64_t key, const Brick& brick);
+
+    // world position of a point in voxel units
+    glm::vec3 toWorld(const glm::vec3& voxel) const {
+        return origin + basis * (voxel * voxelSize);
+    }
+
+    std::vector<Brick> bricks;
+    std::vector<uint64_t> keys;
+    std::unordered_map<uint64_t, int> index;
+};
+
+#endif /* VOXEL_GRID_HPP */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   test_coverage_raster.cpp
+ *
+ * Coverage of several observers on a 4 thread pool, where each sweep of the
+ * parallel loop over observers nests the parallel octant sweep of
+ * HeightfieldViewshed. The counts and first observers must match viewsheds
+ * computed one at a time outside any parallel loop.
+ */
+
+#include "coverage_raster.hpp"
+#include "heightfield_viewshed.hpp"
+#include "heightmap.hpp"
+#include "parallel.hpp"
+#include "scene_geometry.hpp"
+#include "test_scenes.hpp"
+
+#include <iostream>
+#include <vector>
+
+int main() {
+    ThreadPool::setNumThreads(4);
+    SceneGeometry scene;
+    addBox(scene, glm::vec3(-64.0f, -1.0f, -64.0f), glm::vec3(64.0f, 0.0f, 64.0f));
+    for (int b = 0; b < 24; b++) {
+        float x = -56.0f + 37.0f * b - 112.0f * (b / 3), z = -50.0f + 13.0f * (b % 9);
+        addBox(scene, glm::vec3(x, 0.0f, z), glm::vec3(x + 4.0f + b % 5, 3.0f + 2.0f * (b % 4), z + 6.0f));
+    }
+    Heightmap map;
+    if (!map.build(scene, 1.0f)) {
+        std::cout << "heightmap build failed" << std::endl;
+        return 1;
+    }
+    std::vector<glm::vec3> origins;
+    std::vector<float> radii;
+    // enough observers that the calling thread sweeps some of them itself
+    for (int k = 0; k < 64; k++) {
+        origins.push_back(glm::vec3(-60.0f + 1.9f * k, 2.0f + (k % 3), 60.0f - 1.7f * k));
+        radii.push_back(30.0f + k);
+    }
+    const float targetHeight = 0.5f;
+    CoverageRaster coverage;
+    coverage.accumulate(map, origins.data(), radii.data(), (int) origins.size(), targetHeight, true);
+
+    std::vector<uint32_t> counts((size_t) map.rows * map.columns, 0);
+    std::vector<int32_t> first(counts.size(), CoverageRaster::NO_OBSERVER);
+    for (size_t k = 0; k < origins.size(); k++) {
+        HeightfieldViewshed viewshed;
+        viewshed.compute(map, origins[k], radii[k]);
+        for (int i = 0; i < map.rows; i++) {
+            for (int j = 0; j < map.columns; j++) {
+                if (viewshed.visible(i, j, targetHeight)) {
+                    size_t cell = (size_t) i * map.columns + j;
+                    counts[cell]++;
+                    if (first[cell] == CoverageRaster::NO_OBSERVER) {
+                        first[cell] = (int32_t) k;
+                    }
+                }
+            }
+        }
+    }
+    if (coverage.counts != counts || coverage.first != first) {
+        std::cout << "coverage differs from the serial viewsheds" << std::endl;
+        return 1;
+    }
+    size_t seen = 0;
+    for (uint32_t c : counts) {
+        seen += (c > 0);
+    }
+    if (seen == 0) {
+        std::cout << "no cell is seen" << std::endl;
+        return 1;
+    }
+    std::cout << "coverage of " << origins.size() << " observers matches, " << seen << " cells seen" << std::endl;
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   test_float_format.cpp
+ *
+ * format_float must read back to the same bits (sign of zero included) and
+ * use no more significant digits than the shortest "%.*e" that round trips.
+ * Checked on edge values (denormals, powers of two, FLT_MAX, -0) and on a
+ * stride through all positive and negative finite floats.
+ */
+
+#include "float_format.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// significant decimal digits of a formatted number
+static int significantDigits(const std::string& text) {
+    std::string digits;
+    for (size_t i = 0; i < text.size() && text[i] != 'e'; i++) {
+        if (text[i] >= '0' && text[i] <= '9') {
+            digits += text[i];
+        }
+    }
+    size_t first = digits.find_first_not_of('0');
+    if (first == std::string::npos) {
+        return 1;
+    }
+    size_t last = digits.find_last_not_of('0');
+    return (int) (last - first + 1);
+}
+
+// fewest significant digits of any decimal that reads back to value
+static int shortestDigits(float value) {
+    char buffer[64];
+    for (int precision = 1; precision < 9; precision++) {
+        snprintf(buffer, sizeof (buffer), "%.*e", precision - 1, value);
+        if (strtof(buffer, nullptr) == value) {
+            return precision;
+        }
+    }
+    return 9;
+}
+
+// false, with a message, unless value is formatted as required
+static bool check(float value) {
+    char buffer[64];
+    char *end = format_float(buffer, value);
+    std::string text(buffer, end);
+    if (end - buffer > FLOAT_FORMAT_MAX_CHARS) {
+        std::cout << text << " is longer than " << FLOAT_FORMAT_MAX_CHARS << " characters" << std::endl;
+        return false;
+    }
+    float back = strtof(text.c_str(), nullptr);
+    if (memcmp(&back, &value, sizeof (float)) != 0) {
+        std::cout << text << " does not read back to " << std::hexfloat << value << std::defaultfloat << std::endl;
+        return false;
+    }
+    if (significantDigits(text) > shortestDigits(value)) {
+        std::cout << text << " has more than the " << shortestDigits(value) << " digits needed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static float fromBits(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof (float));
+    return value;
+}
+
+int main() {
+    std::vector<float> edges = {
+        0.0f, -0.0f, FLT_MIN, -FLT_MIN, FLT_MAX, -FLT_MAX, FLT_EPSILON, 1.0f, -1.0f,
+        // denormals: smallest, largest and a few between
+        fromBits(1), fromBits(2), fromBits(3), fromBits(0x007fffff), fromBits(0x00400000), fromBits(0x80000001),
+        // neighbours of FLT_MAX and FLT_MIN
+        fromBits(0x7f7ffffe), fromBits(0x00800001), fromBits(0x007ffffe),
+        // values close to the fixed and scientific switch and to the snprintf fallback
+        1e-5f, 9.99999e-6f, 1e8f, 99999999.0f, 1e9f, 1e-11f, 1e25f, 1e-12f, 1e26f,
+        0.1f, 0.3f, 16777216.0f, 16777217.0f, 123456789.0f, 1.5e-7f, 3.4028235e38f
+    };
+    // every power of two and its neighbours
+    for (int e = -149; e <= 127; e++) {
+        float p = std::ldexp(1.0f, e);
+        edges.push_back(p);
+        edges.push_back(-p);
+        edges.push_back(std::nextafter(p, 0.0f));
+        edges.push_back(std::nextafter(p, FLT_MAX));
+    }
+    int failures = 0;
+    for (float value : edges) {
+        failures += !check(value);
+    }
+    // a stride through all finite floats of both signs
+    const uint32_t STRIDE = 9973;
+    size_t checked = edges.size();
+    for (uint64_t bits = 0; bits < 0x7f800000u && failures < 20; bits += STRIDE) {
+        failures += !check(fromBits((uint32_t) bits));
+        failures += !check(fromBits((uint32_t) bits | 0x80000000u));
+        checked += 2;
+    }
+    if (failures > 0) {
+        std::cout << failures << " values formatted wrongly" << std::endl;
+        return 1;
+    }
+    std::cout << checked << " values are shortest and round trip" << std::endl;
+    return 0;
+}
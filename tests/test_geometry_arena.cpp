@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   test_geometry_arena.cpp
+ *
+ * The arena must hold the same world geometry the per-mesh path draws, where
+ * the vertex shader applies the "model" matrix and the divide by w follows.
+ * The triangles are read back through the compacted draw commands, the way
+ * glMultiDrawElementsIndirect reads them, and their corners are compared
+ * with the placement written out by hand. No OpenGL context is needed, the
+ * arena is not uploaded.
+ */
+
+#include "geometry_arena.hpp"
+#include "test_scenes.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+int main() {
+    // a translation as YAML_Object3D::getTransform stores it, in the w row,
+    // next to an ordinary one in the last column
+    const glm::vec3 translation(1.0f, 2.0f, -3.0f);
+    const float wx = 0.01f, wz = -0.02f;
+    glm::mat4 xform(1.0f);
+    xform[3] = glm::vec4(translation, 1.0f);
+    xform[0][3] = wx;
+    xform[2][3] = wz;
+
+    // two boxes around a mesh with vertices but no triangles
+    std::vector<std::vector<glm::vec3> > positions(3);
+    std::vector<std::vector<unsigned int> > indices(3);
+    boxMesh(glm::vec3(-4.0f, -1.0f, -12.0f), glm::vec3(4.0f, 3.0f, -8.0f), positions[0], indices[0]);
+    positions[1].push_back(glm::vec3(5.0f, 0.0f, -6.0f));
+    positions[1].push_back(glm::vec3(6.0f, 1.0f, -6.0f));
+    boxMesh(glm::vec3(-20.0f, -2.0f, -30.0f), glm::vec3(20.0f, -1.0f, 0.0f), positions[2], indices[2]);
+    GeometryArena arena;
+    for (size_t m = 0; m < positions.size(); m++) {
+        arena.add(positions[m], indices[m], xform);
+    }
+
+    int failures = 0;
+    std::vector<int> items = {0, 1, 2};
+    const std::vector<GeometryArena::DrawElementsIndirectCommand> commands = arena.compact(items);
+    const int drawn[2] = {0, 2};
+    if (commands.size() != 2) {
+        std::cout << commands.size() << " commands, the mesh without triangles must be left out" << std::endl;
+        return 1;
+    }
+    for (int c = 0; c < 2; c++) {
+        const GeometryArena::DrawElementsIndirectCommand& command = commands[c];
+        const std::vector<glm::vec3>& mesh = positions[drawn[c]];
+        const std::vector<unsigned int>& meshIndices = indices[drawn[c]];
+        if (command.count != meshIndices.size() || command.instanceCount != 1) {
+            std::cout << "command " << c << " draws " << command.count << " indices" << std::endl;
+            return 1;
+        }
+        for (GLuint i = 0; i < command.count; i++) {
+            glm::vec3 vertex = arena.vertexData()[command.baseVertex + arena.indexData()[command.firstIndex + i]];
+            glm::vec3 p = mesh[meshIndices[i]];
+            double w = 1.0 + (double) wx * p.x + (double) wz * p.z;
+            glm::dvec3 expected = (glm::dvec3(p) + glm::dvec3(translation)) / w;
+            if (glm::length(glm::dvec3(vertex) - expected) > 1e-5 * glm::length(expected)) {
+                failures++;
+            }
+        }
+    }
+    if (failures > 0) {
+        std::cout << failures << " arena corners differ from the placement of the per-mesh path" << std::endl;
+        return 1;
+    }
+
+    // a subset keeps the offsets of its meshes in the shared buffers
+    items = {2, 1};
+    const std::vector<GeometryArena::DrawElementsIndirectCommand>& single = arena.compact(items);
+    if (single.size() != 1 || single[0].firstIndex != indices[0].size()
+            || single[0].baseVertex != (GLint) (positions[0].size() + positions[1].size())) {
+        std::cout << "the last box lost its offsets when drawn alone" << std::endl;
+        return 1;
+    }
+    std::cout << "arena commands place " << commands.size() << " meshes like the per-mesh path" << std::endl;
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   test_parallel.cpp
+ *
+ * Nested parallel_for() calls on a pool with several threads, from items run
+ * by the workers and by the calling thread. A deadlock shows up as a timeout.
+ */
+
+#include "parallel.hpp"
+
+#include <atomic>
+#include <iostream>
+
+int main() {
+    ThreadPool::setNumThreads(4);
+    if (ThreadPool::instance().numThreads() != 4) {
+        std::cout << "expected a pool of 4 threads" << std::endl;
+        return 1;
+    }
+    const int OUTER = 16, INNER = 64, ROUNDS = 200;
+    for (int round = 0; round < ROUNDS; round++) {
+        std::atomic<int> count(0);
+        parallel_for(0, OUTER, [&](int) {
+            parallel_for(0, INNER, [&](int) {
+                parallel_for(0, 2, [&](int) {
+                    count++;
+                });
+            });
+        });
+        if (count != OUTER * INNER * 2) {
+            std::cout << "round " << round << ": " << count << " calls, expected " << OUTER * INNER * 2 << std::endl;
+            return 1;
+        }
+    }
+    // the calling thread leaves the pool again, its next call runs in parallel
+    std::atomic<int> count(0);
+    parallel_for(0, 1000, [&](int) {
+        count++;
+    });
+    if (count != 1000) {
+        std::cout << count << " calls after the nested rounds, expected 1000" << std::endl;
+        return 1;
+    }
+    std::cout << "nested parallel_for passed" << std::endl;
+    return 0;
+}
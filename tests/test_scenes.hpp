@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 Andrew R. Willis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * File:   test_scenes.hpp
+ *
+ * Geometry shared by the unit tests.
+ */
+
+#ifndef TEST_SCENES_HPP
+#define TEST_SCENES_HPP
+
+#include "scene_geometry.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// corners and triangles of the axis aligned box [lo, hi], top face included
+inline void boxMesh(const glm::vec3& lo, const glm::vec3& hi, std::vector<glm::vec3>& positions,
+        std::vector<unsigned int>& indices) {
+    positions.clear();
+    indices.clear();
+    for (int k = 0; k < 8; k++) {
+        positions.push_back(glm::vec3((k & 1) ? hi.x : lo.x, (k & 2) ? hi.y : lo.y, (k & 4) ? hi.z : lo.z));
+    }
+    static const unsigned int faces[6][4] = {
+        {0, 1, 3, 2}, {4, 6, 7, 5}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 5, 7, 3}
+    };
+    for (int f = 0; f < 6; f++) {
+        unsigned int triangles[6] = {faces[f][0], faces[f][1], faces[f][2], faces[f][0], faces[f][2], faces[f][3]};
+        indices.insert(indices.end(), triangles, triangles + 6);
+    }
+}
+
+// the box appended to a scene
+inline void addBox(SceneGeometry& scene, const glm::vec3& lo, const glm::vec3& hi) {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    boxMesh(lo, hi, positions, indices);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        scene.addTriangle(positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]]);
+    }
+}
+
+#endif /* TEST_SCENES_HPP */